@@ -39,6 +39,7 @@
 #include "tb-jmp-cache.h"
 #include "tb-hash.h"
 #include "tb-context.h"
+#include "tb-stats.h"
 #include "internal-common.h"
 #include "internal-target.h"
 #if defined(CONFIG_USER_ONLY)
@@ -156,7 +157,8 @@ uint32_t curr_cflags(CPUState *cpu)
      * EXCP_DEBUG, but to simplify other tests, disable chaining too.
      *
      * For singlestep and -d nochain, suppress goto_tb so that
-     * we can log -d cpu,exec after every TB.
+     * we can log -d cpu,exec after every TB.  Superblocks are only
+     * formed when none of these are in effect.
      */
     if (unlikely(cpu->singlestep_enabled)) {
         cflags |= CF_NO_GOTO_TB | CF_NO_GOTO_PTR | CF_SINGLE_STEP | 1;
@@ -164,6 +166,8 @@ uint32_t curr_cflags(CPUState *cpu)
         cflags |= CF_NO_GOTO_TB | 1;
     } else if (qemu_loglevel_mask(CPU_LOG_TB_NOCHAIN)) {
         cflags |= CF_NO_GOTO_TB;
+    } else if (qatomic_read(&superblock_enabled)) {
+        cflags |= CF_SUPERBLOCK;
     }
 
     return cflags;
@@ -187,7 +191,7 @@ static bool tb_lookup_cmp(const void *p, const void *d)
         tb_page_addr0(tb) == desc->page_addr0 &&
         tb->cs_base == desc->cs_base &&
         tb->flags == desc->flags &&
-        tb_cflags(tb) == desc->cflags) {
+        (tb_cflags(tb) & ~CF_HINT_MASK) == (desc->cflags & ~CF_HINT_MASK)) {
         /* check next page if needed */
         tb_page_addr_t tb_phys_page1 = tb_page_addr1(tb);
         if (tb_phys_page1 == -1) {
@@ -258,7 +262,7 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                jc->array[hash].pc == pc &&
                tb->cs_base == cs_base &&
                tb->flags == flags &&
-               tb_cflags(tb) == cflags)) {
+               (tb_cflags(tb) & ~CF_HINT_MASK) == (cflags & ~CF_HINT_MASK))) {
         goto hit;
     }
 
@@ -276,9 +280,83 @@ hit:
      * the virtual PC has to match for non-CF_PCREL translations.
      */
     assert((tb_cflags(tb) & CF_PCREL) || tb->pc == pc);
+
+    if (qatomic_read(&superblock_threshold)) {
+        qatomic_set(&tb->exec_count, qatomic_read(&tb->exec_count) + 1);
+    }
     return tb;
 }
 
+/*
+ * With tiered translation, TBs are first translated without superblocks.
+ * Once one has been looked up more than superblock_threshold times, it is
+ * invalidated and retranslated with CF_SUPERBLOCK by cpu_exec_loop().
+ * Invalidation unlinks all jumps into the old TB, so that predecessors
+ * chain to the new one on their next exit.
+ *
+ * Like curr_cflags(), never form superblocks for single-stepping or
+ * -d nochain, and do not bother if the target would ignore CF_SUPERBLOCK.
+ */
+static inline bool tb_needs_tier_up(CPUState *cpu, const TranslationBlock *tb)
+{
+    uint32_t threshold = qatomic_read(&superblock_threshold);
+
+    return threshold &&
+           cpu->cc->tcg_ops->superblock &&
+           !(tb_cflags(tb) & (CF_SUPERBLOCK | CF_COUNT_MASK |
+                              CF_NO_GOTO_TB | CF_NO_GOTO_PTR |
+                              CF_SINGLE_STEP)) &&
+           qatomic_read(&tb->exec_count) > threshold &&
+           cpu->cc->tcg_ops->superblock(tb);
+}
+
+/*
+ * With translate-ahead, a newly translated TB is followed by translation
+ * of its direct jump destinations, so that they are ready by the time the
+ * TB exits and can be chained to immediately.  Only destinations on the
+ * same guest page are considered, as its mapping was just used to
+ * translate @tb and is likely to still be there.  It may be gone anyway,
+ * e.g. after a TLB flush, or be backed by something other than RAM, in
+ * which case tb_gen_code() probes it without faulting and gives up, like
+ * it does for translations that would need the next page.
+ *
+ * Only the translator_ld* functions know how to give up, so this is only
+ * done for targets that set TCGCPUOps.translate_ahead: those that never
+ * fetch code in any other way, e.g. with cpu_ld*_code().
+ *
+ * Called with mmap_lock held for user mode emulation.
+ */
+static void tb_translate_ahead(CPUState *cpu, TranslationBlock *tb,
+                               vaddr pc, uint64_t cs_base,
+                               uint32_t flags, uint32_t cflags)
+{
+    vaddr succ[2];
+    int i, n;
+
+    if (!qatomic_read(&translate_ahead) ||
+        !cpu->cc->tcg_ops->translate_ahead ||
+        tb_page_addr0(tb) == -1 ||
+        (cflags & (CF_COUNT_MASK | CF_SINGLE_STEP |
+                   CF_MEMI_ONLY | CF_NOIRQ))) {
+        return;
+    }
+#ifdef CONFIG_PLUGIN
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_state->event_mask)) {
+        return;
+    }
+#endif
+
+    /* The list is overwritten by each translation below. */
+    n = translator_successors(succ);
+    for (i = 0; i < n; i++) {
+        if (((succ[i] ^ pc) & TARGET_PAGE_MASK) == 0 &&
+            !tb_htable_lookup(cpu, succ[i], cs_base, flags, cflags)) {
+            tb_gen_code(cpu, succ[i], cs_base, flags,
+                        cflags | CF_SPECULATIVE);
+        }
+    }
+}
+
 static void log_cpu_exec(vaddr pc, CPUState *cpu,
                          const TranslationBlock *tb)
 {
@@ -415,7 +493,7 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     }
 
     tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
-    if (tb == NULL) {
+    if (tb == NULL || tb_needs_tier_up(cpu, tb)) {
         return tcg_code_gen_epilogue;
     }
 
@@ -640,13 +718,17 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
 
     /* make sure the destination TB is valid */
     if (tb_next->cflags & CF_INVALID) {
-        goto out_unlock_next;
+        goto out_fail;
     }
     /* Atomically claim the jump destination slot only if it was NULL */
     old = qatomic_cmpxchg(&tb->jmp_dest[n], (uintptr_t)NULL,
                           (uintptr_t)tb_next);
     if (old) {
-        goto out_unlock_next;
+        /* Another thread may have just done the same */
+        if (old == (uintptr_t)tb_next) {
+            goto out_unlock_next;
+        }
+        goto out_fail;
     }
 
     /* patch the native jump address */
@@ -662,6 +744,10 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
                   tb->tc.ptr, n, tb_next->tc.ptr);
     return;
 
+ out_fail:
+    if (tb->tb_stats) {
+        stat64_add(&tb->tb_stats->chain_failures, 1);
+    }
  out_unlock_next:
     qemu_spin_unlock(&tb_next->jmp_lock);
     return;
@@ -900,10 +986,21 @@ static inline void cpu_loop_exec_tb(CPUState *cpu, TranslationBlock *tb,
                                     vaddr pc, TranslationBlock **last_tb,
                                     int *tb_exit)
 {
+    TranslationBlock *last;
     int32_t insns_left;
 
     trace_exec_tb(tb, pc);
-    tb = cpu_tb_exec(cpu, tb, tb_exit);
+    if (tb->tb_stats && qatomic_read(&tb_stats_mode) == TB_STATS_SAMPLE) {
+        stat64_add(&tb->tb_stats->executions, 1);
+    }
+    last = cpu_tb_exec(cpu, tb, tb_exit);
+    if (last && last->tb_stats) {
+        stat64_add(&last->tb_stats->exits[*tb_exit], 1);
+    } else if (!last && tb->tb_stats && (tb_cflags(tb) & CF_NO_GOTO_TB)) {
+        /* Without goto_tb, none of the direct jumps can be chained */
+        stat64_add(&tb->tb_stats->chain_failures, 1);
+    }
+    tb = last;
     if (*tb_exit != TB_EXIT_REQUESTED) {
         *last_tb = tb;
         return;
@@ -984,12 +1081,19 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
             }
 
             tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
-            if (tb == NULL) {
+            if (tb == NULL || unlikely(tb_needs_tier_up(cpu, tb))) {
                 CPUJumpCache *jc;
                 uint32_t h;
 
                 mmap_lock();
+                if (tb) {
+                    /* Replace the hot TB with a superblock translation. */
+                    qemu_thread_jit_write();
+                    tb_phys_invalidate(tb, -1);
+                    cflags |= CF_SUPERBLOCK;
+                }
                 tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+                tb_translate_ahead(cpu, tb, pc, cs_base, flags, cflags);
                 mmap_unlock();
 
                 /*
@@ -1010,6 +1114,9 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
              * for the second page can change.
              */
             if (tb_page_addr1(tb) != -1) {
+                if (last_tb && last_tb->tb_stats) {
+                    stat64_add(&last_tb->tb_stats->chain_failures, 1);
+                }
                 last_tb = NULL;
             }
 #endif
@@ -1077,6 +1184,7 @@ bool tcg_exec_realizefn(CPUState *cpu, Error **errp)
     }
 
     cpu->tb_jmp_cache = g_new0(CPUJumpCache, 1);
+    cpu->tb_inval_pending = g_ptr_array_new();
     tlb_init(cpu);
 #ifndef CONFIG_USER_ONLY
     tcg_iommu_init_notifier_list(cpu);
@@ -1094,5 +1202,10 @@ void tcg_exec_unrealizefn(CPUState *cpu)
 #endif /* !CONFIG_USER_ONLY */
 
     tlb_destroy(cpu);
+    /* nobody else would remove the TBs left from the hash table */
+    mmap_lock();
+    tb_reclaim_pending(cpu);
+    mmap_unlock();
+    g_ptr_array_free(cpu->tb_inval_pending, true);
     g_free_rcu(cpu->tb_jmp_cache, rcu);
 }
@@ -146,6 +146,42 @@ static inline CPUTLBEntry *tlb_entry(CPUState *cpu, uintptr_t mmu_idx,
     return &cpu->neg.tlb.f[mmu_idx].table[tlb_index(cpu, mmu_idx, addr)];
 }
 
+static inline size_t tlb_vtlb_n_entries(const CPUTLBDesc *desc)
+{
+    return (size_t)CPU_VTLB_WAYS << desc->vbits;
+}
+
+/*
+ * Find the first victim tlb entry of the set for @page.  Hash the page
+ * number, so that the pages that conflict in the main tlb, which is
+ * indexed by the low bits of the page number, use different sets.
+ */
+static inline size_t tlb_vtlb_set(const CPUTLBDesc *desc, vaddr page)
+{
+    uint64_t h = (uint64_t)(page >> TARGET_PAGE_BITS) * 0x9e3779b97f4a7c15ull;
+
+    return (h >> (64 - desc->vbits)) * CPU_VTLB_WAYS;
+}
+
+/* Size the victim tlb relative to a main tlb of @n_entries.  */
+static unsigned tlb_vtlb_bits(size_t n_entries)
+{
+    int bits = ctz64(n_entries) - CPU_VTLB_SHIFT - ctz32(CPU_VTLB_WAYS);
+
+    return MIN(MAX(bits, CPU_VTLB_MIN_BITS), CPU_VTLB_MAX_BITS);
+}
+
+static void tlb_vtlb_alloc(CPUTLBDesc *desc, unsigned vbits)
+{
+    size_t n_entries = (size_t)CPU_VTLB_WAYS << vbits;
+
+    g_free(desc->vtable);
+    g_free(desc->vfulltlb);
+    desc->vbits = vbits;
+    desc->vtable = g_new(CPUTLBEntry, n_entries);
+    desc->vfulltlb = g_new(CPUTLBEntryFull, n_entries);
+}
+
 static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
                              size_t max_entries)
 {
@@ -207,6 +243,9 @@ static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
  * is direct mapped, so we want the use rate to be low (or at least not too
  * high), since otherwise we are likely to have a significant amount of
  * conflict misses.
+ *
+ * The victim TLB, which catches some of those conflict misses, is resized
+ * along with the main TLB.
  */
 static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
                                   int64_t now)
@@ -281,16 +320,25 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
         fast->table = g_try_new(CPUTLBEntry, new_size);
         desc->fulltlb = g_try_new(CPUTLBEntryFull, new_size);
     }
+
+    if (tlb_vtlb_bits(new_size) != desc->vbits) {
+        tlb_vtlb_alloc(desc, tlb_vtlb_bits(new_size));
+    }
 }
 
 static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
 {
+    int i;
+
     desc->n_used_entries = 0;
     desc->large_page_addr = -1;
     desc->large_page_mask = -1;
+    for (i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        desc->large_pages[i].addr = -1;
+    }
     desc->vindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
-    memset(desc->vtable, -1, sizeof(desc->vtable));
+    memset(desc->vtable, -1, sizeof(CPUTLBEntry) * tlb_vtlb_n_entries(desc));
 }
 
 static void tlb_flush_one_mmuidx_locked(CPUState *cpu, int mmu_idx,
@@ -312,6 +360,7 @@ static void tlb_mmu_init(CPUTLBDesc *desc, CPUTLBDescFast *fast, int64_t now)
     fast->mask = (n_entries - 1) << CPU_TLB_ENTRY_BITS;
     fast->table = g_new(CPUTLBEntry, n_entries);
     desc->fulltlb = g_new(CPUTLBEntryFull, n_entries);
+    tlb_vtlb_alloc(desc, tlb_vtlb_bits(n_entries));
     tlb_mmu_flush_locked(desc, fast);
 }
 
@@ -351,24 +400,152 @@ void tlb_destroy(CPUState *cpu)
 
         g_free(fast->table);
         g_free(desc->fulltlb);
+        g_free(desc->vtable);
+        g_free(desc->vfulltlb);
     }
 }
 
-/* flush_all_helper: run fn across all cpus
+/* A range flush; see tlb_flush_range_by_mmuidx.  */
+typedef CPUTLBPendingFlush TLBFlushRangeData;
+
+static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data);
+static void tlb_flush_page_by_mmuidx_async_0(CPUState *cpu, vaddr addr,
+                                             uint16_t idxmap);
+static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
+                                              TLBFlushRangeData d);
+
+/*
+ * Flushes requested for another cpu are not queued as work items one
+ * by one.  They are merged into the pending list of the target cpu,
+ * and a single work item processes all that have accumulated by the
+ * time the target gets to it.  This turns e.g. the page by page flushes
+ * of a large guest munmap into one range flush, or a full flush.
  *
- * If the wait flag is set then the src cpu's helper will be queued as
- * "safe" work and the loop exited creating a synchronisation point
- * where all queued work will be finished before execution starts
- * again.
+ * Since the work item is queued before the requester returns, and is
+ * run before the target executes any more guest code, the semantics
+ * of the *_synced functions are unchanged.
  */
-static void flush_all_helper(CPUState *src, run_on_cpu_func fn,
-                             run_on_cpu_data d)
+static void tlb_flush_pending_work(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUTLBCommon *c = &cpu->neg.tlb.c;
+    CPUTLBPendingFlush pending[CPU_TLB_PENDING_FLUSHES];
+    uint16_t full;
+    unsigned i, n;
+
+    qemu_spin_lock(&c->lock);
+    full = c->pending_full;
+    n = c->pending_n;
+    memcpy(pending, c->pending, n * sizeof(pending[0]));
+    c->pending_full = 0;
+    c->pending_n = 0;
+    c->pending_scheduled = false;
+    qemu_spin_unlock(&c->lock);
+
+    if (full) {
+        tlb_flush_by_mmuidx_async_work(cpu, RUN_ON_CPU_HOST_INT(full));
+    }
+    for (i = 0; i < n; i++) {
+        if (pending[i].bits >= TARGET_LONG_BITS &&
+            pending[i].len == TARGET_PAGE_SIZE) {
+            tlb_flush_page_by_mmuidx_async_0(cpu, pending[i].addr,
+                                             pending[i].idxmap);
+        } else {
+            tlb_flush_range_by_mmuidx_async_0(cpu, pending[i]);
+        }
+    }
+}
+
+/* Called with tlb_c.lock held */
+static void tlb_pending_add_full_locked(CPUTLBCommon *c, uint16_t idxmap)
+{
+    unsigned i, j;
+
+    c->pending_full |= idxmap;
+
+    /* Pending ranges for these mmu_idx are now redundant.  */
+    for (i = j = 0; i < c->pending_n; i++) {
+        c->pending[i].idxmap &= ~idxmap;
+        if (c->pending[i].idxmap) {
+            c->pending[j++] = c->pending[i];
+        }
+    }
+    c->pending_n = j;
+}
+
+/* Called with tlb_c.lock held */
+static void tlb_pending_add_range_locked(CPUTLBCommon *c,
+                                         TLBFlushRangeData *d)
+{
+    vaddr d_last = d->addr + d->len - 1;
+    uint16_t idxmap;
+    unsigned i;
+
+    d->idxmap &= ~c->pending_full;
+    if (!d->idxmap) {
+        return;
+    }
+
+    /* Extend a pending range that overlaps or abuts this one.  */
+    for (i = 0; i < c->pending_n && d_last >= d->addr; i++) {
+        CPUTLBPendingFlush *p = &c->pending[i];
+        vaddr p_last = p->addr + p->len - 1;
+
+        if (p->idxmap != d->idxmap || p->bits != d->bits ||
+            p_last < p->addr ||
+            d->addr > p_last + 1 || p->addr > d_last + 1) {
+            continue;
+        }
+        p_last = MAX(p_last, d_last);
+        p->addr = MIN(p->addr, d->addr);
+        p->len = p_last - p->addr + 1;
+        return;
+    }
+
+    if (c->pending_n < CPU_TLB_PENDING_FLUSHES) {
+        c->pending[c->pending_n++] = *d;
+        return;
+    }
+
+    /* Too many distinct ranges: flush the mmu_idx involved entirely.  */
+    idxmap = d->idxmap;
+    for (i = 0; i < c->pending_n; i++) {
+        idxmap |= c->pending[i].idxmap;
+    }
+    tlb_pending_add_full_locked(c, idxmap);
+}
+
+/* Queue a flush of @d on @cpu, which is not the current cpu.  */
+static void tlb_queue_flush(CPUState *cpu, TLBFlushRangeData d)
+{
+    CPUTLBCommon *c = &cpu->neg.tlb.c;
+    bool schedule;
+
+    qemu_spin_lock(&c->lock);
+    if (d.len == 0) {
+        tlb_pending_add_full_locked(c, d.idxmap);
+    } else {
+        tlb_pending_add_range_locked(c, &d);
+    }
+    schedule = !c->pending_scheduled;
+    c->pending_scheduled = true;
+    if (!schedule) {
+        qatomic_set(&c->coalesced_flush_count, c->coalesced_flush_count + 1);
+    }
+    qemu_spin_unlock(&c->lock);
+
+    if (schedule) {
+        async_run_on_cpu(cpu, tlb_flush_pending_work, RUN_ON_CPU_NULL);
+    }
+}
+
+/* flush_all_helper: queue the flush @d on all cpus but @src */
+static void flush_all_helper(CPUState *src, TLBFlushRangeData d)
 {
     CPUState *cpu;
 
     CPU_FOREACH(cpu) {
         if (cpu != src) {
-            async_run_on_cpu(cpu, fn, d);
+            tlb_queue_flush(cpu, d);
         }
     }
 }
@@ -418,8 +595,7 @@ void tlb_flush_by_mmuidx(CPUState *cpu, uint16_t idxmap)
     tlb_debug("mmu_idx: 0x%" PRIx16 "\n", idxmap);
 
     if (cpu->created && !qemu_cpu_is_self(cpu)) {
-        async_run_on_cpu(cpu, tlb_flush_by_mmuidx_async_work,
-                         RUN_ON_CPU_HOST_INT(idxmap));
+        tlb_queue_flush(cpu, (TLBFlushRangeData){ .idxmap = idxmap });
     } else {
         tlb_flush_by_mmuidx_async_work(cpu, RUN_ON_CPU_HOST_INT(idxmap));
     }
@@ -436,7 +612,7 @@ void tlb_flush_by_mmuidx_all_cpus(CPUState *src_cpu, uint16_t idxmap)
 
     tlb_debug("mmu_idx: 0x%"PRIx16"\n", idxmap);
 
-    flush_all_helper(src_cpu, fn, RUN_ON_CPU_HOST_INT(idxmap));
+    flush_all_helper(src_cpu, (TLBFlushRangeData){ .idxmap = idxmap });
     fn(src_cpu, RUN_ON_CPU_HOST_INT(idxmap));
 }
 
@@ -451,7 +627,7 @@ void tlb_flush_by_mmuidx_all_cpus_synced(CPUState *src_cpu, uint16_t idxmap)
 
     tlb_debug("mmu_idx: 0x%"PRIx16"\n", idxmap);
 
-    flush_all_helper(src_cpu, fn, RUN_ON_CPU_HOST_INT(idxmap));
+    flush_all_helper(src_cpu, (TLBFlushRangeData){ .idxmap = idxmap });
     async_safe_run_on_cpu(src_cpu, fn, RUN_ON_CPU_HOST_INT(idxmap));
 }
 
@@ -485,6 +661,21 @@ static inline bool tlb_entry_is_empty(const CPUTLBEntry *te)
     return te->addr_read == -1 && te->addr_write == -1 && te->addr_code == -1;
 }
 
+/* Return the page mapped by the non-empty entry @te.  */
+static vaddr tlb_entry_page(const CPUTLBEntry *te)
+{
+    int i;
+
+    for (i = 0; i < MMU_ACCESS_COUNT; i++) {
+        uint64_t addr = te->addr_idx[i];
+
+        if (addr != -1) {
+            return addr & TARGET_PAGE_MASK;
+        }
+    }
+    return -1;
+}
+
 /* Called with tlb_c.lock held */
 static bool tlb_flush_entry_mask_locked(CPUTLBEntry *tlb_entry,
                                         vaddr page,
@@ -502,26 +693,45 @@ static inline bool tlb_flush_entry_locked(CPUTLBEntry *tlb_entry, vaddr page)
     return tlb_flush_entry_mask_locked(tlb_entry, page, -1);
 }
 
-/* Called with tlb_c.lock held */
-static void tlb_flush_vtlb_page_mask_locked(CPUState *cpu, int mmu_idx,
-                                            vaddr page,
-                                            vaddr mask)
+/*
+ * Flush the victim tlb entries for the pages that match any page of
+ * [@addr, @addr + @len) under @mask.  With a partial @mask, they may be
+ * in any set, so walk the whole victim tlb, but only once for the range.
+ * @addr must be page aligned, and @len no larger than @mask + 1.
+ * Called with tlb_c.lock held.
+ */
+static void tlb_flush_vtlb_range_locked(CPUState *cpu, int mmu_idx,
+                                        vaddr addr, vaddr len,
+                                        vaddr mask)
 {
     CPUTLBDesc *d = &cpu->neg.tlb.d[mmu_idx];
-    int k;
+    size_t k, n = tlb_vtlb_n_entries(d);
 
     assert_cpu_is_self(cpu);
-    for (k = 0; k < CPU_VTLB_SIZE; k++) {
-        if (tlb_flush_entry_mask_locked(&d->vtable[k], page, mask)) {
+    for (k = 0; k < n; k++) {
+        CPUTLBEntry *te = &d->vtable[k];
+        vaddr page = tlb_entry_page(te);
+
+        if (page != -1 && ((page - addr) & mask) < len) {
+            memset(te, -1, sizeof(*te));
             tlb_n_used_entries_dec(cpu, mmu_idx);
         }
     }
 }
 
-static inline void tlb_flush_vtlb_page_locked(CPUState *cpu, int mmu_idx,
-                                              vaddr page)
+/* Called with tlb_c.lock held */
+static void tlb_flush_vtlb_page_locked(CPUState *cpu, int mmu_idx,
+                                       vaddr page)
 {
-    tlb_flush_vtlb_page_mask_locked(cpu, mmu_idx, page, -1);
+    CPUTLBDesc *d = &cpu->neg.tlb.d[mmu_idx];
+    size_t k, set = tlb_vtlb_set(d, page);
+
+    assert_cpu_is_self(cpu);
+    for (k = set; k < set + CPU_VTLB_WAYS; k++) {
+        if (tlb_flush_entry_locked(&d->vtable[k], page)) {
+            tlb_n_used_entries_dec(cpu, mmu_idx);
+        }
+    }
 }
 
 static void tlb_flush_page_locked(CPUState *cpu, int midx, vaddr page)
@@ -631,22 +841,10 @@ void tlb_flush_page_by_mmuidx(CPUState *cpu, vaddr addr, uint16_t idxmap)
 
     if (qemu_cpu_is_self(cpu)) {
         tlb_flush_page_by_mmuidx_async_0(cpu, addr, idxmap);
-    } else if (idxmap < TARGET_PAGE_SIZE) {
-        /*
-         * Most targets have only a few mmu_idx.  In the case where
-         * we can stuff idxmap into the low TARGET_PAGE_BITS, avoid
-         * allocating memory for this operation.
-         */
-        async_run_on_cpu(cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
     } else {
-        TLBFlushPageByMMUIdxData *d = g_new(TLBFlushPageByMMUIdxData, 1);
-
-        /* Otherwise allocate a structure, freed by the worker.  */
-        d->addr = addr;
-        d->idxmap = idxmap;
-        async_run_on_cpu(cpu, tlb_flush_page_by_mmuidx_async_2,
-                         RUN_ON_CPU_HOST_PTR(d));
+        tlb_queue_flush(cpu, (TLBFlushRangeData){
+            .addr = addr, .len = TARGET_PAGE_SIZE,
+            .idxmap = idxmap, .bits = TARGET_LONG_BITS });
     }
 }
 
@@ -663,30 +861,9 @@ void tlb_flush_page_by_mmuidx_all_cpus(CPUState *src_cpu, vaddr addr,
     /* This should already be page aligned */
     addr &= TARGET_PAGE_MASK;
 
-    /*
-     * Allocate memory to hold addr+idxmap only when needed.
-     * See tlb_flush_page_by_mmuidx for details.
-     */
-    if (idxmap < TARGET_PAGE_SIZE) {
-        flush_all_helper(src_cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
-    } else {
-        CPUState *dst_cpu;
-
-        /* Allocate a separate data block for each destination cpu.  */
-        CPU_FOREACH(dst_cpu) {
-            if (dst_cpu != src_cpu) {
-                TLBFlushPageByMMUIdxData *d
-                    = g_new(TLBFlushPageByMMUIdxData, 1);
-
-                d->addr = addr;
-                d->idxmap = idxmap;
-                async_run_on_cpu(dst_cpu, tlb_flush_page_by_mmuidx_async_2,
-                                 RUN_ON_CPU_HOST_PTR(d));
-            }
-        }
-    }
-
+    flush_all_helper(src_cpu, (TLBFlushRangeData){
+        .addr = addr, .len = TARGET_PAGE_SIZE,
+        .idxmap = idxmap, .bits = TARGET_LONG_BITS });
     tlb_flush_page_by_mmuidx_async_0(src_cpu, addr, idxmap);
 }
 
@@ -704,31 +881,22 @@ void tlb_flush_page_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
     /* This should already be page aligned */
     addr &= TARGET_PAGE_MASK;
 
+    flush_all_helper(src_cpu, (TLBFlushRangeData){
+        .addr = addr, .len = TARGET_PAGE_SIZE,
+        .idxmap = idxmap, .bits = TARGET_LONG_BITS });
+
     /*
      * Allocate memory to hold addr+idxmap only when needed.
-     * See tlb_flush_page_by_mmuidx for details.
+     * Most targets have only a few mmu_idx.  In the case where
+     * we can stuff idxmap into the low TARGET_PAGE_BITS, avoid
+     * allocating memory for this operation.
      */
     if (idxmap < TARGET_PAGE_SIZE) {
-        flush_all_helper(src_cpu, tlb_flush_page_by_mmuidx_async_1,
-                         RUN_ON_CPU_TARGET_PTR(addr | idxmap));
         async_safe_run_on_cpu(src_cpu, tlb_flush_page_by_mmuidx_async_1,
                               RUN_ON_CPU_TARGET_PTR(addr | idxmap));
     } else {
-        CPUState *dst_cpu;
-        TLBFlushPageByMMUIdxData *d;
-
-        /* Allocate a separate data block for each destination cpu.  */
-        CPU_FOREACH(dst_cpu) {
-            if (dst_cpu != src_cpu) {
-                d = g_new(TLBFlushPageByMMUIdxData, 1);
-                d->addr = addr;
-                d->idxmap = idxmap;
-                async_run_on_cpu(dst_cpu, tlb_flush_page_by_mmuidx_async_2,
-                                 RUN_ON_CPU_HOST_PTR(d));
-            }
-        }
+        TLBFlushPageByMMUIdxData *d = g_new(TLBFlushPageByMMUIdxData, 1);
 
-        d = g_new(TLBFlushPageByMMUIdxData, 1);
         d->addr = addr;
         d->idxmap = idxmap;
         async_safe_run_on_cpu(src_cpu, tlb_flush_page_by_mmuidx_async_2,
@@ -780,6 +948,23 @@ static void tlb_flush_range_locked(CPUState *cpu, int midx,
         return;
     }
 
+    /*
+     * The range may still cover a large page without its end being in
+     * the large page region; forget those, so that they are walked again.
+     */
+    for (int i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        CPUTLBLargePage *lp = &d->large_pages[i];
+        vaddr lp_last;
+
+        if (lp->addr == -1) {
+            continue;
+        }
+        lp_last = lp->addr + ((vaddr)1 << lp->full.lg_page_size) - 1;
+        if (mask != -1 || (lp->addr <= addr + len - 1 && addr <= lp_last)) {
+            lp->addr = -1;
+        }
+    }
+
     for (vaddr i = 0; i < len; i += TARGET_PAGE_SIZE) {
         vaddr page = addr + i;
         CPUTLBEntry *entry = tlb_entry(cpu, midx, page);
@@ -787,17 +972,10 @@ static void tlb_flush_range_locked(CPUState *cpu, int midx,
         if (tlb_flush_entry_mask_locked(entry, page, mask)) {
             tlb_n_used_entries_dec(cpu, midx);
         }
-        tlb_flush_vtlb_page_mask_locked(cpu, midx, page, mask);
     }
+    tlb_flush_vtlb_range_locked(cpu, midx, addr, len, mask);
 }
 
-typedef struct {
-    vaddr addr;
-    vaddr len;
-    uint16_t idxmap;
-    uint16_t bits;
-} TLBFlushRangeData;
-
 static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
                                               TLBFlushRangeData d)
 {
@@ -873,10 +1051,7 @@ void tlb_flush_range_by_mmuidx(CPUState *cpu, vaddr addr,
     if (qemu_cpu_is_self(cpu)) {
         tlb_flush_range_by_mmuidx_async_0(cpu, d);
     } else {
-        /* Otherwise allocate a structure, freed by the worker.  */
-        TLBFlushRangeData *p = g_memdup(&d, sizeof(d));
-        async_run_on_cpu(cpu, tlb_flush_range_by_mmuidx_async_1,
-                         RUN_ON_CPU_HOST_PTR(p));
+        tlb_queue_flush(cpu, d);
     }
 }
 
@@ -891,7 +1066,6 @@ void tlb_flush_range_by_mmuidx_all_cpus(CPUState *src_cpu,
                                         uint16_t idxmap, unsigned bits)
 {
     TLBFlushRangeData d;
-    CPUState *dst_cpu;
 
     /*
      * If all bits are significant, and len is small,
@@ -913,16 +1087,7 @@ void tlb_flush_range_by_mmuidx_all_cpus(CPUState *src_cpu,
     d.idxmap = idxmap;
     d.bits = bits;
 
-    /* Allocate a separate data block for each destination cpu.  */
-    CPU_FOREACH(dst_cpu) {
-        if (dst_cpu != src_cpu) {
-            TLBFlushRangeData *p = g_memdup(&d, sizeof(d));
-            async_run_on_cpu(dst_cpu,
-                             tlb_flush_range_by_mmuidx_async_1,
-                             RUN_ON_CPU_HOST_PTR(p));
-        }
-    }
-
+    flush_all_helper(src_cpu, d);
     tlb_flush_range_by_mmuidx_async_0(src_cpu, d);
 }
 
@@ -941,7 +1106,6 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
                                                unsigned bits)
 {
     TLBFlushRangeData d, *p;
-    CPUState *dst_cpu;
 
     /*
      * If all bits are significant, and len is small,
@@ -963,14 +1127,7 @@ void tlb_flush_range_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
     d.idxmap = idxmap;
     d.bits = bits;
 
-    /* Allocate a separate data block for each destination cpu.  */
-    CPU_FOREACH(dst_cpu) {
-        if (dst_cpu != src_cpu) {
-            p = g_memdup(&d, sizeof(d));
-            async_run_on_cpu(dst_cpu, tlb_flush_range_by_mmuidx_async_1,
-                             RUN_ON_CPU_HOST_PTR(p));
-        }
-    }
+    flush_all_helper(src_cpu, d);
 
     p = g_memdup(&d, sizeof(d));
     async_safe_run_on_cpu(src_cpu, tlb_flush_range_by_mmuidx_async_1,
@@ -1052,6 +1209,28 @@ static inline void copy_tlb_helper_locked(CPUTLBEntry *d, const CPUTLBEntry *s)
     *d = *s;
 }
 
+/*
+ * Called with tlb_c.lock held.
+ * Evict @te and its full entry @full into the set of the victim tlb
+ * for its page, replacing an empty way if there is one.
+ */
+static void tlb_vtlb_insert_locked(CPUTLBDesc *desc, const CPUTLBEntry *te,
+                                   const CPUTLBEntryFull *full)
+{
+    size_t set = tlb_vtlb_set(desc, tlb_entry_page(te));
+    size_t vidx = set + desc->vindex++ % CPU_VTLB_WAYS;
+    size_t k;
+
+    for (k = set; k < set + CPU_VTLB_WAYS; k++) {
+        if (tlb_entry_is_empty(&desc->vtable[k])) {
+            vidx = k;
+            break;
+        }
+    }
+    copy_tlb_helper_locked(&desc->vtable[vidx], te);
+    desc->vfulltlb[vidx] = *full;
+}
+
 /* This is a cross vCPU call (i.e. another vCPU resetting the flags of
  * the target vCPU).
  * We must take tlb_c.lock to avoid racing with another vCPU update. The only
@@ -1071,7 +1250,8 @@ void tlb_reset_dirty(CPUState *cpu, ram_addr_t start1, ram_addr_t length)
                                          start1, length);
         }
 
-        for (i = 0; i < CPU_VTLB_SIZE; i++) {
+        n = tlb_vtlb_n_entries(&cpu->neg.tlb.d[mmu_idx]);
+        for (i = 0; i < n; i++) {
             tlb_reset_dirty_range_locked(&cpu->neg.tlb.d[mmu_idx].vtable[i],
                                          start1, length);
         }
@@ -1103,9 +1283,11 @@ static void tlb_set_dirty(CPUState *cpu, vaddr addr)
     }
 
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
-        int k;
-        for (k = 0; k < CPU_VTLB_SIZE; k++) {
-            tlb_set_dirty1_locked(&cpu->neg.tlb.d[mmu_idx].vtable[k], addr);
+        CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+        size_t k, set = tlb_vtlb_set(desc, addr);
+
+        for (k = set; k < set + CPU_VTLB_WAYS; k++) {
+            tlb_set_dirty1_locked(&desc->vtable[k], addr);
         }
     }
     qemu_spin_unlock(&cpu->neg.tlb.c.lock);
@@ -1135,6 +1317,40 @@ static void tlb_add_large_page(CPUState *cpu, int mmu_idx,
     cpu->neg.tlb.d[mmu_idx].large_page_mask = lp_mask;
 }
 
+/*
+ * Remember the large page containing @addr, as described by @full,
+ * so that its other small pages can be filled by tlb_fill_large_page.
+ */
+static void tlb_record_large_page(CPUState *cpu, int mmu_idx,
+                                  vaddr addr, const CPUTLBEntryFull *full)
+{
+    CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+    uint64_t size = (uint64_t)1 << full->lg_page_size;
+    CPUTLBLargePage *lp = NULL;
+    int i;
+
+    /* These must go through tlb_fill on every write.  */
+    if (full->prot & PAGE_WRITE_INV) {
+        return;
+    }
+
+    addr &= -size;
+    for (i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        if (desc->large_pages[i].addr == addr) {
+            /* E.g. the target has since made the page writable.  */
+            lp = &desc->large_pages[i];
+            break;
+        }
+    }
+    if (!lp) {
+        lp = &desc->large_pages[desc->large_page_next++ %
+                                CPU_TLB_LARGE_PAGES];
+    }
+    lp->addr = addr;
+    lp->full = *full;
+    lp->full.phys_addr &= -size;
+}
+
 static inline void tlb_set_compare(CPUTLBEntryFull *full, CPUTLBEntry *ent,
                                    vaddr address, int flags,
                                    MMUAccessType access_type, bool enable)
@@ -1155,8 +1371,9 @@ static inline void tlb_set_compare(CPUTLBEntryFull *full, CPUTLBEntry *ent,
 
 /*
  * Add a new TLB entry. At most one entry for a given virtual address
- * is permitted. Only a single TARGET_PAGE_SIZE region is mapped, the
- * supplied size is only used by tlb_flush_page.
+ * is permitted. Only a single TARGET_PAGE_SIZE region is mapped; the
+ * supplied size is used by tlb_flush_page, and to map the other pages
+ * of a large page on their first access without calling tlb_fill.
  *
  * Called from TCG-generated code, which is under an RCU read-side
  * critical section.
@@ -1182,6 +1399,7 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
     } else {
         sz = (hwaddr)1 << full->lg_page_size;
         tlb_add_large_page(cpu, mmu_idx, addr, sz);
+        tlb_record_large_page(cpu, mmu_idx, addr, full);
     }
     addr_page = addr & TARGET_PAGE_MASK;
     paddr_page = full->phys_addr & TARGET_PAGE_MASK;
@@ -1268,12 +1486,8 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
      * different page; otherwise just overwrite the stale data.
      */
     if (!tlb_hit_page_anyprot(te, addr_page) && !tlb_entry_is_empty(te)) {
-        unsigned vidx = desc->vindex++ % CPU_VTLB_SIZE;
-        CPUTLBEntry *tv = &desc->vtable[vidx];
-
         /* Evict the old entry into the victim tlb.  */
-        copy_tlb_helper_locked(tv, te);
-        desc->vfulltlb[vidx] = desc->fulltlb[index];
+        tlb_vtlb_insert_locked(desc, te, &desc->fulltlb[index]);
         tlb_n_used_entries_dec(cpu, mmu_idx);
     }
 
@@ -1346,6 +1560,44 @@ void tlb_set_page(CPUState *cpu, vaddr addr,
                             prot, mmu_idx, size);
 }
 
+/*
+ * Fill the tlb entry for @addr from a large page recently added by the
+ * target, if there is one that contains @addr and allows @access_type.
+ * Return false if the target's tlb_fill hook must be called instead.
+ */
+static bool tlb_fill_large_page(CPUState *cpu, vaddr addr,
+                                MMUAccessType access_type, int mmu_idx)
+{
+    static const int access_prot[MMU_ACCESS_COUNT] = {
+        [MMU_DATA_LOAD] = PAGE_READ,
+        [MMU_DATA_STORE] = PAGE_WRITE,
+        [MMU_INST_FETCH] = PAGE_EXEC,
+    };
+    CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+    int i;
+
+    for (i = 0; i < CPU_TLB_LARGE_PAGES; i++) {
+        CPUTLBLargePage *lp = &desc->large_pages[i];
+        CPUTLBEntryFull full;
+
+        if (lp->addr == -1 ||
+            (addr & -((vaddr)1 << lp->full.lg_page_size)) != lp->addr) {
+            continue;
+        }
+        if (!(lp->full.prot & access_prot[access_type])) {
+            return false;
+        }
+
+        full = lp->full;
+        full.phys_addr += (addr - lp->addr) & TARGET_PAGE_MASK;
+        tlb_set_page_full(cpu, mmu_idx, addr, &full);
+        qatomic_set(&cpu->neg.tlb.c.large_page_fill_count,
+                    cpu->neg.tlb.c.large_page_fill_count + 1);
+        return true;
+    }
+    return false;
+}
+
 /*
  * Note: tlb_fill() can trigger a resize of the TLB. This means that all of the
  * caller's prior references to the TLB table (e.g. CPUTLBEntry pointers) must
@@ -1356,6 +1608,10 @@ static void tlb_fill(CPUState *cpu, vaddr addr, int size,
 {
     bool ok;
 
+    if (tlb_fill_large_page(cpu, addr, access_type, mmu_idx)) {
+        return;
+    }
+
     /*
      * This is not a probe, so only valid return is success; failure
      * should result in exception + longjmp to the cpu loop.
@@ -1410,30 +1666,39 @@ static void io_failed(CPUState *cpu, CPUTLBEntryFull *full, vaddr addr,
 static bool victim_tlb_hit(CPUState *cpu, size_t mmu_idx, size_t index,
                            MMUAccessType access_type, vaddr page)
 {
-    size_t vidx;
+    CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+    CPUTLBCommon *c = &cpu->neg.tlb.c;
+    size_t vidx, set;
 
     assert_cpu_is_self(cpu);
-    for (vidx = 0; vidx < CPU_VTLB_SIZE; ++vidx) {
-        CPUTLBEntry *vtlb = &cpu->neg.tlb.d[mmu_idx].vtable[vidx];
+    set = tlb_vtlb_set(desc, page);
+    for (vidx = set; vidx < set + CPU_VTLB_WAYS; ++vidx) {
+        CPUTLBEntry *vtlb = &desc->vtable[vidx];
         uint64_t cmp = tlb_read_idx(vtlb, access_type);
 
         if (cmp == page) {
-            /* Found entry in victim tlb, swap tlb and iotlb.  */
+            /*
+             * Found entry in victim tlb.  Move it to the main tlb, and
+             * the entry it replaces to the set for its own page.
+             */
             CPUTLBEntry tmptlb, *tlb = &cpu->neg.tlb.f[mmu_idx].table[index];
+            CPUTLBEntryFull tmpf = desc->vfulltlb[vidx];
 
-            qemu_spin_lock(&cpu->neg.tlb.c.lock);
-            copy_tlb_helper_locked(&tmptlb, tlb);
-            copy_tlb_helper_locked(tlb, vtlb);
-            copy_tlb_helper_locked(vtlb, &tmptlb);
-            qemu_spin_unlock(&cpu->neg.tlb.c.lock);
+            qemu_spin_lock(&c->lock);
+            copy_tlb_helper_locked(&tmptlb, vtlb);
+            memset(vtlb, -1, sizeof(*vtlb));
+            if (!tlb_entry_is_empty(tlb)) {
+                tlb_vtlb_insert_locked(desc, tlb, &desc->fulltlb[index]);
+            }
+            copy_tlb_helper_locked(tlb, &tmptlb);
+            qemu_spin_unlock(&c->lock);
 
-            CPUTLBEntryFull *f1 = &cpu->neg.tlb.d[mmu_idx].fulltlb[index];
-            CPUTLBEntryFull *f2 = &cpu->neg.tlb.d[mmu_idx].vfulltlb[vidx];
-            CPUTLBEntryFull tmpf;
-            tmpf = *f1; *f1 = *f2; *f2 = tmpf;
+            desc->fulltlb[index] = tmpf;
+            qatomic_set(&c->vtlb_hit_count, c->vtlb_hit_count + 1);
             return true;
         }
     }
+    qatomic_set(&c->vtlb_miss_count, c->vtlb_miss_count + 1);
     return false;
 }
 
@@ -1445,7 +1710,7 @@ static void notdirty_write(CPUState *cpu, vaddr mem_vaddr, unsigned size,
     trace_memory_notdirty_write_access(mem_vaddr, ram_addr, size);
 
     if (!cpu_physical_memory_get_dirty_flag(ram_addr, DIRTY_MEMORY_CODE)) {
-        tb_invalidate_phys_range_fast(ram_addr, size, retaddr);
+        tb_invalidate_phys_range_fast(cpu, ram_addr, size, retaddr);
     }
 
     /*
@@ -1477,7 +1742,8 @@ static int probe_access_internal(CPUState *cpu, vaddr addr,
 
     if (!tlb_hit_page(tlb_addr, page_addr)) {
         if (!victim_tlb_hit(cpu, mmu_idx, index, access_type, page_addr)) {
-            if (!cpu->cc->tcg_ops->tlb_fill(cpu, addr, fault_size, access_type,
+            if (!tlb_fill_large_page(cpu, addr, access_type, mmu_idx) &&
+                !cpu->cc->tcg_ops->tlb_fill(cpu, addr, fault_size, access_type,
                                             mmu_idx, nonfault, retaddr)) {
                 /* Non-faulting page table read failed.  */
                 *phost = NULL;
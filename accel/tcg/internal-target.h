@@ -63,7 +63,7 @@ void tb_unlock_pages(TranslationBlock *);
 #endif
 
 #ifdef CONFIG_SOFTMMU
-void tb_invalidate_phys_range_fast(ram_addr_t ram_addr,
+void tb_invalidate_phys_range_fast(CPUState *cpu, ram_addr_t ram_addr,
                                    unsigned size,
                                    uintptr_t retaddr);
 G_NORETURN void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
@@ -74,8 +74,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu, vaddr pc,
                               int cflags);
 void page_init(void);
 void tb_htable_init(void);
+void tb_evict(CPUState *cpu);
+int translator_successors(vaddr succ[2]);
 void tb_reset_jump(TranslationBlock *tb, int n);
 TranslationBlock *tb_link_page(TranslationBlock *tb);
+void tb_reclaim_pending(CPUState *cpu);
 bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc);
 void cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
                                uintptr_t host_pc);
@@ -94,6 +97,9 @@ static inline vaddr log_pc(CPUState *cpu, const TranslationBlock *tb)
 }
 
 extern bool one_insn_per_tb;
+extern bool superblock_enabled;
+extern uint32_t superblock_threshold;
+extern bool translate_ahead;
 
 /**
  * tcg_req_mo:
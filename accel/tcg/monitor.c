@@ -9,6 +9,7 @@
 #include "qemu/osdep.h"
 #include "qemu/accel.h"
 #include "qemu/qht.h"
+#include "disas/disas.h"
 #include "qapi/error.h"
 #include "qapi/type-helpers.h"
 #include "qapi/qapi-commands-machine.h"
@@ -19,6 +20,7 @@
 #include "tcg/tcg.h"
 #include "internal-common.h"
 #include "tb-context.h"
+#include "tb-stats.h"
 
 
 static void dump_drift_info(GString *buf)
@@ -126,19 +128,37 @@ static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
     return false;
 }
 
-static void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
+static void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide,
+                             size_t *pmerged)
 {
     CPUState *cpu;
-    size_t full = 0, part = 0, elide = 0;
+    size_t full = 0, part = 0, elide = 0, merged = 0;
 
     CPU_FOREACH(cpu) {
         full += qatomic_read(&cpu->neg.tlb.c.full_flush_count);
         part += qatomic_read(&cpu->neg.tlb.c.part_flush_count);
         elide += qatomic_read(&cpu->neg.tlb.c.elide_flush_count);
+        merged += qatomic_read(&cpu->neg.tlb.c.coalesced_flush_count);
     }
     *pfull = full;
     *ppart = part;
     *pelide = elide;
+    *pmerged = merged;
+}
+
+static void tlb_fill_counts(size_t *phit, size_t *pmiss, size_t *plarge)
+{
+    CPUState *cpu;
+    size_t hit = 0, miss = 0, large = 0;
+
+    CPU_FOREACH(cpu) {
+        hit += qatomic_read(&cpu->neg.tlb.c.vtlb_hit_count);
+        miss += qatomic_read(&cpu->neg.tlb.c.vtlb_miss_count);
+        large += qatomic_read(&cpu->neg.tlb.c.large_page_fill_count);
+    }
+    *phit = hit;
+    *pmiss = miss;
+    *plarge = large;
 }
 
 static void tcg_dump_info(GString *buf)
@@ -150,7 +170,8 @@ static void dump_exec_info(GString *buf)
 {
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
-    size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t nb_tbs, flush_full, flush_part, flush_elide, flush_merged;
+    size_t vtlb_hit, vtlb_miss, large_fill;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -189,13 +210,23 @@ static void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "\nStatistics:\n");
     g_string_append_printf(buf, "TB flush count      %u\n",
                            qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB evict count      %u\n",
+                           qatomic_read(&tb_ctx.tb_evict_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
 
-    tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
+    tlb_flush_counts(&flush_full, &flush_part, &flush_elide, &flush_merged);
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    g_string_append_printf(buf, "TLB merged flushes  %zu\n", flush_merged);
+
+    tlb_fill_counts(&vtlb_hit, &vtlb_miss, &large_fill);
+    g_string_append_printf(buf, "TLB victim hits     %zu (%zu%%)\n", vtlb_hit,
+                           vtlb_hit + vtlb_miss ?
+                           vtlb_hit * 100 / (vtlb_hit + vtlb_miss) : 0);
+    g_string_append_printf(buf, "TLB victim misses   %zu\n", vtlb_miss);
+    g_string_append_printf(buf, "TLB huge page fills %zu\n", large_fill);
     tcg_dump_info(buf);
 }
 
@@ -235,10 +266,131 @@ HumanReadableText *qmp_x_query_opcount(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+static void tb_stats_collect(TBStatistics *s, void *opaque)
+{
+    g_ptr_array_add(opaque, s);
+}
+
+static uint64_t tb_stats_sort_key(const TBStatistics *s, TbStatsSortBy by)
+{
+    switch (by) {
+    case TB_STATS_SORT_BY_TRANSLATION_TIME:
+        return stat64_get(&s->gen_time_ns);
+    case TB_STATS_SORT_BY_HOST_SIZE:
+        return qatomic_read(&s->host_size);
+    default:
+        return stat64_get(&s->executions);
+    }
+}
+
+static gint tb_stats_compare(gconstpointer ap, gconstpointer bp, gpointer data)
+{
+    const TBStatistics *a = *(TBStatistics * const *)ap;
+    const TBStatistics *b = *(TBStatistics * const *)bp;
+    TbStatsSortBy by = *(TbStatsSortBy *)data;
+    uint64_t ka = tb_stats_sort_key(a, by);
+    uint64_t kb = tb_stats_sort_key(b, by);
+
+    /* Descending */
+    return ka < kb ? 1 : ka > kb ? -1 : 0;
+}
+
+static GPtrArray *tb_stats_sorted(TbStatsSortBy by, Error **errp)
+{
+    GPtrArray *arr;
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB statistics are only available with accel=tcg");
+        return NULL;
+    }
+    if (!tb_stats_enabled()) {
+        error_setg(errp, "TB statistics are not enabled, "
+                   "use -accel tcg,tb-stats=sample|full");
+        return NULL;
+    }
+
+    arr = g_ptr_array_new();
+    tb_stats_foreach(tb_stats_collect, arr);
+    g_ptr_array_sort_with_data(arr, tb_stats_compare, &by);
+    return arr;
+}
+
+TbStatsList *qmp_x_query_tb_stats(bool has_sort_by, TbStatsSortBy sort_by,
+                                  bool has_max, uint32_t max, Error **errp)
+{
+    g_autoptr(GPtrArray) arr = NULL;
+    TbStatsList *head = NULL, **tail = &head;
+    guint i, n;
+
+    /* The entries may be freed by a concurrent tb_flush() */
+    RCU_READ_LOCK_GUARD();
+    arr = tb_stats_sorted(has_sort_by ? sort_by : TB_STATS_SORT_BY_EXECUTIONS,
+                          errp);
+    if (!arr) {
+        return NULL;
+    }
+
+    n = has_max ? MIN(max, arr->len) : arr->len;
+    for (i = 0; i < n; i++) {
+        const TBStatistics *s = g_ptr_array_index(arr, i);
+        TbStats *info = g_new0(TbStats, 1);
+        const char *sym = lookup_symbol(s->pc);
+
+        info->pc = s->pc;
+        info->phys_pc = s->phys_pc;
+        info->cs_base = s->cs_base;
+        info->flags = s->flags;
+        if (sym[0]) {
+            info->symbol = g_strdup(sym);
+        }
+        info->executions = stat64_get(&s->executions);
+        info->translations = stat64_get(&s->translations);
+        info->translation_time = stat64_get(&s->gen_time_ns);
+        info->host_size = qatomic_read(&s->host_size);
+        info->guest_size = qatomic_read(&s->guest_size);
+        info->insns = qatomic_read(&s->insns);
+        info->exit_jump0 = stat64_get(&s->exits[TB_EXIT_IDX0]);
+        info->exit_jump1 = stat64_get(&s->exits[TB_EXIT_IDX1]);
+        info->exit_requested = stat64_get(&s->exits[TB_EXIT_REQUESTED]);
+        info->chain_failures = stat64_get(&s->chain_failures);
+        QAPI_LIST_APPEND(tail, info);
+    }
+    return head;
+}
+
+HumanReadableText *qmp_x_query_tb_stats_folded(Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+    g_autoptr(GPtrArray) arr = NULL;
+    guint i;
+
+    RCU_READ_LOCK_GUARD();
+    arr = tb_stats_sorted(TB_STATS_SORT_BY_EXECUTIONS, errp);
+    if (!arr) {
+        return NULL;
+    }
+
+    for (i = 0; i < arr->len; i++) {
+        const TBStatistics *s = g_ptr_array_index(arr, i);
+        const char *sym = lookup_symbol(s->pc);
+        uint64_t executions = stat64_get(&s->executions);
+
+        if (!executions) {
+            break;
+        }
+        g_string_append_printf(buf, "%s;0x%" VADDR_PRIx " %" PRIu64 "\n",
+                               sym[0] ? sym : "[unknown]", s->pc,
+                               executions);
+    }
+
+    return human_readable_text_from_str(buf);
+}
+
 static void hmp_tcg_register(void)
 {
     monitor_register_hmp_info_hrt("jit", qmp_x_query_jit);
     monitor_register_hmp_info_hrt("opcount", qmp_x_query_opcount);
+    monitor_register_hmp_info_hrt("tb-stats", qmp_x_query_tb_stats_folded);
 }
 
 type_init(hmp_tcg_register);
@@ -113,12 +113,11 @@ static void gen_udata_cb(struct qemu_plugin_dyn_cb *cb)
     tcg_temp_free_i32(cpu_index);
 }
 
-static void gen_inline_cb(struct qemu_plugin_dyn_cb *cb)
+/* Return a pointer to the entry of the current vCPU in @score. */
+static TCGv_ptr gen_scoreboard_entry_ptr(struct qemu_plugin_scoreboard *score)
 {
-    GArray *arr = cb->inline_insn.entry.score->data;
-    size_t offset = cb->inline_insn.entry.offset;
+    GArray *arr = score->data;
     TCGv_i32 cpu_index = tcg_temp_ebb_new_i32();
-    TCGv_i64 val = tcg_temp_ebb_new_i64();
     TCGv_ptr ptr = tcg_temp_ebb_new_ptr();
 
     tcg_gen_ld_i32(cpu_index, tcg_env,
@@ -128,6 +127,15 @@ static void gen_inline_cb(struct qemu_plugin_dyn_cb *cb)
     tcg_temp_free_i32(cpu_index);
 
     tcg_gen_addi_ptr(ptr, ptr, (intptr_t)arr->data);
+    return ptr;
+}
+
+static void gen_inline_cb(struct qemu_plugin_dyn_cb *cb)
+{
+    size_t offset = cb->inline_insn.entry.offset;
+    TCGv_i64 val = tcg_temp_ebb_new_i64();
+    TCGv_ptr ptr = gen_scoreboard_entry_ptr(cb->inline_insn.entry.score);
+
     tcg_gen_ld_i64(val, ptr, offset);
     tcg_gen_addi_i64(val, val, cb->inline_insn.imm);
     tcg_gen_st_i64(val, ptr, offset);
@@ -151,6 +159,177 @@ static void gen_mem_cb(struct qemu_plugin_dyn_cb *cb,
     tcg_temp_free_i32(cpu_index);
 }
 
+/*
+ * Append an access to the ring of the current vCPU.  There is no check
+ * for a full ring here: gen_mem_buffer_check has made room beforehand.
+ */
+static void gen_mem_record(struct qemu_plugin_dyn_cb *cb,
+                           qemu_plugin_meminfo_t meminfo, TCGv_i64 addr)
+{
+    struct qemu_plugin_mem_buffer *buf = cb->record.buf;
+    TCGv_ptr ring = gen_scoreboard_entry_ptr(buf->score);
+    TCGv_ptr rec = tcg_temp_ebb_new_ptr();
+    TCGv_i64 count = tcg_temp_ebb_new_i64();
+    TCGv_i64 idx = tcg_temp_ebb_new_i64();
+    size_t base = offsetof(struct qemu_plugin_mem_ring, records);
+
+    tcg_gen_ld_i64(count, ring, offsetof(struct qemu_plugin_mem_ring, count));
+    tcg_gen_andi_i64(idx, count, 2 * buf->n_records - 1);
+    tcg_gen_muli_i64(idx, idx, sizeof(struct qemu_plugin_mem_record));
+    tcg_gen_trunc_i64_ptr(rec, idx);
+    tcg_gen_add_ptr(rec, rec, ring);
+
+    tcg_gen_st_i64(addr, rec,
+                   base + offsetof(struct qemu_plugin_mem_record, vaddr));
+    tcg_gen_st_ptr(tcg_constant_ptr(cb->userp), rec,
+                   base + offsetof(struct qemu_plugin_mem_record, userdata));
+    tcg_gen_st_i32(tcg_constant_i32(meminfo), rec,
+                   base + offsetof(struct qemu_plugin_mem_record, info));
+
+    tcg_gen_addi_i64(count, count, 1);
+    tcg_gen_st_i64(count, ring, offsetof(struct qemu_plugin_mem_ring, count));
+
+    tcg_temp_free_i64(idx);
+    tcg_temp_free_i64(count);
+    tcg_temp_free_ptr(rec);
+    tcg_temp_free_ptr(ring);
+}
+
+static TCGHelperInfo mem_buffer_full_info = {
+    .flags = TCG_CALL_NO_RWG,
+    /* Match qemu_plugin_vcpu_mem_buffer_full */
+    .typemask = (dh_typemask(void, 0) |
+                 dh_typemask(i32, 1) |
+                 dh_typemask(ptr, 2)),
+};
+
+/* Deliver the records of @buf unless there is room for @n more. */
+static void gen_mem_buffer_check(struct qemu_plugin_mem_buffer *buf,
+                                 uint64_t n)
+{
+    TCGLabel *skip = gen_new_label();
+    TCGv_ptr ring = gen_scoreboard_entry_ptr(buf->score);
+    TCGv_i64 count = tcg_temp_ebb_new_i64();
+    TCGv_i32 cpu_index = tcg_temp_ebb_new_i32();
+
+    tcg_gen_ld_i64(count, ring, offsetof(struct qemu_plugin_mem_ring, count));
+    tcg_gen_brcondi_i64(TCG_COND_LEU, count,
+                        buf->n_records - MIN(n, buf->n_records), skip);
+
+    tcg_gen_ld_i32(cpu_index, tcg_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    tcg_gen_call2(qemu_plugin_vcpu_mem_buffer_full, &mem_buffer_full_info,
+                  NULL, tcgv_i32_temp(cpu_index),
+                  tcgv_ptr_temp(tcg_constant_ptr(buf)));
+    gen_set_label(skip);
+
+    tcg_temp_free_i32(cpu_index);
+    tcg_temp_free_i64(count);
+    tcg_temp_free_ptr(ring);
+}
+
+/*
+ * Rather than checking for a full ring at every recorded access, make
+ * room for a run of accesses at once, at the start of the TB or, when
+ * the TB records more accesses than fit in the ring, at the start of
+ * the instruction that begins the next run.
+ *
+ * The branch over the delivery ends the extended basic block, so any
+ * EBB temporary that is live across it would be lost.  None is at the
+ * start of the TB.  Front ends may carry values from one instruction to
+ * the next, e.g. with translator_cc_set(), but only in TB-lifetime
+ * temporaries, and must not keep an EBB temporary across an instruction
+ * boundary.
+ */
+typedef struct MemBufferCheck {
+    /* -1 for the start of the TB */
+    int insn_idx;
+    struct qemu_plugin_mem_buffer *buf;
+    uint64_t n;
+} MemBufferCheck;
+
+static GArray *plan_mem_buffer_checks(struct qemu_plugin_tb *ptb)
+{
+    g_autoptr(GHashTable) runs = NULL;
+    GArray *checks = NULL;
+    int insn_idx = -1;
+    TCGOp *op;
+
+    QTAILQ_FOREACH(op, &tcg_ctx->ops, link) {
+        struct qemu_plugin_insn *insn;
+        qemu_plugin_meminfo_t meminfo;
+        enum qemu_plugin_mem_rw rw;
+        const GArray *cbs;
+
+        if (op->opc == INDEX_op_insn_start) {
+            insn_idx++;
+            continue;
+        }
+        if (op->opc != INDEX_op_plugin_mem_cb) {
+            continue;
+        }
+
+        assert(insn_idx >= 0);
+        insn = g_ptr_array_index(ptb->insns, insn_idx);
+        cbs = insn->mem_cbs;
+        meminfo = op->args[1];
+        rw = (qemu_plugin_mem_is_store(meminfo)
+              ? QEMU_PLUGIN_MEM_W : QEMU_PLUGIN_MEM_R);
+
+        for (int i = 0, e = (cbs ? cbs->len : 0); i < e; i++) {
+            struct qemu_plugin_dyn_cb *cb =
+                &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+            struct qemu_plugin_mem_buffer *buf;
+            MemBufferCheck *check = NULL;
+            gpointer run;
+
+            if (cb->type != PLUGIN_CB_MEM_RECORD || !(cb->rw & rw)) {
+                continue;
+            }
+            buf = cb->record.buf;
+            if (!checks) {
+                checks = g_array_new(false, false, sizeof(MemBufferCheck));
+                runs = g_hash_table_new(NULL, NULL);
+            }
+
+            /* The hash table maps each buffer to its check index + 1. */
+            run = g_hash_table_lookup(runs, buf);
+            if (run) {
+                check = &g_array_index(checks, MemBufferCheck,
+                                       GPOINTER_TO_UINT(run) - 1);
+                if (check->n == buf->n_records &&
+                    check->insn_idx != insn_idx) {
+                    check = NULL;
+                }
+            }
+            if (!check) {
+                MemBufferCheck new = {
+                    .insn_idx = run ? insn_idx : -1,
+                    .buf = buf,
+                };
+
+                g_array_append_val(checks, new);
+                g_hash_table_insert(runs, buf, GUINT_TO_POINTER(checks->len));
+                check = &g_array_index(checks, MemBufferCheck,
+                                       checks->len - 1);
+            }
+            check->n++;
+        }
+    }
+    return checks;
+}
+
+static void gen_mem_buffer_checks(GArray *checks, int insn_idx)
+{
+    for (guint i = 0; checks && i < checks->len; i++) {
+        MemBufferCheck *check = &g_array_index(checks, MemBufferCheck, i);
+
+        if (check->insn_idx == insn_idx) {
+            gen_mem_buffer_check(check->buf, check->n);
+        }
+    }
+}
+
 static void inject_cb(struct qemu_plugin_dyn_cb *cb)
 
 {
@@ -175,6 +354,9 @@ static void inject_mem_cb(struct qemu_plugin_dyn_cb *cb,
         case PLUGIN_CB_MEM_REGULAR:
             gen_mem_cb(cb, meminfo, addr);
             break;
+        case PLUGIN_CB_MEM_RECORD:
+            gen_mem_record(cb, meminfo, addr);
+            break;
         default:
             inject_cb(cb);
             break;
@@ -184,6 +366,7 @@ static void inject_mem_cb(struct qemu_plugin_dyn_cb *cb,
 
 static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
 {
+    g_autoptr(GArray) checks = NULL;
     TCGOp *op, *next;
     int insn_idx = -1;
 
@@ -205,6 +388,8 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
      */
     memset(tcg_ctx->free_temps, 0, sizeof(tcg_ctx->free_temps));
 
+    checks = plan_mem_buffer_checks(plugin_tb);
+
     QTAILQ_FOREACH_SAFE(op, &tcg_ctx->ops, link, next) {
         switch (op->opc) {
         case INDEX_op_insn_start:
@@ -241,6 +426,8 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
             case PLUGIN_GEN_FROM_TB:
                 assert(insn == NULL);
 
+                gen_mem_buffer_checks(checks, -1);
+
                 cbs = plugin_tb->cbs;
                 for (i = 0, n = (cbs ? cbs->len : 0); i < n; i++) {
                     inject_cb(
@@ -252,6 +439,7 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
                 assert(insn != NULL);
 
                 gen_enable_mem_helper(plugin_tb, insn);
+                gen_mem_buffer_checks(checks, insn_idx);
 
                 cbs = insn->insn_cbs;
                 for (i = 0, n = (cbs ? cbs->len : 0); i < n; i++) {
@@ -31,6 +31,7 @@
 #include "tb-context.h"
 #include "internal-common.h"
 #include "internal-target.h"
+#include "tb-stats.h"
 
 
 /* List iterators for lists of tagged pointers in TranslationBlock. */
@@ -50,14 +51,15 @@ static bool tb_cmp(const void *ap, const void *bp)
     return ((tb_cflags(a) & CF_PCREL || a->pc == b->pc) &&
             a->cs_base == b->cs_base &&
             a->flags == b->flags &&
-            (tb_cflags(a) & ~CF_INVALID) == (tb_cflags(b) & ~CF_INVALID) &&
+            (tb_cflags(a) & ~(CF_INVALID | CF_HINT_MASK)) ==
+            (tb_cflags(b) & ~(CF_INVALID | CF_HINT_MASK)) &&
             tb_page_addr0(a) == tb_page_addr0(b) &&
             tb_page_addr1(a) == tb_page_addr1(b));
 }
 
 void tb_htable_init(void)
 {
-    unsigned int mode = QHT_MODE_AUTO_RESIZE;
+    unsigned int mode = QHT_MODE_AUTO_RESIZE | QHT_MODE_INCREMENTAL_RESIZE;
 
     qht_init(&tb_ctx.htable, tb_cmp, CODE_GEN_HTABLE_SIZE, mode);
 }
@@ -768,10 +770,12 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
 
     CPU_FOREACH(cpu) {
         tcg_flush_jmp_cache(cpu);
+        g_ptr_array_set_size(cpu->tb_inval_pending, 0);
     }
 
     qht_reset_size(&tb_ctx.htable, CODE_GEN_HTABLE_SIZE);
     tb_remove_all();
+    tb_stats_reset();
 
     tcg_region_reset_all();
     /* XXX: flush processor icache at this point if cache flush is expensive */
@@ -798,6 +802,51 @@ void tb_flush(CPUState *cpu)
     }
 }
 
+static void tb_evict_invalidate(TranslationBlock *tb)
+{
+    tb_phys_invalidate(tb, -1);
+}
+
+/* evict the oldest region of translations, or flush if there is none */
+static void do_tb_evict(CPUState *cpu, run_on_cpu_data tb_evict_count)
+{
+    CPUState *other;
+    bool evicted;
+
+    mmap_lock();
+    /* If it is already been done on request of another CPU, just retry. */
+    if (tb_ctx.tb_evict_count != tb_evict_count.host_int) {
+        mmap_unlock();
+        return;
+    }
+
+    /* the TBs pending reclamation might be in the region to be reused */
+    CPU_FOREACH(other) {
+        tb_reclaim_pending(other);
+    }
+    qemu_thread_jit_write();
+    evicted = tcg_region_evict(tb_evict_invalidate);
+    qemu_thread_jit_execute();
+    qatomic_inc(&tb_ctx.tb_evict_count);
+    mmap_unlock();
+
+    if (!evicted) {
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_ctx.tb_flush_count));
+    }
+}
+
+void tb_evict(CPUState *cpu)
+{
+    unsigned tb_evict_count = qatomic_read(&tb_ctx.tb_evict_count);
+
+    if (cpu_in_serial_context(cpu)) {
+        do_tb_evict(cpu, RUN_ON_CPU_HOST_INT(tb_evict_count));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_evict,
+                              RUN_ON_CPU_HOST_INT(tb_evict_count));
+    }
+}
+
 /* remove @orig from its @n_orig-th jump list */
 static inline void tb_remove_from_jmp_list(TranslationBlock *orig, int n_orig)
 {
@@ -905,7 +954,11 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
 {
     uint32_t h;
     tb_page_addr_t phys_pc;
-    uint32_t orig_cflags = tb_cflags(tb);
+    /*
+     * A TB pending reclamation already has CF_INVALID set, which was not
+     * part of the cflags it was hashed with.
+     */
+    uint32_t orig_cflags = tb_cflags(tb) & ~CF_INVALID;
 
     assert_memory_lock();
 
@@ -963,6 +1016,32 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
     }
 }
 
+/*
+ * Finish the invalidation of the TBs that @cpu only made unreachable
+ * while handling a guest write to their code; see
+ * tb_phys_invalidate_deferred().
+ * Call with no page locks held, from @cpu or with @cpu stopped.
+ */
+void tb_reclaim_pending(CPUState *cpu)
+{
+    GPtrArray *pending = cpu->tb_inval_pending;
+
+    if (likely(pending->len == 0)) {
+        return;
+    }
+    qemu_thread_jit_write();
+    for (guint i = 0; i < pending->len; i++) {
+        TranslationBlock *tb = g_ptr_array_index(pending, i);
+
+        tb_lock_pages(tb);
+        /* a no-op if the TB has already been removed from the hash table */
+        do_tb_phys_invalidate(tb, true);
+        tb_unlock_pages(tb);
+    }
+    qemu_thread_jit_execute();
+    g_ptr_array_set_size(pending, 0);
+}
+
 /*
  * Add a new TB and link it to the physical page tables.
  * Called with mmap_lock held for user-mode emulation.
@@ -985,13 +1064,18 @@ TranslationBlock *tb_link_page(TranslationBlock *tb)
     /* add in the hash table */
     h = tb_hash_func(tb_page_addr0(tb), (tb->cflags & CF_PCREL ? 0 : tb->pc),
                      tb->flags, tb->cs_base, tb->cflags);
-    qht_insert(&tb_ctx.htable, tb, h, &existing_tb);
-
-    /* remove TB from the page(s) if we couldn't insert it */
-    if (unlikely(existing_tb)) {
-        tb_remove(tb);
-        tb_unlock_pages(tb);
-        return existing_tb;
+    while (unlikely(!qht_insert(&tb_ctx.htable, tb, h, &existing_tb))) {
+        if (!(tb_cflags(existing_tb) & CF_INVALID)) {
+            /* remove TB from the page(s) if we couldn't insert it */
+            tb_remove(tb);
+            tb_unlock_pages(tb);
+            return existing_tb;
+        }
+        /*
+         * An invalidated TB that is still to be reclaimed.  It is on the
+         * same pages as @tb, whose locks we hold, so remove it right away.
+         */
+        do_tb_phys_invalidate(existing_tb, true);
     }
 
     tb_unlock_pages(tb);
@@ -1089,6 +1173,27 @@ bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc)
     return false;
 }
 #else
+/*
+ * Return true if the part of @tb on its @n-th page intersects
+ * with [@start, @last], which may not cross a page.
+ */
+static bool tb_page_intersects(const TranslationBlock *tb, int n,
+                               tb_page_addr_t start, tb_page_addr_t last)
+{
+    tb_page_addr_t tb_start, tb_last;
+
+    /* NOTE: this is subtle as a TB may span two physical pages */
+    tb_start = tb_page_addr0(tb);
+    tb_last = tb_start + tb->size - 1;
+    if (n == 0) {
+        tb_last = MIN(tb_last, tb_start | ~TARGET_PAGE_MASK);
+    } else {
+        tb_start = tb_page_addr1(tb);
+        tb_last = tb_start + (tb_last & ~TARGET_PAGE_MASK);
+    }
+    return !(tb_last < start || tb_start > last);
+}
+
 /*
  * @p must be non-NULL.
  * Call with all @pages locked.
@@ -1114,18 +1219,7 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
      * XXX: see if in some cases it could be faster to invalidate all the code
      */
     PAGE_FOR_EACH_TB(start, last, p, tb, n) {
-        tb_page_addr_t tb_start, tb_last;
-
-        /* NOTE: this is subtle as a TB may span two physical pages */
-        tb_start = tb_page_addr0(tb);
-        tb_last = tb_start + tb->size - 1;
-        if (n == 0) {
-            tb_last = MIN(tb_last, tb_start | ~TARGET_PAGE_MASK);
-        } else {
-            tb_start = tb_page_addr1(tb);
-            tb_last = tb_start + (tb_last & ~TARGET_PAGE_MASK);
-        }
-        if (!(tb_last < start || tb_start > last)) {
+        if (tb_page_intersects(tb, n, start, last)) {
 #ifdef TARGET_HAS_PRECISE_SMC
             if (current_tb == tb &&
                 (tb_cflags(current_tb) & CF_COUNT_MASK) != 1) {
@@ -1193,37 +1287,107 @@ void tb_invalidate_phys_range(tb_page_addr_t start, tb_page_addr_t last)
 }
 
 /*
- * Call with all @pages in the range [@start, @start + len[ locked.
+ * Make @tb unreachable, leaving its removal from the hash table and the
+ * page lists to tb_reclaim_pending() on @cpu.  Unlike tb_phys_invalidate(),
+ * this only needs the lock of one of the pages of @tb: lookups compare
+ * cflags, so they skip @tb as soon as CF_INVALID is set, and the jumps into
+ * @tb are protected by its jmp_lock.
+ */
+static void tb_phys_invalidate_deferred(CPUState *cpu, TranslationBlock *tb)
+{
+    qemu_spin_lock(&tb->jmp_lock);
+    qatomic_set(&tb->cflags, tb->cflags | CF_INVALID);
+    qemu_spin_unlock(&tb->jmp_lock);
+
+    qemu_thread_jit_write();
+    tb_jmp_unlink(tb);
+    qemu_thread_jit_execute();
+
+    g_ptr_array_add(cpu->tb_inval_pending, tb);
+}
+
+/*
+ * Call with @p locked.
+ * Invalidate the TBs of @p that intersect with [@start, @last], which may
+ * not cross a page.  The other pages of those TBs are not locked; see
+ * tb_phys_invalidate_deferred().
  */
-static void tb_invalidate_phys_page_fast__locked(struct page_collection *pages,
+static void tb_invalidate_phys_page_fast__locked(CPUState *cpu, PageDesc *p,
                                                  tb_page_addr_t start,
-                                                 unsigned len, uintptr_t ra)
+                                                 tb_page_addr_t last,
+                                                 uintptr_t retaddr)
 {
-    PageDesc *p;
+    TranslationBlock *tb;
+    PageForEachNext n;
+#ifdef TARGET_HAS_PRECISE_SMC
+    bool current_tb_modified = false;
+    TranslationBlock *current_tb = retaddr ? tcg_tb_lookup(retaddr) : NULL;
+#endif /* TARGET_HAS_PRECISE_SMC */
 
-    p = page_find(start >> TARGET_PAGE_BITS);
-    if (!p) {
-        return;
+    PAGE_FOR_EACH_TB(start, last, p, tb, n) {
+        /*
+         * Skip the TBs already pending reclamation.  A TB spanning two
+         * pages might still be queued twice by concurrent writes to each
+         * page, which tb_reclaim_pending() copes with.
+         */
+        if (tb_cflags(tb) & CF_INVALID ||
+            !tb_page_intersects(tb, n, start, last)) {
+            continue;
+        }
+#ifdef TARGET_HAS_PRECISE_SMC
+        if (current_tb == tb &&
+            (tb_cflags(current_tb) & CF_COUNT_MASK) != 1) {
+            /* See tb_invalidate_phys_page_range__locked() */
+            current_tb_modified = true;
+            cpu_restore_state_from_tb(cpu, current_tb, retaddr);
+        }
+#endif /* TARGET_HAS_PRECISE_SMC */
+        tb_phys_invalidate_deferred(cpu, tb);
     }
 
-    assert_page_locked(p);
-    tb_invalidate_phys_page_range__locked(pages, p, start, start + len - 1, ra);
+    /*
+     * If no code remaining, no need to continue to use slow writes.
+     * TBs pending reclamation still count, because tb_page_add() only
+     * protects the page when adding its first TB.
+     */
+    if (!p->first_tb) {
+        tlb_unprotect_code(start);
+    }
+
+#ifdef TARGET_HAS_PRECISE_SMC
+    if (current_tb_modified) {
+        page_unlock(p);
+        /* Force execution of one insn next time.  */
+        cpu->cflags_next_tb = 1 | CF_NOIRQ | curr_cflags(cpu);
+        mmap_unlock();
+        cpu_loop_exit_noexc(cpu);
+    }
+#endif
 }
 
 /*
  * len must be <= 8 and start must be a multiple of len.
  * Called via softmmu_template.h when code areas are written to with
  * iothread mutex not held.
+ *
+ * This is the common case of self-modifying code, so only the page being
+ * written to is locked, instead of every page of the TBs being invalidated.
  */
-void tb_invalidate_phys_range_fast(ram_addr_t ram_addr,
+void tb_invalidate_phys_range_fast(CPUState *cpu, ram_addr_t ram_addr,
                                    unsigned size,
                                    uintptr_t retaddr)
 {
-    struct page_collection *pages;
+    PageDesc *p;
 
-    pages = page_collection_lock(ram_addr, ram_addr + size - 1);
-    tb_invalidate_phys_page_fast__locked(pages, ram_addr, size, retaddr);
-    page_collection_unlock(pages);
+    p = page_find(ram_addr >> TARGET_PAGE_BITS);
+    if (!p) {
+        return;
+    }
+
+    page_lock(p);
+    tb_invalidate_phys_page_fast__locked(cpu, p, ram_addr,
+                                         ram_addr + size - 1, retaddr);
+    page_unlock(p);
 }
 
 #endif /* CONFIG_USER_ONLY */
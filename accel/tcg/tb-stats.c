@@ -0,0 +1,105 @@
+/*
+ * Per translation block execution and translation statistics
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/qht.h"
+#include "qemu/xxhash.h"
+#include "tb-stats.h"
+
+#define TB_STATS_HTABLE_SIZE (1 << 12)
+
+TBStatsMode tb_stats_mode;
+
+static struct qht tb_stats_htable;
+
+static bool tb_stats_cmp(const void *ap, const void *bp)
+{
+    const TBStatistics *a = ap;
+    const TBStatistics *b = bp;
+
+    return a->phys_pc == b->phys_pc &&
+           a->pc == b->pc &&
+           a->cs_base == b->cs_base &&
+           a->flags == b->flags;
+}
+
+void tb_stats_init(void)
+{
+    qht_init(&tb_stats_htable, tb_stats_cmp, TB_STATS_HTABLE_SIZE,
+             QHT_MODE_AUTO_RESIZE);
+}
+
+TBStatistics *tb_stats_lookup(uint64_t phys_pc, vaddr pc,
+                              uint64_t cs_base, uint32_t flags)
+{
+    TBStatistics key = {
+        .phys_pc = phys_pc,
+        .pc = pc,
+        .cs_base = cs_base,
+        .flags = flags,
+    };
+    uint32_t hash = qemu_xxhash7(phys_pc, pc, cs_base, flags);
+    TBStatistics *s;
+    void *existing = NULL;
+
+    s = qht_lookup(&tb_stats_htable, &key, hash);
+    if (s) {
+        return s;
+    }
+
+    s = g_new0(TBStatistics, 1);
+    *s = key;
+    if (!qht_insert(&tb_stats_htable, s, hash, &existing)) {
+        /* Lost a race with another thread translating the same block. */
+        g_free(s);
+        s = existing;
+    }
+    return s;
+}
+
+static void tb_stats_free(void *p, uint32_t hash, void *userp)
+{
+    TBStatistics *s = p;
+
+    g_free_rcu(s, rcu);
+}
+
+void tb_stats_reset(void)
+{
+    qht_iter(&tb_stats_htable, tb_stats_free, NULL);
+    qht_reset(&tb_stats_htable);
+}
+
+void tb_stats_record_translation(TBStatistics *s, int64_t gen_time_ns,
+                                 uint32_t host_size, uint32_t guest_size,
+                                 uint32_t insns)
+{
+    stat64_add(&s->translations, 1);
+    stat64_add(&s->gen_time_ns, gen_time_ns);
+    qatomic_set(&s->host_size, host_size);
+    qatomic_set(&s->guest_size, guest_size);
+    qatomic_set(&s->insns, insns);
+}
+
+typedef struct TBStatsIterData {
+    void (*func)(TBStatistics *s, void *opaque);
+    void *opaque;
+} TBStatsIterData;
+
+static void tb_stats_iter(void *p, uint32_t hash, void *userp)
+{
+    TBStatsIterData *data = userp;
+
+    data->func(p, data->opaque);
+}
+
+void tb_stats_foreach(void (*func)(TBStatistics *s, void *opaque),
+                      void *opaque)
+{
+    TBStatsIterData data = { .func = func, .opaque = opaque };
+
+    qht_iter(&tb_stats_htable, tb_stats_iter, &data);
+}
@@ -0,0 +1,102 @@
+/*
+ * Per translation block execution and translation statistics
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACCEL_TCG_TB_STATS_H
+#define ACCEL_TCG_TB_STATS_H
+
+#include "exec/vaddr.h"
+#include "qemu/rcu.h"
+#include "qemu/stats64.h"
+
+typedef enum TBStatsMode {
+    TB_STATS_OFF,
+    /* Count only the TBs entered from the execution loop. */
+    TB_STATS_SAMPLE,
+    /* Also count executions through chained jumps, from generated code. */
+    TB_STATS_FULL,
+} TBStatsMode;
+
+/* Indexed by the TB_EXIT_* value returned from the generated code. */
+#define TB_STATS_EXITS 4
+
+/*
+ * Statistics are kept per guest code block, identified like a TB but
+ * without the cflags, so that they accumulate over all translations of
+ * the block.  A TB may point to its entry from generated code for as
+ * long as the TB exists, so entries are only freed when all TBs are,
+ * on tb_flush(), and after an RCU grace period.
+ */
+typedef struct TBStatistics {
+    struct rcu_head rcu;
+    uint64_t phys_pc;
+    vaddr pc;
+    uint64_t cs_base;
+    uint32_t flags;
+
+    Stat64 executions;
+
+    Stat64 exits[TB_STATS_EXITS];
+    /* Exits through a direct jump that could not be chained. */
+    Stat64 chain_failures;
+
+    Stat64 translations;
+    Stat64 gen_time_ns;
+
+    /* Sizes of the most recent translation. */
+    uint32_t host_size;
+    uint32_t guest_size;
+    uint32_t insns;
+} TBStatistics;
+
+extern TBStatsMode tb_stats_mode;
+
+static inline bool tb_stats_enabled(void)
+{
+    return qatomic_read(&tb_stats_mode) != TB_STATS_OFF;
+}
+
+void tb_stats_init(void);
+
+/**
+ * tb_stats_reset:
+ *
+ * Free all statistics entries.  Call from tb_flush(), once no TB
+ * points to them anymore.
+ */
+void tb_stats_reset(void);
+
+/**
+ * tb_stats_lookup:
+ *
+ * Return the statistics entry for the block identified by @phys_pc,
+ * @pc, @cs_base and @flags, creating it if necessary.
+ */
+TBStatistics *tb_stats_lookup(uint64_t phys_pc, vaddr pc,
+                              uint64_t cs_base, uint32_t flags);
+
+/**
+ * tb_stats_record_translation:
+ *
+ * Account a translation of @host_size bytes of host code for
+ * @guest_size bytes and @insns guest instructions, that took
+ * @gen_time_ns nanoseconds.
+ */
+void tb_stats_record_translation(TBStatistics *s, int64_t gen_time_ns,
+                                 uint32_t host_size, uint32_t guest_size,
+                                 uint32_t insns);
+
+/**
+ * tb_stats_foreach:
+ *
+ * Call @func on every statistics entry.  Entries may be updated
+ * concurrently, so the values read are only a snapshot.  The caller
+ * must be in an RCU read-side critical section for as long as it uses
+ * the entries.
+ */
+void tb_stats_foreach(void (*func)(TBStatistics *s, void *opaque),
+                      void *opaque);
+
+#endif /* ACCEL_TCG_TB_STATS_H */
@@ -39,14 +39,20 @@
 #include "hw/boards.h"
 #endif
 #include "internal-target.h"
+#include "tb-stats.h"
 
 struct TCGState {
     AccelState parent_obj;
 
     bool mttcg_enabled;
     bool one_insn_per_tb;
+    bool superblock;
+    uint32_t superblock_threshold;
+    bool translate_ahead;
     int splitwx_enabled;
     unsigned long tb_size;
+    TCGHugePages tb_hugepages;
+    bool tb_numa;
 };
 typedef struct TCGState TCGState;
 
@@ -99,6 +105,9 @@ static void tcg_accel_instance_init(Object *obj)
 
 bool mttcg_enabled;
 bool one_insn_per_tb;
+bool superblock_enabled;
+uint32_t superblock_threshold;
+bool translate_ahead;
 
 static int tcg_init_machine(MachineState *ms)
 {
@@ -114,7 +123,9 @@ static int tcg_init_machine(MachineState *ms)
 
     page_init();
     tb_htable_init();
-    tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus);
+    tb_stats_init();
+    tcg_init(s->tb_size * MiB, s->splitwx_enabled, s->tb_hugepages,
+             s->tb_numa, max_cpus);
 
 #if defined(CONFIG_SOFTMMU)
     /*
@@ -193,6 +204,72 @@ static void tcg_set_splitwx(Object *obj, bool value, Error **errp)
     s->splitwx_enabled = value;
 }
 
+static char *tcg_get_tb_hugepages(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    switch (s->tb_hugepages) {
+    case TCG_HUGEPAGES_EXPLICIT:
+        return g_strdup("explicit");
+    case TCG_HUGEPAGES_OFF:
+        return g_strdup("off");
+    default:
+        return g_strdup("transparent");
+    }
+}
+
+static void tcg_set_tb_hugepages(Object *obj, const char *value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    if (strcmp(value, "transparent") == 0) {
+        s->tb_hugepages = TCG_HUGEPAGES_TRANSPARENT;
+    } else if (strcmp(value, "explicit") == 0) {
+        s->tb_hugepages = TCG_HUGEPAGES_EXPLICIT;
+    } else if (strcmp(value, "off") == 0) {
+        s->tb_hugepages = TCG_HUGEPAGES_OFF;
+    } else {
+        error_setg(errp, "Invalid 'tb-hugepages' setting %s", value);
+    }
+}
+
+static char *tcg_get_tb_stats(Object *obj, Error **errp)
+{
+    switch (qatomic_read(&tb_stats_mode)) {
+    case TB_STATS_SAMPLE:
+        return g_strdup("sample");
+    case TB_STATS_FULL:
+        return g_strdup("full");
+    default:
+        return g_strdup("off");
+    }
+}
+
+static void tcg_set_tb_stats(Object *obj, const char *value, Error **errp)
+{
+    if (strcmp(value, "off") == 0) {
+        qatomic_set(&tb_stats_mode, TB_STATS_OFF);
+    } else if (strcmp(value, "sample") == 0) {
+        qatomic_set(&tb_stats_mode, TB_STATS_SAMPLE);
+    } else if (strcmp(value, "full") == 0) {
+        qatomic_set(&tb_stats_mode, TB_STATS_FULL);
+    } else {
+        error_setg(errp, "Invalid 'tb-stats' setting %s", value);
+    }
+}
+
+static bool tcg_get_tb_numa(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->tb_numa;
+}
+
+static void tcg_set_tb_numa(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->tb_numa = value;
+}
+
 static bool tcg_get_one_insn_per_tb(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -207,6 +284,60 @@ static void tcg_set_one_insn_per_tb(Object *obj, bool value, Error **errp)
     qatomic_set(&one_insn_per_tb, value);
 }
 
+static bool tcg_get_superblock(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->superblock;
+}
+
+static void tcg_set_superblock(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->superblock = value;
+    /* Set the global also: this changes the behaviour */
+    qatomic_set(&superblock_enabled, value);
+}
+
+static void tcg_get_superblock_threshold(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->superblock_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_superblock_threshold(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->superblock_threshold = value;
+    /* Set the global also: this changes the behaviour */
+    qatomic_set(&superblock_threshold, value);
+}
+
+static bool tcg_get_translate_ahead(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->translate_ahead;
+}
+
+static void tcg_set_translate_ahead(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->translate_ahead = value;
+    /* Set the global also: this changes the behaviour */
+    qatomic_set(&translate_ahead, value);
+}
+
 static int tcg_gdbstub_supported_sstep_flags(void)
 {
     /*
@@ -242,6 +373,24 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
     object_class_property_set_description(oc, "tb-size",
         "TCG translation block cache size");
 
+    object_class_property_add_str(oc, "tb-hugepages",
+        tcg_get_tb_hugepages, tcg_set_tb_hugepages);
+    object_class_property_set_description(oc, "tb-hugepages",
+        "Back the translation block cache with transparent or "
+        "explicit huge pages, or with normal pages only");
+
+    object_class_property_add_bool(oc, "tb-numa",
+        tcg_get_tb_numa, tcg_set_tb_numa);
+    object_class_property_set_description(oc, "tb-numa",
+        "Allocate translation block cache regions from the host NUMA "
+        "node of each vCPU thread");
+
+    object_class_property_add_str(oc, "tb-stats",
+        tcg_get_tb_stats, tcg_set_tb_stats);
+    object_class_property_set_description(oc, "tb-stats",
+        "Collect per translation block statistics: off, sample "
+        "(blocks entered from the execution loop) or full");
+
     object_class_property_add_bool(oc, "split-wx",
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
@@ -252,6 +401,25 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
                                    tcg_set_one_insn_per_tb);
     object_class_property_set_description(oc, "one-insn-per-tb",
         "Only put one guest insn in each translation block");
+
+    object_class_property_add_bool(oc, "superblock",
+                                   tcg_get_superblock,
+                                   tcg_set_superblock);
+    object_class_property_set_description(oc, "superblock",
+        "Continue translation blocks across direct jumps");
+
+    object_class_property_add(oc, "superblock-threshold", "int",
+        tcg_get_superblock_threshold, tcg_set_superblock_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "superblock-threshold",
+        "Retranslate translation blocks as superblocks once they have "
+        "been looked up this many times (0 to disable)");
+
+    object_class_property_add_bool(oc, "translate-ahead",
+                                   tcg_get_translate_ahead,
+                                   tcg_set_translate_ahead);
+    object_class_property_set_description(oc, "translate-ahead",
+        "Translate the direct jump targets of new translation blocks");
 }
 
 static const TypeInfo tcg_accel_type = {
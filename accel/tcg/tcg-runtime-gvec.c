@@ -19,6 +19,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/host-utils.h"
+#include "qemu/gvec-accel.h"
 #include "cpu.h"
 #include "exec/helper-proto-common.h"
 #include "tcg/tcg-gvec-desc.h"
@@ -403,31 +404,18 @@ void HELPER(gvec_mov)(void *d, void *a, uint32_t desc)
 void HELPER(gvec_dup64)(void *d, uint32_t desc, uint64_t c)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
     if (c == 0) {
         oprsz = 0;
     } else {
-        for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
-            *(uint64_t *)(d + i) = c;
-        }
+        gvec_accel->dup(d, c, oprsz);
     }
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_dup32)(void *d, uint32_t desc, uint32_t c)
 {
-    intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
-
-    if (c == 0) {
-        oprsz = 0;
-    } else {
-        for (i = 0; i < oprsz; i += sizeof(uint32_t)) {
-            *(uint32_t *)(d + i) = c;
-        }
-    }
-    clear_high(d, oprsz, desc);
+    HELPER(gvec_dup64)(d, desc, 0x0000000100000001ull * c);
 }
 
 void HELPER(gvec_dup16)(void *d, uint32_t desc, uint32_t c)
@@ -586,144 +574,96 @@ void HELPER(gvec_ors)(void *d, void *a, uint64_t b, uint32_t desc)
 void HELPER(gvec_shl8i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
-        *(uint8_t *)(d + i) = *(uint8_t *)(a + i) << shift;
-    }
+    gvec_accel->shli[MO_8](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_shl16i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint16_t)) {
-        *(uint16_t *)(d + i) = *(uint16_t *)(a + i) << shift;
-    }
+    gvec_accel->shli[MO_16](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_shl32i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint32_t)) {
-        *(uint32_t *)(d + i) = *(uint32_t *)(a + i) << shift;
-    }
+    gvec_accel->shli[MO_32](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_shl64i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
-        *(uint64_t *)(d + i) = *(uint64_t *)(a + i) << shift;
-    }
+    gvec_accel->shli[MO_64](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_shr8i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
-        *(uint8_t *)(d + i) = *(uint8_t *)(a + i) >> shift;
-    }
+    gvec_accel->shri[MO_8](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_shr16i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint16_t)) {
-        *(uint16_t *)(d + i) = *(uint16_t *)(a + i) >> shift;
-    }
+    gvec_accel->shri[MO_16](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_shr32i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint32_t)) {
-        *(uint32_t *)(d + i) = *(uint32_t *)(a + i) >> shift;
-    }
+    gvec_accel->shri[MO_32](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_shr64i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
-        *(uint64_t *)(d + i) = *(uint64_t *)(a + i) >> shift;
-    }
+    gvec_accel->shri[MO_64](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_sar8i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
-        *(int8_t *)(d + i) = *(int8_t *)(a + i) >> shift;
-    }
+    gvec_accel->sari[MO_8](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_sar16i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint16_t)) {
-        *(int16_t *)(d + i) = *(int16_t *)(a + i) >> shift;
-    }
+    gvec_accel->sari[MO_16](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_sar32i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint32_t)) {
-        *(int32_t *)(d + i) = *(int32_t *)(a + i) >> shift;
-    }
+    gvec_accel->sari[MO_32](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_sar64i)(void *d, void *a, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    int shift = simd_data(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
-        *(int64_t *)(d + i) = *(int64_t *)(a + i) >> shift;
-    }
+    gvec_accel->sari[MO_64](d, a, simd_data(desc), oprsz);
     clear_high(d, oprsz, desc);
 }
 
@@ -1015,29 +955,26 @@ void HELPER(gvec_rotr64v)(void *d, void *a, void *b, uint32_t desc)
     clear_high(d, oprsz, desc);
 }
 
-#define DO_CMP1(NAME, TYPE, OP)                                            \
+#define DO_CMP1(NAME, OP, VECE)                                            \
 void HELPER(NAME)(void *d, void *a, void *b, uint32_t desc)                \
 {                                                                          \
     intptr_t oprsz = simd_oprsz(desc);                                     \
-    intptr_t i;                                                            \
-    for (i = 0; i < oprsz; i += sizeof(TYPE)) {                            \
-        *(TYPE *)(d + i) = -(*(TYPE *)(a + i) OP *(TYPE *)(b + i));        \
-    }                                                                      \
+    gvec_accel->OP[VECE](d, a, b, oprsz);                                  \
     clear_high(d, oprsz, desc);                                            \
 }
 
-#define DO_CMP2(SZ) \
-    DO_CMP1(gvec_eq##SZ, uint##SZ##_t, ==)    \
-    DO_CMP1(gvec_ne##SZ, uint##SZ##_t, !=)    \
-    DO_CMP1(gvec_lt##SZ, int##SZ##_t, <)      \
-    DO_CMP1(gvec_le##SZ, int##SZ##_t, <=)     \
-    DO_CMP1(gvec_ltu##SZ, uint##SZ##_t, <)    \
-    DO_CMP1(gvec_leu##SZ, uint##SZ##_t, <=)
+#define DO_CMP2(SZ, VECE) \
+    DO_CMP1(gvec_eq##SZ, eq, VECE)    \
+    DO_CMP1(gvec_ne##SZ, ne, VECE)    \
+    DO_CMP1(gvec_lt##SZ, lt, VECE)    \
+    DO_CMP1(gvec_le##SZ, le, VECE)    \
+    DO_CMP1(gvec_ltu##SZ, ltu, VECE)  \
+    DO_CMP1(gvec_leu##SZ, leu, VECE)
 
-DO_CMP2(8)
-DO_CMP2(16)
-DO_CMP2(32)
-DO_CMP2(64)
+DO_CMP2(8, MO_8)
+DO_CMP2(16, MO_16)
+DO_CMP2(32, MO_32)
+DO_CMP2(64, MO_64)
 
 #undef DO_CMP1
 #undef DO_CMP2
@@ -1071,34 +1008,16 @@ DO_CMP2(64)
 void HELPER(gvec_ssadd8)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(int8_t)) {
-        int r = *(int8_t *)(a + i) + *(int8_t *)(b + i);
-        if (r > INT8_MAX) {
-            r = INT8_MAX;
-        } else if (r < INT8_MIN) {
-            r = INT8_MIN;
-        }
-        *(int8_t *)(d + i) = r;
-    }
+    gvec_accel->ssadd[MO_8](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_ssadd16)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(int16_t)) {
-        int r = *(int16_t *)(a + i) + *(int16_t *)(b + i);
-        if (r > INT16_MAX) {
-            r = INT16_MAX;
-        } else if (r < INT16_MIN) {
-            r = INT16_MIN;
-        }
-        *(int16_t *)(d + i) = r;
-    }
+    gvec_accel->ssadd[MO_16](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
@@ -1139,34 +1058,16 @@ void HELPER(gvec_ssadd64)(void *d, void *a, void *b, uint32_t desc)
 void HELPER(gvec_sssub8)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
-        int r = *(int8_t *)(a + i) - *(int8_t *)(b + i);
-        if (r > INT8_MAX) {
-            r = INT8_MAX;
-        } else if (r < INT8_MIN) {
-            r = INT8_MIN;
-        }
-        *(uint8_t *)(d + i) = r;
-    }
+    gvec_accel->sssub[MO_8](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_sssub16)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(int16_t)) {
-        int r = *(int16_t *)(a + i) - *(int16_t *)(b + i);
-        if (r > INT16_MAX) {
-            r = INT16_MAX;
-        } else if (r < INT16_MIN) {
-            r = INT16_MIN;
-        }
-        *(int16_t *)(d + i) = r;
-    }
+    gvec_accel->sssub[MO_16](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
@@ -1207,30 +1108,16 @@ void HELPER(gvec_sssub64)(void *d, void *a, void *b, uint32_t desc)
 void HELPER(gvec_usadd8)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
-        unsigned r = *(uint8_t *)(a + i) + *(uint8_t *)(b + i);
-        if (r > UINT8_MAX) {
-            r = UINT8_MAX;
-        }
-        *(uint8_t *)(d + i) = r;
-    }
+    gvec_accel->usadd[MO_8](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_usadd16)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint16_t)) {
-        unsigned r = *(uint16_t *)(a + i) + *(uint16_t *)(b + i);
-        if (r > UINT16_MAX) {
-            r = UINT16_MAX;
-        }
-        *(uint16_t *)(d + i) = r;
-    }
+    gvec_accel->usadd[MO_16](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
@@ -1271,30 +1158,16 @@ void HELPER(gvec_usadd64)(void *d, void *a, void *b, uint32_t desc)
 void HELPER(gvec_ussub8)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint8_t)) {
-        int r = *(uint8_t *)(a + i) - *(uint8_t *)(b + i);
-        if (r < 0) {
-            r = 0;
-        }
-        *(uint8_t *)(d + i) = r;
-    }
+    gvec_accel->ussub[MO_8](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
 void HELPER(gvec_ussub16)(void *d, void *a, void *b, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint16_t)) {
-        int r = *(uint16_t *)(a + i) - *(uint16_t *)(b + i);
-        if (r < 0) {
-            r = 0;
-        }
-        *(uint16_t *)(d + i) = r;
-    }
+    gvec_accel->ussub[MO_16](d, a, b, oprsz);
     clear_high(d, oprsz, desc);
 }
 
@@ -1559,13 +1432,7 @@ void HELPER(gvec_umax64)(void *d, void *a, void *b, uint32_t desc)
 void HELPER(gvec_bitsel)(void *d, void *a, void *b, void *c, uint32_t desc)
 {
     intptr_t oprsz = simd_oprsz(desc);
-    intptr_t i;
 
-    for (i = 0; i < oprsz; i += sizeof(uint64_t)) {
-        uint64_t aa = *(uint64_t *)(a + i);
-        uint64_t bb = *(uint64_t *)(b + i);
-        uint64_t cc = *(uint64_t *)(c + i);
-        *(uint64_t *)(d + i) = (bb & aa) | (cc & ~aa);
-    }
+    gvec_accel->bitsel(d, a, b, c, oprsz);
     clear_high(d, oprsz, desc);
 }
@@ -61,6 +61,7 @@
 #include "tb-jmp-cache.h"
 #include "tb-hash.h"
 #include "tb-context.h"
+#include "tb-stats.h"
 #include "internal-common.h"
 #include "internal-target.h"
 #include "tcg/perf.h"
@@ -293,15 +294,33 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb_page_addr_t phys_pc, phys_p2;
     tcg_insn_unit *gen_code_buf;
     int gen_code_size, search_size, max_insns;
-    int64_t ti;
+    int64_t ti, gen_start = 0;
     void *host_pc;
 
     assert_memory_lock();
+    /* a write to guest code usually leads here; clean up after it */
+    tb_reclaim_pending(cpu);
     qemu_thread_jit_write();
 
+    if (cflags & CF_SPECULATIVE) {
+        /*
+         * Nothing guarantees that @pc is still mapped, e.g. if the TLB
+         * was flushed since it was last used; a speculative translation
+         * must not fault, so give up unless plain RAM is there.
+         */
+        if (probe_access_flags(env, pc, 1, MMU_INST_FETCH,
+                               cpu_mmu_index(cpu, true), true,
+                               &host_pc, 0)) {
+            return NULL;
+        }
+    }
+
     phys_pc = get_page_addr_code_hostp(env, pc, &host_pc);
 
     if (phys_pc == -1) {
+        if (cflags & CF_SPECULATIVE) {
+            return NULL;
+        }
         /* Generate a one-shot TB with 1 insn in it */
         cflags = (cflags & ~CF_COUNT_MASK) | 1;
     }
@@ -316,8 +335,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     assert_no_pages_locked();
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        if (cflags & CF_SPECULATIVE) {
+            /* Leave it to the next real translation to make room. */
+            return NULL;
+        }
+        /* eviction, or failing that a flush, must be done */
+        tb_evict(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -332,6 +355,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
+    tb->exec_count = 0;
+    tb->tb_stats = NULL;
+    if (tb_stats_enabled() && phys_pc != -1) {
+        tb->tb_stats = tb_stats_lookup(phys_pc, pc, cs_base, flags);
+        gen_start = get_clock();
+    }
     tb_set_page_addr0(tb, phys_pc);
     tb_set_page_addr1(tb, -1);
     if (phys_pc != -1) {
@@ -415,6 +444,17 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
                           "Restarting code generation with re-locked pages");
             goto restart_translate;
 
+        case -4:
+            /*
+             * A speculative translation reached a second page.  Drop it,
+             * returning the space reserved by tcg_tb_alloc.
+             */
+            tb_unlock_pages(tb);
+            tcg_ctx->gen_tb = NULL;
+            tcg_ctx->cpu = NULL;
+            qatomic_set(&tcg_ctx->code_gen_ptr, (void *)tb);
+            return NULL;
+
         default:
             g_assert_not_reached();
         }
@@ -428,6 +468,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
     tb->tc.size = gen_code_size;
 
+    if (tb->tb_stats) {
+        tb_stats_record_translation(tb->tb_stats, get_clock() - gen_start,
+                                    gen_code_size, tb->size, tb->icount);
+    }
+
     /*
      * For CF_PCREL, attribute all executions of the generated code
      * to its first mapping.
@@ -15,7 +15,9 @@
 #include "exec/cpu_ldst.h"
 #include "exec/plugin-gen.h"
 #include "tcg/tcg-op-common.h"
+#include "tcg/tcg-temp-internal.h"
 #include "internal-target.h"
+#include "tb-stats.h"
 
 static void set_can_do_io(DisasContextBase *db, bool val)
 {
@@ -37,6 +39,32 @@ bool translator_io_start(DisasContextBase *db)
     return true;
 }
 
+static void tb_stats_count(TBStatistics *s)
+{
+    stat64_add(&s->executions, 1);
+}
+
+static TCGHelperInfo tb_stats_count_info = {
+    .flags = TCG_CALL_NO_RWG,
+    /* Match tb_stats_count */
+    .typemask = dh_typemask(void, 0) | dh_typemask(ptr, 1),
+};
+
+/*
+ * Count executions from the TB, including those reached by chaining.
+ * The TB may run on several vCPUs at once, so this cannot be a plain
+ * increment in generated code.
+ */
+static void gen_tb_stats_count(TranslationBlock *tb)
+{
+    if (!tb->tb_stats || qatomic_read(&tb_stats_mode) != TB_STATS_FULL) {
+        return;
+    }
+
+    tcg_gen_call1(tb_stats_count, &tb_stats_count_info, NULL,
+                  tcgv_ptr_temp(tcg_constant_ptr(tb->tb_stats)));
+}
+
 static TCGOp *gen_tb_start(DisasContextBase *db, uint32_t cflags)
 {
     TCGv_i32 count = NULL;
@@ -100,6 +128,33 @@ static void gen_tb_end(const TranslationBlock *tb, uint32_t cflags,
     }
 }
 
+/*
+ * Direct jump destinations of the TB most recently translated by this
+ * thread, for use by the execution loop when translating ahead.
+ */
+static __thread vaddr translator_succ[2];
+static __thread int translator_nb_succ;
+
+int translator_successors(vaddr succ[2])
+{
+    for (int i = 0; i < translator_nb_succ; i++) {
+        succ[i] = translator_succ[i];
+    }
+    return translator_nb_succ;
+}
+
+static void translator_record_successor(vaddr dest)
+{
+    for (int i = 0; i < translator_nb_succ; i++) {
+        if (translator_succ[i] == dest) {
+            return;
+        }
+    }
+    if (translator_nb_succ < ARRAY_SIZE(translator_succ)) {
+        translator_succ[translator_nb_succ++] = dest;
+    }
+}
+
 bool translator_use_goto_tb(DisasContextBase *db, vaddr dest)
 {
     /* Suppress goto_tb if requested. */
@@ -108,7 +163,106 @@ bool translator_use_goto_tb(DisasContextBase *db, vaddr dest)
     }
 
     /* Check for the dest on the same page as the start of the TB.  */
-    return ((db->pc_first ^ dest) & TARGET_PAGE_MASK) == 0;
+    if (((db->pc_first ^ dest) & TARGET_PAGE_MASK) != 0) {
+        return false;
+    }
+    translator_record_successor(dest);
+    return true;
+}
+
+bool translator_follow_jump(DisasContextBase *db, vaddr dest)
+{
+    if (!(tb_cflags(db->tb) & CF_SUPERBLOCK)) {
+        return false;
+    }
+
+    /*
+     * Only follow forward jumps within the first page.  The bytes that
+     * are skipped over remain part of [pc_first, pc_next), so that the
+     * page tracking in tb-maint.c, which is based on tb->size, still
+     * invalidates this TB on any write to code it contains.
+     */
+    if (dest < db->pc_next || !is_same_page(db, dest)) {
+        return false;
+    }
+
+    /* There must be room for at least one more insn. */
+    if (db->num_insns >= db->max_insns || tcg_op_buf_full()) {
+        return false;
+    }
+
+    db->pc_next = dest;
+    return true;
+}
+
+void translator_cc_set(DisasContextBase *db, TranslatorCCOp op, bool is_64,
+                       TCGv_i64 src1, TCGv_i64 src2)
+{
+    TranslatorCC *cc = &db->cc;
+
+    cc->op = op;
+    cc->is_64 = is_64;
+    cc->num_insns = db->num_insns;
+    if (!cc->src1) {
+        /*
+         * The record is consumed by the next insn, and there may be a
+         * label in between, e.g. from plugin instrumentation, so the
+         * copies must live for the whole TB.  Allocate them once per TB.
+         */
+        cc->src1 = tcg_temp_new_i64();
+        cc->src2 = tcg_temp_new_i64();
+    }
+    tcg_gen_mov_i64(cc->src1, src1);
+    tcg_gen_mov_i64(cc->src2, src2);
+}
+
+TCGv_i64 translator_cc_setcond(DisasContextBase *db, TCGCond cond)
+{
+    TranslatorCC *cc = &db->cc;
+    TCGv_i64 a, b, ret;
+
+    /*
+     * Only the next insn may use the record: there is no tracking of
+     * other writes to the flags beyond that.
+     */
+    if (cc->op == TRANSLATOR_CC_NONE || db->num_insns > cc->num_insns + 1) {
+        return NULL;
+    }
+
+    a = cc->src1;
+    b = cc->src2;
+    switch (cc->op) {
+    case TRANSLATOR_CC_SUB:
+        break;
+    case TRANSLATOR_CC_ADD:
+        /* x + y == 0 iff x == -y */
+        if (cond != TCG_COND_EQ && cond != TCG_COND_NE) {
+            return NULL;
+        }
+        b = tcg_temp_new_i64();
+        tcg_gen_neg_i64(b, cc->src2);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    if (!cc->is_64) {
+        TCGv_i64 t1 = tcg_temp_new_i64();
+        TCGv_i64 t2 = tcg_temp_new_i64();
+
+        if (is_signed_cond(cond)) {
+            tcg_gen_ext32s_i64(t1, a);
+            tcg_gen_ext32s_i64(t2, b);
+        } else {
+            tcg_gen_ext32u_i64(t1, a);
+            tcg_gen_ext32u_i64(t2, b);
+        }
+        a = t1;
+        b = t2;
+    }
+    ret = tcg_temp_new_i64();
+    tcg_gen_setcond_i64(cond, ret, a, b);
+    return ret;
 }
 
 void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
@@ -129,14 +283,19 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     db->max_insns = *max_insns;
     db->singlestep_enabled = cflags & CF_SINGLE_STEP;
     db->insn_start = NULL;
+    db->cc.op = TRANSLATOR_CC_NONE;
+    db->cc.src1 = NULL;
+    db->cc.src2 = NULL;
     db->host_addr[0] = host_pc;
     db->host_addr[1] = NULL;
+    translator_nb_succ = 0;
 
     ops->init_disas_context(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
     /* Start translating.  */
     icount_start_insn = gen_tb_start(db, cflags);
+    gen_tb_stats_count(tb);
     ops->tb_start(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
@@ -248,6 +407,13 @@ static void *translator_access(CPUArchState *env, DisasContextBase *db,
         host = db->host_addr[0];
         base = db->pc_first;
     } else {
+        /*
+         * A speculative translation must not fault, and the second page
+         * may not be mapped.  Abandon it; tb_gen_code() cleans up.
+         */
+        if (tb_cflags(tb) & CF_SPECULATIVE) {
+            siglongjmp(tcg_ctx->jmp_trans, -4);
+        }
         host = db->host_addr[1];
         base = TARGET_PAGE_ALIGN(db->pc_first);
         if (host == NULL) {
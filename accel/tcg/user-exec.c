@@ -23,6 +23,7 @@
 #include "tcg/tcg.h"
 #include "qemu/bitops.h"
 #include "qemu/rcu.h"
+#include "qemu/seqlock.h"
 #include "exec/cpu_ldst.h"
 #include "exec/translate-all.h"
 #include "exec/helper-proto.h"
@@ -144,7 +145,23 @@ typedef struct PageFlagsNode {
     int flags;
 } PageFlagsNode;
 
+/*
+ * The tree is modified with the mmap lock held, inside pageflags_seq.
+ * Lookups without the lock may see a tree in the middle of a rotation,
+ * which gives false negatives (see util/interval-tree.c), so they are
+ * only trusted if pageflags_seq did not change meanwhile.
+ */
 static IntervalTreeRoot pageflags_root;
+static QemuSeqLock pageflags_seq;
+static unsigned int pageflags_gen;
+
+/* Retries of a lockless lookup before falling back to the mmap lock. */
+#define PAGEFLAGS_LOCKLESS_TRIES  4
+
+unsigned int page_flags_generation(void)
+{
+    return qatomic_read(&pageflags_gen);
+}
 
 static PageFlagsNode *pageflags_find(target_ulong start, target_ulong last)
 {
@@ -209,24 +226,31 @@ void page_dump(FILE *f)
 
 int page_get_flags(target_ulong address)
 {
-    PageFlagsNode *p = pageflags_find(address, address);
+    PageFlagsNode *p;
+    int flags;
 
-    /*
-     * See util/interval-tree.c re lockless lookups: no false positives but
-     * there are false negatives.  If we find nothing, retry with the mmap
-     * lock acquired.
-     */
-    if (p) {
-        return p->flags;
-    }
     if (have_mmap_lock()) {
-        return 0;
+        p = pageflags_find(address, address);
+        return p ? p->flags : 0;
+    }
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        for (int i = 0; i < PAGEFLAGS_LOCKLESS_TRIES; i++) {
+            unsigned seq = seqlock_read_begin(&pageflags_seq);
+
+            p = pageflags_find(address, address);
+            flags = p ? p->flags : 0;
+            if (!seqlock_read_retry(&pageflags_seq, seq)) {
+                return flags;
+            }
+        }
     }
 
     mmap_lock();
     p = pageflags_find(address, address);
+    flags = p ? p->flags : 0;
     mmap_unlock();
-    return p ? p->flags : 0;
+    return flags;
 }
 
 /* A subroutine of page_set_flags: insert a new node for [start,last]. */
@@ -498,6 +522,7 @@ void page_set_flags(target_ulong start, target_ulong last, int flags)
 
     start &= TARGET_PAGE_MASK;
     last |= ~TARGET_PAGE_MASK;
+    qatomic_set(&pageflags_gen, pageflags_gen + 1);
 
     if (!(flags & PAGE_VALID)) {
         flags = 0;
@@ -509,6 +534,7 @@ void page_set_flags(target_ulong start, target_ulong last, int flags)
         }
     }
 
+    seqlock_write_begin(&pageflags_seq);
     if (!flags || reset) {
         page_reset_target_data(start, last);
         inval_tb |= pageflags_unset(start, last);
@@ -517,11 +543,62 @@ void page_set_flags(target_ulong start, target_ulong last, int flags)
         inval_tb |= pageflags_set_clear(start, last, flags,
                                         ~(reset ? 0 : PAGE_STICKY));
     }
+    seqlock_write_end(&pageflags_seq);
     if (inval_tb) {
         tb_invalidate_phys_range(start, last);
     }
 }
 
+/*
+ * A subroutine of page_check_range: check without the mmap lock.
+ * Return 1 or 0 for a definite answer, or -1 if the caller must check
+ * again with the lock held, e.g. because a write-protected page has to
+ * be unprotected.
+ */
+static int pageflags_check_lockless(target_ulong start, target_ulong last,
+                                    int flags)
+{
+    RCU_READ_LOCK_GUARD();
+
+    for (int i = 0; i < PAGEFLAGS_LOCKLESS_TRIES; i++) {
+        unsigned seq = seqlock_read_begin(&pageflags_seq);
+        target_ulong addr = start;
+        int ret;
+
+        while (true) {
+            PageFlagsNode *p = pageflags_find(addr, last);
+            target_ulong p_last;
+            int missing;
+
+            if (!p || addr < p->itree.start) {
+                ret = 0; /* region invalid */
+                break;
+            }
+            missing = flags & ~p->flags;
+            if (missing) {
+                /* Writable but protected pages need the lock. */
+                ret = missing == PAGE_WRITE && (p->flags & PAGE_WRITE_ORG)
+                      ? -1 : 0;
+                break;
+            }
+            p_last = p->itree.last;
+            if (last <= p_last) {
+                ret = 1; /* ok */
+                break;
+            }
+            if (p_last < addr) {
+                ret = -1; /* raced with a writer */
+                break;
+            }
+            addr = p_last + 1;
+        }
+        if (!seqlock_read_retry(&pageflags_seq, seq)) {
+            return ret;
+        }
+    }
+    return -1;
+}
+
 bool page_check_range(target_ulong start, target_ulong len, int flags)
 {
     target_ulong last;
@@ -538,24 +615,23 @@ bool page_check_range(target_ulong start, target_ulong len, int flags)
     }
 
     locked = have_mmap_lock();
+    if (!locked) {
+        int check = pageflags_check_lockless(start, last, flags);
+
+        if (check >= 0) {
+            return check;
+        }
+        mmap_lock();
+        locked = -1;
+    }
+
     while (true) {
         PageFlagsNode *p = pageflags_find(start, last);
         int missing;
 
         if (!p) {
-            if (!locked) {
-                /*
-                 * Lockless lookups have false negatives.
-                 * Retry with the lock held.
-                 */
-                mmap_lock();
-                locked = -1;
-                p = pageflags_find(start, last);
-            }
-            if (!p) {
-                ret = false; /* entire region invalid */
-                break;
-            }
+            ret = false; /* entire region invalid */
+            break;
         }
         if (start < p->itree.start) {
             ret = false; /* initial bytes invalid */
@@ -680,7 +756,10 @@ void page_protect(tb_page_addr_t address)
     }
 
     if (prot & PAGE_WRITE) {
+        qatomic_set(&pageflags_gen, pageflags_gen + 1);
+        seqlock_write_begin(&pageflags_seq);
         pageflags_set_clear(start, last, 0, PAGE_WRITE);
+        seqlock_write_end(&pageflags_seq);
         mprotect(g2h_untagged(start), last - start + 1,
                  prot & (PAGE_READ | PAGE_EXEC) ? PROT_READ : PROT_NONE);
     }
@@ -735,7 +814,9 @@ int page_unprotect(target_ulong address, uintptr_t pc)
             start = address & TARGET_PAGE_MASK;
             len = TARGET_PAGE_SIZE;
             prot = p->flags | PAGE_WRITE;
+            seqlock_write_begin(&pageflags_seq);
             pageflags_set_clear(start, start + len - 1, PAGE_WRITE, 0);
+            seqlock_write_end(&pageflags_seq);
             current_tb_invalidated = tb_invalidate_phys_page_unwind(start, pc);
         } else {
             start = address & -host_page_size;
@@ -750,8 +831,10 @@ int page_unprotect(target_ulong address, uintptr_t pc)
                     prot |= p->flags;
                     if (p->flags & PAGE_WRITE_ORG) {
                         prot |= PAGE_WRITE;
+                        seqlock_write_begin(&pageflags_seq);
                         pageflags_set_clear(addr, addr + TARGET_PAGE_SIZE - 1,
                                             PAGE_WRITE, 0);
+                        seqlock_write_end(&pageflags_seq);
                     }
                 }
                 /*
@@ -24,6 +24,8 @@ static GRand *rng;
 
 static int limit;
 static bool sys;
+static bool batch;
+static struct qemu_plugin_mem_buffer *dmem_records;
 
 enum EvictionPolicy {
     LRU,
@@ -385,21 +387,13 @@ static bool access_cache(Cache *cache, uint64_t addr)
     return false;
 }
 
-static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
-                            uint64_t vaddr, void *userdata)
+static void dcache_access(unsigned int vcpu_index, uint64_t effective_addr,
+                          InsnData *userdata)
 {
-    uint64_t effective_addr;
-    struct qemu_plugin_hwaddr *hwaddr;
     int cache_idx;
     InsnData *insn;
     bool hit_in_l1;
 
-    hwaddr = qemu_plugin_get_hwaddr(info, vaddr);
-    if (hwaddr && qemu_plugin_hwaddr_is_io(hwaddr)) {
-        return;
-    }
-
-    effective_addr = hwaddr ? qemu_plugin_hwaddr_phys_addr(hwaddr) : vaddr;
     cache_idx = vcpu_index % cores;
 
     g_mutex_lock(&l1_dcache_locks[cache_idx]);
@@ -427,6 +421,35 @@ static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
     g_mutex_unlock(&l2_ucache_locks[cache_idx]);
 }
 
+static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
+                            uint64_t vaddr, void *userdata)
+{
+    uint64_t effective_addr;
+    struct qemu_plugin_hwaddr *hwaddr;
+
+    hwaddr = qemu_plugin_get_hwaddr(info, vaddr);
+    if (hwaddr && qemu_plugin_hwaddr_is_io(hwaddr)) {
+        return;
+    }
+
+    effective_addr = hwaddr ? qemu_plugin_hwaddr_phys_addr(hwaddr) : vaddr;
+    dcache_access(vcpu_index, effective_addr, userdata);
+}
+
+/*
+ * With batch=on, data accesses are recorded inline and simulated later
+ * in batches.  This is only supported for user-mode, where the virtual
+ * address is the effective address.
+ */
+static void vcpu_mem_batch(unsigned int vcpu_index,
+                           const struct qemu_plugin_mem_record *records,
+                           size_t n, void *userdata)
+{
+    for (size_t i = 0; i < n; i++) {
+        dcache_access(vcpu_index, records[i].vaddr, records[i].userdata);
+    }
+}
+
 static void vcpu_insn_exec(unsigned int vcpu_index, void *userdata)
 {
     uint64_t insn_addr;
@@ -496,9 +519,13 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
         }
         g_mutex_unlock(&hashtable_lock);
 
-        qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
-                                         QEMU_PLUGIN_CB_NO_REGS,
-                                         rw, data);
+        if (batch) {
+            qemu_plugin_register_vcpu_mem_record(insn, rw, dmem_records, data);
+        } else {
+            qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
+                                             QEMU_PLUGIN_CB_NO_REGS,
+                                             rw, data);
+        }
 
         qemu_plugin_register_vcpu_insn_exec_cb(insn, vcpu_insn_exec,
                                                QEMU_PLUGIN_CB_NO_REGS, data);
@@ -702,6 +729,13 @@ finish:
 
 static void plugin_exit(qemu_plugin_id_t id, void *p)
 {
+    if (batch) {
+        for (int i = 0; i < qemu_plugin_num_vcpus(); i++) {
+            qemu_plugin_mem_buffer_flush(dmem_records, i);
+        }
+        qemu_plugin_mem_buffer_free(dmem_records);
+    }
+
     log_stats();
     log_top_insns();
 
@@ -803,6 +837,11 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
                 fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
                 return -1;
             }
+        } else if (g_strcmp0(tokens[0], "batch") == 0) {
+            if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &batch)) {
+                fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
+                return -1;
+            }
         } else if (g_strcmp0(tokens[0], "evict") == 0) {
             if (g_strcmp0(tokens[1], "rand") == 0) {
                 policy = RAND;
@@ -820,6 +859,11 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
         }
     }
 
+    if (batch && sys) {
+        fprintf(stderr, "batch=on is only supported for user-mode\n");
+        return -1;
+    }
+
     policy_init();
 
     l1_dcaches = caches_init(l1_dblksize, l1_dassoc, l1_dcachesize);
@@ -850,6 +894,10 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
     l1_icache_locks = g_new0(GMutex, cores);
     l2_ucache_locks = use_l2 ? g_new0(GMutex, cores) : NULL;
 
+    if (batch) {
+        dmem_records = qemu_plugin_mem_buffer_new(4096, vcpu_mem_batch, NULL);
+    }
+
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
 
@@ -241,6 +241,15 @@ static inline bool can_use_fpu(const float_status *s)
                   s->float_rounding_mode == float_round_nearest_even);
 }
 
+/* As can_use_fpu(), for operations with an explicit rounding mode. */
+static inline bool can_use_fpu_any_rmode(const float_status *s)
+{
+    if (QEMU_NO_HARDFLOAT) {
+        return false;
+    }
+    return likely(s->float_exception_flags & float_flag_inexact);
+}
+
 /*
  * Hardfloat generation functions. Each operation can have two flavors:
  * either using softfloat primitives (e.g. float32_is_zero_or_normal) for
@@ -401,6 +410,130 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * float16 and bfloat16 operations on normal numbers and zeros are done in
+ * host single precision.  For addition, subtraction, multiplication and
+ * division, float has at least 2p + 2 bits of precision for both formats,
+ * so rounding the host result once more to the narrow format gives the
+ * correctly rounded result.  Results that are not normal numbers in the
+ * narrow format are left to softfloat, which then raises the flags.
+ */
+
+typedef bool (*f16_check_fn)(float16 a, float16 b);
+typedef bool (*bf16_check_fn)(bfloat16 a, bfloat16 b);
+
+typedef float16 (*soft_f16_op2_fn)(float16 a, float16 b, float_status *s);
+typedef bfloat16 (*soft_bf16_op2_fn)(bfloat16 a, bfloat16 b, float_status *s);
+
+static inline bool f16_is_zon2(float16 a, float16 b)
+{
+    return float16_is_zero_or_normal(a) && float16_is_zero_or_normal(b);
+}
+
+static inline bool bf16_is_zon2(bfloat16 a, bfloat16 b)
+{
+    return bfloat16_is_zero_or_normal(a) && bfloat16_is_zero_or_normal(b);
+}
+
+/* Widen a float16 that is a normal number or zero; this is exact. */
+static inline float32 f16_widen(float16 a)
+{
+    uint32_t f = float16_val(a);
+    uint32_t r = (f & 0x8000) << 16;
+
+    if (f & 0x7fff) {
+        r |= ((f & 0x7fff) << 13) + ((127 - 15) << 23);
+    }
+    return make_float32(r);
+}
+
+/*
+ * Round @r to the nearest float16, ties to even.
+ * Return false if the result would not be a normal number.
+ */
+static inline bool f32_narrow_f16(union_float32 r, float16 *pr)
+{
+    uint32_t f = float32_val(r.s);
+    uint32_t mag = f & 0x7fffffff;
+
+    /* at or below the smallest normal, 2**-14: may be tiny before rounding */
+    if (unlikely(mag <= ((127 - 14) << 23))) {
+        return false;
+    }
+    mag += 0xfff + ((mag >> 13) & 1);
+    /* overflows to infinity, or was not finite */
+    if (unlikely(mag >= ((127 + 16) << 23))) {
+        return false;
+    }
+    *pr = make_float16(((f >> 16) & 0x8000) |
+                       ((mag >> 13) - ((127 - 15) << 10)));
+    return true;
+}
+
+/* As f32_narrow_f16(), for bfloat16. */
+static inline bool f32_narrow_bf16(union_float32 r, bfloat16 *pr)
+{
+    uint32_t f = float32_val(r.s);
+    uint32_t mag = f & 0x7fffffff;
+
+    if (unlikely(mag <= (1 << 23))) {
+        return false;
+    }
+    mag += 0x7fff + ((mag >> 16) & 1);
+    if (unlikely(mag >= 0x7f800000)) {
+        return false;
+    }
+    *pr = ((f >> 16) & 0x8000) | (mag >> 16);
+    return true;
+}
+
+static inline float16
+float16_gen2(float16 a, float16 b, float_status *s,
+             hard_f32_op2_fn hard, soft_f16_op2_fn soft, f16_check_fn pre)
+{
+    union_float32 ua, ub, ur;
+    float16 r;
+
+    if (unlikely(!can_use_fpu(s)) || unlikely(!pre(a, b))) {
+        goto soft;
+    }
+
+    ua.s = f16_widen(a);
+    ub.s = f16_widen(b);
+    ur.h = hard(ua.h, ub.h);
+    if (unlikely(!f32_narrow_f16(ur, &r))) {
+        goto soft;
+    }
+    return r;
+
+ soft:
+    return soft(a, b, s);
+}
+
+static inline bfloat16
+bfloat16_gen2(bfloat16 a, bfloat16 b, float_status *s,
+              hard_f32_op2_fn hard, soft_bf16_op2_fn soft, bf16_check_fn pre)
+{
+    union_float32 ua, ub, ur;
+    bfloat16 r;
+
+    if (unlikely(!can_use_fpu(s)) || unlikely(!pre(a, b))) {
+        goto soft;
+    }
+
+    /* widening bfloat16 is exact */
+    ua.s = make_float32((uint32_t)a << 16);
+    ub.s = make_float32((uint32_t)b << 16);
+    ur.h = hard(ua.h, ub.h);
+    if (unlikely(!f32_narrow_bf16(ur, &r))) {
+        goto soft;
+    }
+    return r;
+
+ soft:
+    return soft(a, b, s);
+}
+
 /*
  * Classify a floating point number. Everything above float_class_qnan
  * is a NaN so cls >= float_class_qnan is any NaN.
@@ -1865,8 +1998,8 @@ static floatx80 floatx80_round_pack_canonical(FloatParts128 *p,
  * Addition and subtraction
  */
 
-static float16 QEMU_FLATTEN
-float16_addsub(float16 a, float16 b, float_status *status, bool subtract)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_addsub(float16 a, float16 b, float_status *status, bool subtract)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -1877,14 +2010,14 @@ float16_addsub(float16 a, float16 b, float_status *status, bool subtract)
     return float16_round_pack_canonical(pr, status);
 }
 
-float16 float16_add(float16 a, float16 b, float_status *status)
+static float16 soft_f16_add(float16 a, float16 b, float_status *status)
 {
-    return float16_addsub(a, b, status, false);
+    return soft_f16_addsub(a, b, status, false);
 }
 
-float16 float16_sub(float16 a, float16 b, float_status *status)
+static float16 soft_f16_sub(float16 a, float16 b, float_status *status)
 {
-    return float16_addsub(a, b, status, true);
+    return soft_f16_addsub(a, b, status, true);
 }
 
 static float32 QEMU_SOFTFLOAT_ATTR
@@ -2006,6 +2139,18 @@ float64_sub(float64 a, float64 b, float_status *s)
     return float64_addsub(a, b, s, hard_f64_sub, soft_f64_sub);
 }
 
+float16 QEMU_FLATTEN
+float16_add(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_add, soft_f16_add, f16_is_zon2);
+}
+
+float16 QEMU_FLATTEN
+float16_sub(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_sub, soft_f16_sub, f16_is_zon2);
+}
+
 static float64 float64r32_addsub(float64 a, float64 b, float_status *status,
                                  bool subtract)
 {
@@ -2028,8 +2173,8 @@ float64 float64r32_sub(float64 a, float64 b, float_status *status)
     return float64r32_addsub(a, b, status, true);
 }
 
-static bfloat16 QEMU_FLATTEN
-bfloat16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2040,14 +2185,26 @@ bfloat16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
-bfloat16 bfloat16_add(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 soft_bf16_add(bfloat16 a, bfloat16 b, float_status *status)
 {
-    return bfloat16_addsub(a, b, status, false);
+    return soft_bf16_addsub(a, b, status, false);
 }
 
-bfloat16 bfloat16_sub(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 soft_bf16_sub(bfloat16 a, bfloat16 b, float_status *status)
 {
-    return bfloat16_addsub(a, b, status, true);
+    return soft_bf16_addsub(a, b, status, true);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_add(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_add, soft_bf16_add, bf16_is_zon2);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_sub(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_sub, soft_bf16_sub, bf16_is_zon2);
 }
 
 static float128 QEMU_FLATTEN
@@ -2100,7 +2257,8 @@ floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
  * Multiplication
  */
 
-float16 QEMU_FLATTEN float16_mul(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_mul(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2159,6 +2317,12 @@ float64_mul(float64 a, float64 b, float_status *s)
                         f64_is_zon2, f64_addsubmul_post);
 }
 
+float16 QEMU_FLATTEN
+float16_mul(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_mul, soft_f16_mul, f16_is_zon2);
+}
+
 float64 float64r32_mul(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -2170,8 +2334,8 @@ float64 float64r32_mul(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_mul(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2182,6 +2346,12 @@ bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+bfloat16 QEMU_FLATTEN
+bfloat16_mul(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_mul, soft_bf16_mul, bf16_is_zon2);
+}
+
 float128 QEMU_FLATTEN
 float128_mul(float128 a, float128 b, float_status *status)
 {
@@ -2440,7 +2610,8 @@ float128 QEMU_FLATTEN float128_muladd(float128 a, float128 b, float128 c,
  * Division
  */
 
-float16 float16_div(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_div(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2533,6 +2704,22 @@ float64_div(float64 a, float64 b, float_status *s)
                         f64_div_pre, f64_div_post);
 }
 
+static bool f16_div_pre(float16 a, float16 b)
+{
+    return float16_is_zero_or_normal(a) && float16_is_normal(b);
+}
+
+static bool bf16_div_pre(bfloat16 a, bfloat16 b)
+{
+    return bfloat16_is_zero_or_normal(a) && bfloat16_is_normal(b);
+}
+
+float16 QEMU_FLATTEN
+float16_div(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_div, soft_f16_div, f16_div_pre);
+}
+
 float64 float64r32_div(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -2544,8 +2731,8 @@ float64 float64r32_div(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_div(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2556,6 +2743,12 @@ bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+bfloat16 QEMU_FLATTEN
+bfloat16_div(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_div, soft_bf16_div, bf16_div_pre);
+}
+
 float128 QEMU_FLATTEN
 float128_div(float128 a, float128 b, float_status *status)
 {
@@ -2752,6 +2945,11 @@ float32 float16_to_float32(float16 a, bool ieee, float_status *s)
     const FloatFmt *fmt16 = ieee ? &float16_params : &float16_params_ahp;
     FloatParts64 p;
 
+    /* Widening is exact, and the encodings agree for both formats. */
+    if (likely(float16_is_zero_or_normal(a))) {
+        return f16_widen(a);
+    }
+
     float16a_unpack_canonical(&p, a, s, fmt16);
     parts_float_to_float(&p, s);
     return float32_round_pack_canonical(&p, s);
@@ -2772,6 +2970,16 @@ float16 float32_to_float16(float32 a, bool ieee, float_status *s)
     FloatParts64 p;
     const FloatFmt *fmt;
 
+    if (likely(ieee) && can_use_fpu(s) && float32_is_normal(a)) {
+        union_float32 ua;
+        float16 r;
+
+        ua.s = a;
+        if (likely(f32_narrow_f16(ua, &r))) {
+            return r;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     if (ieee) {
         parts_float_to_float(&p, s);
@@ -2825,7 +3033,8 @@ float16 float64_to_float16(float64 a, bool ieee, float_status *s)
     return float16a_round_pack_canonical(&p, s, fmt);
 }
 
-float32 float64_to_float32(float64 a, float_status *s)
+static float32 QEMU_SOFTFLOAT_ATTR
+soft_float64_to_float32(float64 a, float_status *s)
 {
     FloatParts64 p;
 
@@ -2834,10 +3043,38 @@ float32 float64_to_float32(float64 a, float_status *s)
     return float32_round_pack_canonical(&p, s);
 }
 
+float32 float64_to_float32(float64 a, float_status *s)
+{
+    union_float64 ua;
+    union_float32 ur;
+
+    ua.s = a;
+    if (unlikely(!can_use_fpu(s)) || unlikely(!float64_is_zero_or_normal(a))) {
+        goto soft;
+    }
+    /* Leave anything that might be tiny before rounding to softfloat. */
+    if (unlikely(fabs(ua.h) <= FLT_MIN) && !float64_is_zero(a)) {
+        goto soft;
+    }
+    ur.h = ua.h;
+    if (unlikely(f32_is_inf(ur))) {
+        goto soft;
+    }
+    return ur.s;
+
+ soft:
+    return soft_float64_to_float32(a, s);
+}
+
 float32 bfloat16_to_float32(bfloat16 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (likely(bfloat16_is_normal(a) || bfloat16_is_zero(a))) {
+        /* Widening conversion can never produce inexact results.  */
+        return make_float32((uint32_t)a << 16);
+    }
+
     bfloat16_unpack_canonical(&p, a, s);
     parts_float_to_float(&p, s);
     return float32_round_pack_canonical(&p, s);
@@ -2856,6 +3093,16 @@ bfloat16 float32_to_bfloat16(float32 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (can_use_fpu(s) && float32_is_normal(a)) {
+        union_float32 ua;
+        bfloat16 r;
+
+        ua.s = a;
+        if (likely(f32_narrow_bf16(ua, &r))) {
+            return r;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     parts_float_to_float(&p, s);
     return bfloat16_round_pack_canonical(&p, s);
@@ -2994,6 +3241,20 @@ float32 float32_round_to_int(float32 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (likely(float32_is_zero_or_normal(a))) {
+        union_float32 ua;
+
+        /* Zeros and large numbers are already integral. */
+        if (float32_is_zero(a) || float32_val(float32_abs(a)) >= 0x4b000000) {
+            return a;
+        }
+        if (can_use_fpu(s)) {
+            ua.s = a;
+            ua.h = rintf(ua.h);
+            return ua.s;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float32_params);
     return float32_round_pack_canonical(&p, s);
@@ -3003,6 +3264,21 @@ float64 float64_round_to_int(float64 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (likely(float64_is_zero_or_normal(a))) {
+        union_float64 ua;
+
+        /* Zeros and large numbers are already integral. */
+        if (float64_is_zero(a) ||
+            float64_val(float64_abs(a)) >= 0x4330000000000000ULL) {
+            return a;
+        }
+        if (can_use_fpu(s)) {
+            ua.s = a;
+            ua.h = rint(ua.h);
+            return ua.s;
+        }
+    }
+
     float64_unpack_canonical(&p, a, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float64_params);
     return float64_round_pack_canonical(&p, s);
@@ -3290,11 +3566,31 @@ int16_t float32_to_int16(float32 a, float_status *s)
 
 int32_t float32_to_int32(float32 a, float_status *s)
 {
+    if (can_use_fpu(s) && likely(float32_is_zero_or_normal(a))) {
+        union_float32 ua;
+        double d;
+
+        ua.s = a;
+        d = rint(ua.h);
+        if (likely(d >= -0x1p31 && d < 0x1p31)) {
+            return d;
+        }
+    }
     return float32_to_int32_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
 int64_t float32_to_int64(float32 a, float_status *s)
 {
+    if (can_use_fpu(s) && likely(float32_is_zero_or_normal(a))) {
+        union_float32 ua;
+        double d;
+
+        ua.s = a;
+        d = rint(ua.h);
+        if (likely(d >= -0x1p63 && d < 0x1p63)) {
+            return d;
+        }
+    }
     return float32_to_int64_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
@@ -3305,11 +3601,31 @@ int16_t float64_to_int16(float64 a, float_status *s)
 
 int32_t float64_to_int32(float64 a, float_status *s)
 {
+    if (can_use_fpu(s) && likely(float64_is_zero_or_normal(a))) {
+        union_float64 ua;
+        double d;
+
+        ua.s = a;
+        d = rint(ua.h);
+        if (likely(d >= -0x1p31 && d < 0x1p31)) {
+            return d;
+        }
+    }
     return float64_to_int32_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
 int64_t float64_to_int64(float64 a, float_status *s)
 {
+    if (can_use_fpu(s) && likely(float64_is_zero_or_normal(a))) {
+        union_float64 ua;
+        double d;
+
+        ua.s = a;
+        d = rint(ua.h);
+        if (likely(d >= -0x1p63 && d < 0x1p63)) {
+            return d;
+        }
+    }
     return float64_to_int64_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
@@ -3360,11 +3676,31 @@ int16_t float32_to_int16_round_to_zero(float32 a, float_status *s)
 
 int32_t float32_to_int32_round_to_zero(float32 a, float_status *s)
 {
+    if (can_use_fpu_any_rmode(s) && likely(float32_is_zero_or_normal(a))) {
+        union_float32 ua;
+        double d;
+
+        ua.s = a;
+        d = ua.h;
+        if (likely(d > -0x1p31 - 1 && d < 0x1p31)) {
+            return d;
+        }
+    }
     return float32_to_int32_scalbn(a, float_round_to_zero, 0, s);
 }
 
 int64_t float32_to_int64_round_to_zero(float32 a, float_status *s)
 {
+    if (can_use_fpu_any_rmode(s) && likely(float32_is_zero_or_normal(a))) {
+        union_float32 ua;
+        double d;
+
+        ua.s = a;
+        d = ua.h;
+        if (likely(d >= -0x1p63 && d < 0x1p63)) {
+            return d;
+        }
+    }
     return float32_to_int64_scalbn(a, float_round_to_zero, 0, s);
 }
 
@@ -3375,11 +3711,31 @@ int16_t float64_to_int16_round_to_zero(float64 a, float_status *s)
 
 int32_t float64_to_int32_round_to_zero(float64 a, float_status *s)
 {
+    if (can_use_fpu_any_rmode(s) && likely(float64_is_zero_or_normal(a))) {
+        union_float64 ua;
+        double d;
+
+        ua.s = a;
+        d = ua.h;
+        if (likely(d > -0x1p31 - 1 && d < 0x1p31)) {
+            return d;
+        }
+    }
     return float64_to_int32_scalbn(a, float_round_to_zero, 0, s);
 }
 
 int64_t float64_to_int64_round_to_zero(float64 a, float_status *s)
 {
+    if (can_use_fpu_any_rmode(s) && likely(float64_is_zero_or_normal(a))) {
+        union_float64 ua;
+        double d;
+
+        ua.s = a;
+        d = ua.h;
+        if (likely(d >= -0x1p63 && d < 0x1p63)) {
+            return d;
+        }
+    }
     return float64_to_int64_scalbn(a, float_round_to_zero, 0, s);
 }
 
@@ -3880,8 +4236,12 @@ float32 int64_to_float32_scalbn(int64_t a, int scale, float_status *status)
 {
     FloatParts64 p;
 
-    /* Without scaling, there are no overflow concerns. */
-    if (likely(scale == 0) && can_use_fpu(status)) {
+    /*
+     * Without scaling, there are no overflow concerns.  Integers that
+     * are exactly representable can be converted in any rounding mode.
+     */
+    if (likely(scale == 0) &&
+        (can_use_fpu(status) || (a >= -(1 << 24) && a <= (1 << 24)))) {
         union_float32 ur;
         ur.h = a;
         return ur.s;
@@ -3920,8 +4280,12 @@ float64 int64_to_float64_scalbn(int64_t a, int scale, float_status *status)
 {
     FloatParts64 p;
 
-    /* Without scaling, there are no overflow concerns. */
-    if (likely(scale == 0) && can_use_fpu(status)) {
+    /*
+     * Without scaling, there are no overflow concerns.  Integers that
+     * are exactly representable can be converted in any rounding mode.
+     */
+    if (likely(scale == 0) &&
+        (can_use_fpu(status) || (a >= -(1LL << 53) && a <= (1LL << 53)))) {
         union_float64 ur;
         ur.h = a;
         return ur.s;
@@ -4100,8 +4464,12 @@ float32 uint64_to_float32_scalbn(uint64_t a, int scale, float_status *status)
 {
     FloatParts64 p;
 
-    /* Without scaling, there are no overflow concerns. */
-    if (likely(scale == 0) && can_use_fpu(status)) {
+    /*
+     * Without scaling, there are no overflow concerns.  Integers that
+     * are exactly representable can be converted in any rounding mode.
+     */
+    if (likely(scale == 0) &&
+        (can_use_fpu(status) || (a <= (1 << 24)))) {
         union_float32 ur;
         ur.h = a;
         return ur.s;
@@ -4140,8 +4508,12 @@ float64 uint64_to_float64_scalbn(uint64_t a, int scale, float_status *status)
 {
     FloatParts64 p;
 
-    /* Without scaling, there are no overflow concerns. */
-    if (likely(scale == 0) && can_use_fpu(status)) {
+    /*
+     * Without scaling, there are no overflow concerns.  Integers that
+     * are exactly representable can be converted in any rounding mode.
+     */
+    if (likely(scale == 0) &&
+        (can_use_fpu(status) || (a <= (1ULL << 53)))) {
         union_float64 ur;
         ur.h = a;
         return ur.s;
@@ -4256,10 +4628,41 @@ float128 uint128_to_float128(Int128 a, float_status *status)
  * Minimum and maximum
  */
 
+/*
+ * Outside of NaNs and denormals, which need to raise exceptions, the
+ * magnitudes of two numbers compare like their encodings as integers.
+ * Return true to pick @a, with the same rules as parts_minmax.
+ */
+static inline bool minmax_pick_a(uint64_t a, uint64_t b, int sign_bit,
+                                 int flags)
+{
+    uint64_t mask = MAKE_64BIT_MASK(0, sign_bit);
+    uint64_t ma = a & mask, mb = b & mask;
+    bool sa = a >> sign_bit, sb = b >> sign_bit;
+    int cmp = (ma > mb) - (ma < mb);
+
+    if (!(flags & minmax_ismag) || cmp == 0) {
+        if (sa != sb) {
+            cmp = sa ? -1 : 1;
+        } else if (sa) {
+            cmp = -cmp;
+        }
+    }
+    if (flags & minmax_ismin) {
+        cmp = -cmp;
+    }
+    return cmp >= 0;
+}
+
 static float16 float16_minmax(float16 a, float16 b, float_status *s, int flags)
 {
     FloatParts64 pa, pb, *pr;
 
+    if (likely(!float16_is_any_nan(a) && !float16_is_any_nan(b) &&
+               !float16_is_denormal(a) && !float16_is_denormal(b))) {
+        return minmax_pick_a(float16_val(a), float16_val(b), 15, flags) ? a : b;
+    }
+
     float16_unpack_canonical(&pa, a, s);
     float16_unpack_canonical(&pb, b, s);
     pr = parts_minmax(&pa, &pb, s, flags);
@@ -4272,6 +4675,11 @@ static bfloat16 bfloat16_minmax(bfloat16 a, bfloat16 b,
 {
     FloatParts64 pa, pb, *pr;
 
+    if (likely(!bfloat16_is_any_nan(a) && !bfloat16_is_any_nan(b) &&
+               !bfloat16_is_denormal(a) && !bfloat16_is_denormal(b))) {
+        return minmax_pick_a(a, b, 15, flags) ? a : b;
+    }
+
     bfloat16_unpack_canonical(&pa, a, s);
     bfloat16_unpack_canonical(&pb, b, s);
     pr = parts_minmax(&pa, &pb, s, flags);
@@ -4283,6 +4691,11 @@ static float32 float32_minmax(float32 a, float32 b, float_status *s, int flags)
 {
     FloatParts64 pa, pb, *pr;
 
+    if (likely(!float32_is_any_nan(a) && !float32_is_any_nan(b) &&
+               !float32_is_denormal(a) && !float32_is_denormal(b))) {
+        return minmax_pick_a(float32_val(a), float32_val(b), 31, flags) ? a : b;
+    }
+
     float32_unpack_canonical(&pa, a, s);
     float32_unpack_canonical(&pb, b, s);
     pr = parts_minmax(&pa, &pb, s, flags);
@@ -4294,6 +4707,11 @@ static float64 float64_minmax(float64 a, float64 b, float_status *s, int flags)
 {
     FloatParts64 pa, pb, *pr;
 
+    if (likely(!float64_is_any_nan(a) && !float64_is_any_nan(b) &&
+               !float64_is_denormal(a) && !float64_is_denormal(b))) {
+        return minmax_pick_a(float64_val(a), float64_val(b), 63, flags) ? a : b;
+    }
+
     float64_unpack_canonical(&pa, a, s);
     float64_unpack_canonical(&pb, b, s);
     pr = parts_minmax(&pa, &pb, s, flags);
@@ -4340,11 +4758,28 @@ MINMAX_2(float128)
  * Floating point compare
  */
 
+/*
+ * As for minmax_pick_a, compare two half-precision numbers that are
+ * neither NaNs nor denormals as sign-magnitude integers.
+ */
+static inline FloatRelation half_compare_fast(uint16_t a, uint16_t b)
+{
+    int ka = a & 0x8000 ? -(a & 0x7fff) : a;
+    int kb = b & 0x8000 ? -(b & 0x7fff) : b;
+
+    return (ka > kb) - (ka < kb);
+}
+
 static FloatRelation QEMU_FLATTEN
 float16_do_compare(float16 a, float16 b, float_status *s, bool is_quiet)
 {
     FloatParts64 pa, pb;
 
+    if (likely(!float16_is_any_nan(a) && !float16_is_any_nan(b) &&
+               !float16_is_denormal(a) && !float16_is_denormal(b))) {
+        return half_compare_fast(float16_val(a), float16_val(b));
+    }
+
     float16_unpack_canonical(&pa, a, s);
     float16_unpack_canonical(&pb, b, s);
     return parts_compare(&pa, &pb, s, is_quiet);
@@ -4465,6 +4900,11 @@ bfloat16_do_compare(bfloat16 a, bfloat16 b, float_status *s, bool is_quiet)
 {
     FloatParts64 pa, pb;
 
+    if (likely(!bfloat16_is_any_nan(a) && !bfloat16_is_any_nan(b) &&
+               !bfloat16_is_denormal(a) && !bfloat16_is_denormal(b))) {
+        return half_compare_fast(a, b);
+    }
+
     bfloat16_unpack_canonical(&pa, a, s);
     bfloat16_unpack_canonical(&pb, b, s);
     return parts_compare(&pa, &pb, s, is_quiet);
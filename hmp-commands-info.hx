@@ -270,6 +270,22 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-stats",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show execution counts of translated guest code",
+    },
+#endif
+
+SRST
+  ``info tb-stats``
+    Show the execution count of each block of guest code collected
+    with ``-accel tcg,tb-stats``, in the folded stack format used by
+    flame graph tools.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
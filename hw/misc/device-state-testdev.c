@@ -0,0 +1,171 @@
+/*
+ * Device state test device
+ *
+ * A device without any hardware, that sends a configurable number of
+ * buffers through the multifd channels at the end of precopy migration
+ * and checks on the destination that they are loaded in order.
+ *
+ * Each buffer starts with its index, as a 64-bit little-endian value,
+ * and the rest of it is filled with the low byte of the index.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/module.h"
+#include "qemu/units.h"
+#include "qapi/error.h"
+#include "hw/qdev-properties.h"
+#include "migration/misc.h"
+#include "migration/register.h"
+#include "migration/vmstate.h"
+#include "qom/object.h"
+
+#define TYPE_DEVICE_STATE_TESTDEV "device-state-testdev"
+OBJECT_DECLARE_SIMPLE_TYPE(DeviceStateTestDev, DEVICE_STATE_TESTDEV)
+
+#define DEVICE_STATE_TESTDEV_HDR    sizeof(uint64_t)
+
+struct DeviceStateTestDev {
+    DeviceState parent_obj;
+
+    /* number of buffers to send */
+    uint32_t buffers;
+    /* size of each buffer, including the index */
+    uint32_t size;
+    /* queue the buffers last to first, so that they arrive out of order */
+    bool reverse;
+    /* index of a buffer not to send, UINT32_MAX for none */
+    uint32_t skip;
+    /* number of buffers loaded on the destination */
+    uint32_t loaded;
+};
+
+static int device_state_testdev_save_thread(
+    SaveLiveCompletePrecopyThreadData *d, Error **errp)
+{
+    DeviceStateTestDev *s = d->opaque;
+    g_autofree uint8_t *buf = g_malloc(s->size);
+    uint32_t n, i;
+
+    for (n = 0; n < s->buffers; n++) {
+        i = s->reverse ? s->buffers - 1 - n : n;
+        if (i == s->skip) {
+            continue;
+        }
+
+        stq_le_p(buf, i);
+        memset(buf + DEVICE_STATE_TESTDEV_HDR, i,
+               s->size - DEVICE_STATE_TESTDEV_HDR);
+        /* The destination loads them by index, whatever the queue order */
+        d->idx = i;
+        if (!multifd_queue_device_state(d, buf, s->size)) {
+            error_setg(errp, "failed to queue buffer %u", i);
+            return -1;
+        }
+    }
+    /* Tell the destination how many there are, including any skipped */
+    d->idx = s->buffers;
+    return 0;
+}
+
+static int device_state_testdev_load_buffer(void *opaque, char *buf,
+                                            size_t len, Error **errp)
+{
+    DeviceStateTestDev *s = opaque;
+    uint64_t i;
+    size_t j;
+
+    if (len != s->size) {
+        error_setg(errp, "buffer of %zu bytes, expected %u", len, s->size);
+        return -1;
+    }
+
+    i = ldq_le_p(buf);
+    if (i != s->loaded) {
+        error_setg(errp, "loaded buffer %" PRIu64 ", expected %u",
+                   i, s->loaded);
+        return -1;
+    }
+
+    for (j = DEVICE_STATE_TESTDEV_HDR; j < len; j++) {
+        if ((uint8_t)buf[j] != (uint8_t)i) {
+            error_setg(errp, "buffer %" PRIu64 " is corrupt at offset %zu",
+                       i, j);
+            return -1;
+        }
+    }
+
+    s->loaded++;
+    return 0;
+}
+
+static const SaveVMHandlers device_state_testdev_handlers = {
+    .save_live_complete_precopy_thread = device_state_testdev_save_thread,
+    .load_state_buffer = device_state_testdev_load_buffer,
+};
+
+static void device_state_testdev_realize(DeviceState *dev, Error **errp)
+{
+    DeviceStateTestDev *s = DEVICE_STATE_TESTDEV(dev);
+
+    if (s->size <= DEVICE_STATE_TESTDEV_HDR) {
+        error_setg(errp, "size must be larger than %zu",
+                   DEVICE_STATE_TESTDEV_HDR);
+        return;
+    }
+
+    register_savevm_live(TYPE_DEVICE_STATE_TESTDEV, VMSTATE_INSTANCE_ID_ANY,
+                         1, &device_state_testdev_handlers, s);
+}
+
+static void device_state_testdev_unrealize(DeviceState *dev)
+{
+    DeviceStateTestDev *s = DEVICE_STATE_TESTDEV(dev);
+
+    unregister_savevm(NULL, TYPE_DEVICE_STATE_TESTDEV, s);
+}
+
+static void device_state_testdev_init(Object *obj)
+{
+    DeviceStateTestDev *s = DEVICE_STATE_TESTDEV(obj);
+
+    object_property_add_uint32_ptr(obj, "loaded", &s->loaded,
+                                   OBJ_PROP_FLAG_READ);
+}
+
+static Property device_state_testdev_properties[] = {
+    DEFINE_PROP_UINT32("buffers", DeviceStateTestDev, buffers, 16),
+    DEFINE_PROP_UINT32("size", DeviceStateTestDev, size, 64 * KiB),
+    DEFINE_PROP_BOOL("reverse", DeviceStateTestDev, reverse, false),
+    DEFINE_PROP_UINT32("skip", DeviceStateTestDev, skip, UINT32_MAX),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void device_state_testdev_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->desc = "Device state test device";
+    dc->realize = device_state_testdev_realize;
+    dc->unrealize = device_state_testdev_unrealize;
+    device_class_set_props(dc, device_state_testdev_properties);
+    set_bit(DEVICE_CATEGORY_MISC, dc->categories);
+}
+
+static const TypeInfo device_state_testdev_info = {
+    .name          = TYPE_DEVICE_STATE_TESTDEV,
+    .parent        = TYPE_DEVICE,
+    .instance_size = sizeof(DeviceStateTestDev),
+    .instance_init = device_state_testdev_init,
+    .class_init    = device_state_testdev_class_init,
+};
+
+static void device_state_testdev_register_types(void)
+{
+    type_register_static(&device_state_testdev_info);
+}
+
+type_init(device_state_testdev_register_types)
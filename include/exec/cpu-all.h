@@ -189,6 +189,16 @@ void page_reset_target_data(target_ulong start, target_ulong last);
  */
 bool page_check_range(target_ulong start, target_ulong last, int flags);
 
+/**
+ * page_flags_generation
+ *
+ * Return a counter that changes whenever page flags may have been
+ * removed, e.g. by munmap, mprotect or the write protection of pages
+ * that contain translated code.  A range that passed page_check_range()
+ * still passes as long as the counter has not changed.
+ */
+unsigned int page_flags_generation(void);
+
 /**
  * page_check_range_empty:
  * @start: first byte of range
@@ -45,6 +45,13 @@ struct RAMBlock {
     size_t page_size;
     /* dirty bitmap used during migration */
     unsigned long *bmap;
+    /*
+     * Pages of this block found dirty since the last dirty rate update,
+     * and its smoothed dirty rate in bytes per millisecond.  Only used
+     * by the migration thread on the source.
+     */
+    uint64_t dirty_pages_period;
+    double dirty_rate;
 
     /*
      * Below fields are only used by mapped-ram migration
@@ -77,9 +77,18 @@ struct TranslationBlock {
 #define CF_PARALLEL      0x00008000 /* Generate code for a parallel context */
 #define CF_NOIRQ         0x00010000 /* Generate an uninterruptible TB */
 #define CF_PCREL         0x00020000 /* Opcodes in TB are PC-relative */
+#define CF_SUPERBLOCK    0x00040000 /* Follow direct jumps within the TB */
+#define CF_SPECULATIVE   0x00080000 /* Translated ahead of execution */
 #define CF_CLUSTER_MASK  0xff000000 /* Top 8 bits are cluster ID */
 #define CF_CLUSTER_SHIFT 24
 
+/*
+ * Flags that only change how the guest code is translated, not what
+ * it does.  These are ignored when looking up a TB, so that a TB
+ * retranslated with them replaces the original.
+ */
+#define CF_HINT_MASK     (CF_SUPERBLOCK | CF_SPECULATIVE)
+
     /*
      * Above fields used for comparing
      */
@@ -88,6 +97,16 @@ struct TranslationBlock {
     uint16_t size;
     uint16_t icount;
 
+    /*
+     * Number of times this TB was found by tb_lookup(), when tiered
+     * translation is enabled.  Updated without atomicity, so this is
+     * only an approximation.
+     */
+    uint32_t exec_count;
+
+    /* Statistics entry, when enabled with -accel tcg,tb-stats. */
+    struct TBStatistics *tb_stats;
+
     struct tb_tc tc;
 
     /*
@@ -22,6 +22,7 @@
 #include "exec/cpu-common.h"
 #include "exec/cpu-defs.h"
 #include "exec/abi_ptr.h"
+#include "tcg/tcg-cond.h"
 #include "cpu.h"
 
 /**
@@ -65,6 +66,39 @@ typedef enum DisasJumpType {
     DISAS_TARGET_11,
 } DisasJumpType;
 
+/**
+ * TranslatorCCOp:
+ * @TRANSLATOR_CC_NONE: No flag-setting operation is recorded.
+ * @TRANSLATOR_CC_ADD: Flags were set from src1 + src2.
+ * @TRANSLATOR_CC_SUB: Flags were set from src1 - src2.
+ *
+ * The kind of the last flag-setting operation, see translator_cc_set().
+ */
+typedef enum TranslatorCCOp {
+    TRANSLATOR_CC_NONE,
+    TRANSLATOR_CC_ADD,
+    TRANSLATOR_CC_SUB,
+} TranslatorCCOp;
+
+/**
+ * TranslatorCC:
+ * @op: The last flag-setting operation.
+ * @is_64: True if the operation was 64 bits wide, else 32 bits.
+ * @num_insns: The value of DisasContextBase.num_insns at the time.
+ * @src1: Copy of the first operand.
+ * @src2: Copy of the second operand.
+ *
+ * Operands of the last flag-setting operation, which allow a condition
+ * to be computed directly instead of from the architectural flags.
+ */
+typedef struct TranslatorCC {
+    TranslatorCCOp op;
+    bool is_64;
+    int num_insns;
+    struct TCGv_i64_d *src1;
+    struct TCGv_i64_d *src2;
+} TranslatorCC;
+
 /**
  * DisasContextBase:
  * @tb: Translation block for this disassembly.
@@ -79,6 +113,7 @@ typedef enum DisasJumpType {
  * @plugin_enabled: TCG plugin enabled in this TB.
  * @insn_start: The last op emitted by the insn_start hook,
  *              which is expected to be INDEX_op_insn_start.
+ * @cc: The last flag-setting operation, see translator_cc_set().
  *
  * Architecture-agnostic disassembly context.
  */
@@ -93,6 +128,7 @@ typedef struct DisasContextBase {
     bool plugin_enabled;
     struct TCGOp *insn_start;
     void *host_addr[2];
+    TranslatorCC cc;
 } DisasContextBase;
 
 /**
@@ -164,6 +200,56 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
  */
 bool translator_use_goto_tb(DisasContextBase *db, vaddr dest);
 
+/**
+ * translator_follow_jump
+ * @db: Disassembly context
+ * @dest: target pc of a direct, unconditional jump
+ *
+ * Return true if translation may continue at @dest within the current
+ * TB, instead of ending the TB with a jump.  In that case db->pc_next
+ * has been set to @dest, and the caller must leave db->is_jmp as
+ * DISAS_NEXT without emitting any code for the jump itself.
+ *
+ * This is only done when superblocks are enabled, and only for forward
+ * jumps that stay on the first page of the TB, so that the TB still
+ * covers the single guest range [pc_first, pc_next).
+ */
+bool translator_follow_jump(DisasContextBase *db, vaddr dest);
+
+/**
+ * translator_cc_set
+ * @db: Disassembly context
+ * @op: Kind of flag-setting operation
+ * @is_64: True for a 64-bit operation, false for 32-bit
+ * @src1: First operand
+ * @src2: Second operand
+ *
+ * Record the operands of an instruction which sets the condition flags.
+ * The operands are copied, so the caller may overwrite them afterward.
+ *
+ * The target must still compute the architectural flags; this record
+ * only allows the next instruction to compute a condition without
+ * reading them, via translator_cc_setcond().  If the flags are then
+ * dead, TCG liveness removes the code that computed them.  The copies
+ * are TB-lifetime temporaries, so labels may be emitted in between,
+ * e.g. by plugin instrumentation at the start of the next instruction.
+ */
+void translator_cc_set(DisasContextBase *db, TranslatorCCOp op, bool is_64,
+                       struct TCGv_i64_d *src1, struct TCGv_i64_d *src2);
+
+/**
+ * translator_cc_setcond
+ * @db: Disassembly context
+ * @cond: Comparison between the recorded operands
+ *
+ * If the flags were set by the previous instruction or the current one,
+ * return a new temporary set to (src1 @cond src2), with the operands
+ * extended to 64 bits according to the signedness of @cond.  An ADD only
+ * supports TCG_COND_EQ and TCG_COND_NE, comparing src1 + src2 with 0.
+ * Otherwise return NULL, and the caller must test the flags.
+ */
+struct TCGv_i64_d *translator_cc_setcond(DisasContextBase *db, TCGCond cond);
+
 /**
  * translator_io_start
  * @db: Disassembly context
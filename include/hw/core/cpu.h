@@ -190,8 +190,16 @@ struct CPUClass {
  */
 #define NB_MMU_MODES 16
 
-/* Use a fully associative victim tlb of 8 entries. */
-#define CPU_VTLB_SIZE 8
+/*
+ * The victim tlb is set associative, with CPU_VTLB_WAYS entries per set.
+ * The number of sets is resized along with the main tlb, between
+ * 1 << CPU_VTLB_MIN_BITS and 1 << CPU_VTLB_MAX_BITS, keeping it at
+ * 1 / (1 << CPU_VTLB_SHIFT) of the main tlb size.
+ */
+#define CPU_VTLB_WAYS     4
+#define CPU_VTLB_MIN_BITS 1
+#define CPU_VTLB_MAX_BITS 6
+#define CPU_VTLB_SHIFT    5
 
 /*
  * The full TLB entry, which is not accessed by generated TCG code,
@@ -256,6 +264,21 @@ typedef struct CPUTLBEntryFull {
     } extra;
 } CPUTLBEntryFull;
 
+/* Number of guest large page translations kept per MMU mode. */
+#define CPU_TLB_LARGE_PAGES 4
+
+/*
+ * A guest large page, as added by the target's tlb_fill hook.  The tlb
+ * entries for its other small pages are filled from it, without going
+ * through tlb_fill and walking the guest page tables again.
+ */
+typedef struct CPUTLBLargePage {
+    /* Virtual address of the large page, or -1 if unused.  */
+    vaddr addr;
+    /* As given to tlb_set_page_full, but with the large page's phys_addr.  */
+    CPUTLBEntryFull full;
+} CPUTLBLargePage;
+
 /*
  * Data elements that are per MMU mode, minus the bits accessed by
  * the TCG fast path.
@@ -269,19 +292,38 @@ typedef struct CPUTLBDesc {
      */
     vaddr large_page_addr;
     vaddr large_page_mask;
+    /*
+     * Recently added large pages, all within the region above, so that
+     * any flush touching one of them flushes the entire tlb.
+     */
+    CPUTLBLargePage large_pages[CPU_TLB_LARGE_PAGES];
+    unsigned large_page_next;
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
     size_t window_max_entries;
     size_t n_used_entries;
-    /* The next index to use in the tlb victim table.  */
+    /* The next way to replace in a full set of the tlb victim table.  */
     size_t vindex;
-    /* The tlb victim table, in two parts.  */
-    CPUTLBEntry vtable[CPU_VTLB_SIZE];
-    CPUTLBEntryFull vfulltlb[CPU_VTLB_SIZE];
+    /* log2 of the number of sets in the tlb victim table.  */
+    unsigned vbits;
+    /* The tlb victim table, in two parts, CPU_VTLB_WAYS << vbits entries.  */
+    CPUTLBEntry *vtable;
+    CPUTLBEntryFull *vfulltlb;
     CPUTLBEntryFull *fulltlb;
 } CPUTLBDesc;
 
+/* A flush of @len bytes at @addr, or of everything if @len is 0. */
+typedef struct CPUTLBPendingFlush {
+    vaddr addr;
+    vaddr len;
+    uint16_t idxmap;
+    uint16_t bits;
+} CPUTLBPendingFlush;
+
+/* Number of distinct ranges that may be pending before a full flush. */
+#define CPU_TLB_PENDING_FLUSHES 8
+
 /*
  * Data elements that are shared between all MMU modes.
  */
@@ -294,6 +336,15 @@ typedef struct CPUTLBCommon {
      * Protected by tlb_c.lock.
      */
     uint16_t dirty;
+    /*
+     * Flushes requested by other cpus that have not been processed yet,
+     * merged so that a single work item handles all of them.
+     * Protected by tlb_c.lock.
+     */
+    bool pending_scheduled;
+    uint16_t pending_full;
+    unsigned pending_n;
+    CPUTLBPendingFlush pending[CPU_TLB_PENDING_FLUSHES];
     /*
      * Statistics.  These are not lock protected, but are read and
      * written atomically.  This allows the monitor to print a snapshot
@@ -302,6 +353,10 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    size_t vtlb_hit_count;
+    size_t vtlb_miss_count;
+    size_t large_page_fill_count;
+    size_t coalesced_flush_count;
 } CPUTLBCommon;
 
 /*
@@ -406,6 +461,9 @@ struct qemu_work_item;
  * @num_ases: number of CPUAddressSpaces in @cpu_ases
  * @as: Pointer to the first AddressSpace, for the convenience of targets which
  *      only have a single AddressSpace
+ * @tb_inval_pending: TBs invalidated by this CPU on a guest write, whose
+ *                    removal from the TB hash table and page lists is
+ *                    still to be done.
  * @gdb_regs: Additional GDB registers.
  * @gdb_num_regs: Number of total registers accessible to GDB.
  * @gdb_num_g_regs: Number of registers in GDB 'g' packets.
@@ -478,6 +536,7 @@ struct CPUState {
     MemoryRegion *memory;
 
     CPUJumpCache *tb_jmp_cache;
+    GPtrArray *tb_inval_pending;
 
     GArray *gdb_regs;
     int gdb_num_regs;
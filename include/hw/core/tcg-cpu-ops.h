@@ -23,6 +23,20 @@ struct TCGCPUOps {
      * Called when the first CPU is realized.
      */
     void (*initialize)(void);
+    /**
+     * @superblock: Whether the translator follows direct jumps with
+     * translator_follow_jump() when CF_SUPERBLOCK is set, for code
+     * translated with the cs_base and flags of @tb.  Hot TBs are only
+     * retranslated as superblocks if so.  NULL if it never does.
+     */
+    bool (*superblock)(const TranslationBlock *tb);
+    /**
+     * @translate_ahead: Whether the translator only fetches code with
+     * the translator_ld* functions, which give up on a speculative
+     * translation instead of faulting.  Direct jump destinations are only
+     * translated ahead of execution if so.
+     */
+    bool translate_ahead;
     /**
      * @synchronize_from_tb: Synchronize state from a TCG #TranslationBlock
      *
@@ -35,6 +35,11 @@ OBJECT_DECLARE_TYPE(QIOChannel, QIOChannelClass,
 #define QIO_CHANNEL_WRITE_FLAG_ZERO_COPY 0x1
 
 #define QIO_CHANNEL_READ_FLAG_MSG_PEEK 0x1
+/*
+ * Hint that the caller wants the whole buffer, so the channel may wait
+ * for all of it in a single read.  Channels are free to ignore it.
+ */
+#define QIO_CHANNEL_READ_FLAG_WAITALL 0x2
 
 typedef enum QIOChannelFeature QIOChannelFeature;
 
@@ -882,6 +887,7 @@ void qio_channel_set_aio_fd_handler(QIOChannel *ioc,
  * @niov: the length of the @iov array
  * @fds: an array of file handles to read
  * @nfds: number of file handles in @fds
+ * @flags: read flags (QIO_CHANNEL_READ_FLAG_*)
  * @errp: pointer to a NULL-initialized error object
  *
  *
@@ -900,7 +906,7 @@ int coroutine_mixed_fn qio_channel_readv_full_all_eof(QIOChannel *ioc,
                                                       const struct iovec *iov,
                                                       size_t niov,
                                                       int **fds, size_t *nfds,
-                                                      Error **errp);
+                                                      int flags, Error **errp);
 
 /**
  * qio_channel_readv_full_all:
@@ -909,6 +915,7 @@ int coroutine_mixed_fn qio_channel_readv_full_all_eof(QIOChannel *ioc,
  * @niov: the length of the @iov array
  * @fds: an array of file handles to read
  * @nfds: number of file handles in @fds
+ * @flags: read flags (QIO_CHANNEL_READ_FLAG_*)
  * @errp: pointer to a NULL-initialized error object
  *
  *
@@ -926,7 +933,7 @@ int coroutine_mixed_fn qio_channel_readv_full_all(QIOChannel *ioc,
                                                   const struct iovec *iov,
                                                   size_t niov,
                                                   int **fds, size_t *nfds,
-                                                  Error **errp);
+                                                  int flags, Error **errp);
 
 /**
  * qio_channel_writev_full_all:
@@ -114,6 +114,24 @@ bool migration_incoming_postcopy_advised(void);
 /* True if background snapshot is active */
 bool migration_in_bg_snapshot(void);
 
+/* migration/multifd.c */
+
+struct SaveLiveCompletePrecopyThreadData {
+    const char *idstr;
+    uint32_t instance_id;
+    /* data pointer passed to register_savevm_live() */
+    void *opaque;
+    /*
+     * index of the next buffer queued for the device; when the handler
+     * returns, the number of buffers the destination must load
+     */
+    uint64_t idx;
+};
+
+bool multifd_device_state_supported(void);
+bool multifd_queue_device_state(SaveLiveCompletePrecopyThreadData *d,
+                                const void *data, size_t len);
+
 /* migration/block-dirty-bitmap.c */
 void dirty_bitmap_mig_init(void);
 
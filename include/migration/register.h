@@ -103,6 +103,28 @@ typedef struct SaveVMHandlers {
      */
     int (*save_live_complete_precopy)(QEMUFile *f, void *opaque);
 
+    /**
+     * @save_live_complete_precopy_thread
+     *
+     * Sends device state through the multifd channels at the end of
+     * the precopy phase, with multifd_queue_device_state().  It is
+     * called in a thread of its own, concurrently with the same handler
+     * of other devices, after the iterable sections are complete and
+     * before the non-iterable device state is sent.  The VM is stopped
+     * but the handler runs outside the BQL and must not take it.
+     * On success, @d->idx must be the number of buffers sent, which the
+     * destination checks it has loaded.
+     *
+     * Only called if multifd_device_state_supported() is true.
+     *
+     * @d: the device and the state of its buffer queue
+     * @errp: pointer to Error*, to store an error if it happens.
+     *
+     * Returns zero to indicate success and negative for error
+     */
+    int (*save_live_complete_precopy_thread)(
+        SaveLiveCompletePrecopyThreadData *d, Error **errp);
+
     /* This runs both outside and inside the BQL.  */
 
     /**
@@ -227,6 +249,25 @@ typedef struct SaveVMHandlers {
      */
     int (*load_state)(QEMUFile *f, void *opaque, int version_id);
 
+    /**
+     * @load_state_buffer
+     *
+     * Loads a buffer sent by @save_live_complete_precopy_thread.  It runs
+     * in a multifd receive thread, outside the BQL.  Buffers of one
+     * device are loaded one at a time and in the order they were queued,
+     * but buffers of different devices are loaded in parallel.  All of
+     * them have been loaded before the non-iterable device state.
+     *
+     * @opaque: data pointer passed to register_savevm_live()
+     * @buf: the buffer, only valid for the duration of the call
+     * @len: the size of the buffer
+     * @errp: pointer to Error*, to store an error if it happens.
+     *
+     * Returns zero to indicate success and negative for error
+     */
+    int (*load_state_buffer)(void *opaque, char *buf, size_t len,
+                             Error **errp);
+
     /**
      * @load_setup
      *
@@ -0,0 +1,60 @@
+/*
+ * Host vector implementations of generic vector operations
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef QEMU_GVEC_ACCEL_H
+#define QEMU_GVEC_ACCEL_H
+
+/*
+ * Each operation processes @oprsz bytes, which must be a multiple of 8.
+ * The operands may overlap only if they are identical.  Arrays are
+ * indexed by the log2 of the element size in bytes, as for MemOp.
+ */
+typedef void GVecAccelFn3(void *d, const void *a, const void *b,
+                          intptr_t oprsz);
+typedef void GVecAccelFn4(void *d, const void *a, const void *b,
+                          const void *c, intptr_t oprsz);
+typedef void GVecAccelFnShift(void *d, const void *a, unsigned shift,
+                              intptr_t oprsz);
+typedef void GVecAccelFnDup(void *d, uint64_t c, intptr_t oprsz);
+
+typedef struct GVecAccel {
+    const char *name;
+
+    /* Saturating arithmetic, for 8 and 16-bit elements. */
+    GVecAccelFn3 *ssadd[2];
+    GVecAccelFn3 *usadd[2];
+    GVecAccelFn3 *sssub[2];
+    GVecAccelFn3 *ussub[2];
+
+    /* Shifts by an immediate smaller than the element size. */
+    GVecAccelFnShift *shli[4];
+    GVecAccelFnShift *shri[4];
+    GVecAccelFnShift *sari[4];
+
+    /* Comparisons, setting each element to 0 or -1. */
+    GVecAccelFn3 *eq[4];
+    GVecAccelFn3 *ne[4];
+    GVecAccelFn3 *lt[4];
+    GVecAccelFn3 *le[4];
+    GVecAccelFn3 *ltu[4];
+    GVecAccelFn3 *leu[4];
+
+    /* d = (b & a) | (c & ~a) */
+    GVecAccelFn4 *bitsel;
+    /* Replicate the 64-bit @c. */
+    GVecAccelFnDup *dup;
+} GVecAccel;
+
+/* The best implementation for the host, selected at startup. */
+extern const GVecAccel *gvec_accel;
+
+/*
+ * Switch to the next less capable implementation, for testing.
+ * Return false if the scalar implementation is already in use.
+ */
+bool test_gvec_accel_next(void);
+
+#endif /* QEMU_GVEC_ACCEL_H */
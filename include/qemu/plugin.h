@@ -70,6 +70,7 @@ enum plugin_dyn_cb_type {
     PLUGIN_CB_REGULAR,
     PLUGIN_CB_MEM_REGULAR,
     PLUGIN_CB_INLINE,
+    PLUGIN_CB_MEM_RECORD,
 };
 
 /*
@@ -93,6 +94,9 @@ struct qemu_plugin_dyn_cb {
             enum qemu_plugin_op op;
             uint64_t imm;
         } inline_insn;
+        struct {
+            struct qemu_plugin_mem_buffer *buf;
+        } record;
     };
 };
 
@@ -117,6 +121,26 @@ struct qemu_plugin_scoreboard {
     QLIST_ENTRY(qemu_plugin_scoreboard) entry;
 };
 
+/*
+ * The entry of each vCPU in the scoreboard of a mem record buffer:
+ * the number of records written since the last delivery, followed by
+ * a ring of 2 * n_records records.  Records are delivered once there
+ * are n_records of them; the extra room is for accesses from helpers,
+ * which are recorded in between the checks planned for generated code.
+ */
+struct qemu_plugin_mem_ring {
+    uint64_t count;
+    struct qemu_plugin_mem_record records[];
+};
+
+struct qemu_plugin_mem_buffer {
+    struct qemu_plugin_scoreboard *score;
+    /* a power of 2 */
+    size_t n_records;
+    qemu_plugin_vcpu_mem_batch_cb_t cb;
+    void *userdata;
+};
+
 /*
  * qemu_plugin_insn allocate and cleanup functions. We don't expect to
  * cleanup many of these structures. They are reused for each fresh
@@ -172,6 +196,9 @@ void qemu_plugin_vcpu_syscall_ret(CPUState *cpu, int64_t num, int64_t ret);
 void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                              MemOpIdx oi, enum qemu_plugin_mem_rw rw);
 
+/* Called from generated code when a mem record buffer may overflow. */
+void qemu_plugin_vcpu_mem_buffer_full(unsigned int vcpu_index, void *buf);
+
 void qemu_plugin_flush_cb(void);
 
 void qemu_plugin_atexit_cb(void);
@@ -57,11 +57,16 @@ typedef uint64_t qemu_plugin_id_t;
  * - Remove qemu_plugin_register_vcpu_{tb, insn, mem}_exec_inline.
  *   Those functions are replaced by *_per_vcpu variants, which guarantee
  *   thread-safety for operations.
+ *
+ * version 3:
+ * - added qemu_plugin_register_vcpu_mem_record() and
+ *   qemu_plugin_mem_buffer_{new, flush, free}() to record memory
+ *   accesses inline into per-vCPU buffers.
  */
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 2
+#define QEMU_PLUGIN_VERSION 3
 
 /**
  * struct qemu_info_t - system information for plugins
@@ -228,6 +233,8 @@ struct qemu_plugin_tb;
 struct qemu_plugin_insn;
 /** struct qemu_plugin_scoreboard - Opaque handle for a scoreboard */
 struct qemu_plugin_scoreboard;
+/** struct qemu_plugin_mem_buffer - Opaque handle for a mem record buffer */
+struct qemu_plugin_mem_buffer;
 
 /**
  * typedef qemu_plugin_u64 - uint64_t member of an entry in a scoreboard
@@ -586,6 +593,94 @@ void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
     qemu_plugin_u64 entry,
     uint64_t imm);
 
+/**
+ * struct qemu_plugin_mem_record - a memory access recorded inline
+ * @vaddr: the virtual address of the access
+ * @userdata: the userdata given when registering the instruction
+ * @info: the qemu_plugin_meminfo_t of the access
+ */
+struct qemu_plugin_mem_record {
+    uint64_t vaddr;
+    void *userdata;
+    qemu_plugin_meminfo_t info;
+};
+
+/**
+ * typedef qemu_plugin_vcpu_mem_batch_cb_t - mem record delivery callback
+ * @vcpu_index: the vCPU that performed the accesses
+ * @records: the accesses, oldest first
+ * @n: the number of entries in @records
+ * @userdata: the userdata given to qemu_plugin_mem_buffer_new()
+ */
+typedef void
+(*qemu_plugin_vcpu_mem_batch_cb_t)(unsigned int vcpu_index,
+                                   const struct qemu_plugin_mem_record *records,
+                                   size_t n, void *userdata);
+
+/**
+ * qemu_plugin_mem_buffer_new() - alloc a new per-vCPU mem record buffer
+ * @n_records: capacity of the buffer of each vCPU, rounded up to a power of 2
+ * @cb: callback the records are delivered to
+ * @userdata: opaque pointer passed to @cb
+ *
+ * Memory accesses registered with qemu_plugin_register_vcpu_mem_record()
+ * are written into the buffer of the vCPU by generated code, without
+ * calling out of the translated code. Once the buffer of a vCPU is full,
+ * @cb is called with all of its records, from that vCPU.
+ *
+ * An instruction that performs many more than @n_records accesses, for
+ * example with a loop in its translated code, may overwrite its own
+ * oldest records.
+ *
+ * Returns a pointer to a new buffer. It must be freed using
+ * qemu_plugin_mem_buffer_free.
+ */
+QEMU_PLUGIN_API
+struct qemu_plugin_mem_buffer *
+qemu_plugin_mem_buffer_new(size_t n_records,
+                           qemu_plugin_vcpu_mem_batch_cb_t cb,
+                           void *userdata);
+
+/**
+ * qemu_plugin_mem_buffer_flush() - deliver the pending records of a vCPU
+ * @buf: buffer to flush
+ * @vcpu_index: the vCPU whose records are delivered
+ *
+ * Call the callback of @buf with the records of @vcpu_index that were
+ * not delivered yet, for example from a vCPU exit or an atexit callback.
+ * The vCPU must not be running, unless called from the vCPU itself.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_mem_buffer_flush(struct qemu_plugin_mem_buffer *buf,
+                                  unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_mem_buffer_free() - free a mem record buffer
+ * @buf: buffer to free
+ *
+ * Pending records are dropped; flush them first if needed.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_mem_buffer_free(struct qemu_plugin_mem_buffer *buf);
+
+/**
+ * qemu_plugin_register_vcpu_mem_record() - record mem accesses inline
+ * @insn: handle for instruction to instrument
+ * @rw: record reads, writes or both
+ * @buf: buffer to record the accesses into
+ * @userdata: opaque pointer stored in each record
+ *
+ * This is an inline alternative to qemu_plugin_register_vcpu_mem_cb()
+ * for plugins that can process accesses in batches. As the accesses are
+ * processed after the fact, qemu_plugin_get_hwaddr() cannot be used on
+ * the records.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_register_vcpu_mem_record(struct qemu_plugin_insn *insn,
+                                          enum qemu_plugin_mem_rw rw,
+                                          struct qemu_plugin_mem_buffer *buf,
+                                          void *userdata);
+
 typedef void
 (*qemu_plugin_vcpu_syscall_cb_t)(qemu_plugin_id_t id, unsigned int vcpu_index,
                                  int64_t num, uint64_t a1, uint64_t a2,
@@ -25,16 +25,31 @@
 #ifndef TCG_STARTUP_H
 #define TCG_STARTUP_H
 
+/**
+ * TCGHugePages: How to back the JIT buffer with huge pages
+ * @TCG_HUGEPAGES_TRANSPARENT: Request transparent huge pages.
+ * @TCG_HUGEPAGES_EXPLICIT: Allocate from the hugetlbfs pool.
+ * @TCG_HUGEPAGES_OFF: Use normal pages only.
+ */
+typedef enum TCGHugePages {
+    TCG_HUGEPAGES_TRANSPARENT,
+    TCG_HUGEPAGES_EXPLICIT,
+    TCG_HUGEPAGES_OFF,
+} TCGHugePages;
+
 /**
  * tcg_init: Initialize the TCG runtime
  * @tb_size: translation buffer size
  * @splitwx: use separate rw and rx mappings
+ * @hugepages: huge page policy for the translation buffer
+ * @numa: allocate each thread's regions from its host NUMA node
  * @max_cpus: number of vcpus in system mode
  *
  * Allocate and initialize TCG resources, especially the JIT buffer.
- * In user-only mode, @max_cpus is unused.
+ * In user-only mode, @max_cpus and @numa are unused.
  */
-void tcg_init(size_t tb_size, int splitwx, unsigned max_cpus);
+void tcg_init(size_t tb_size, int splitwx, TCGHugePages hugepages,
+              bool numa, unsigned max_cpus);
 
 /**
  * tcg_register_thread: Register this thread with the TCG runtime
@@ -515,6 +515,9 @@ struct TCGContext {
     /* Threshold to flush the translated code buffer.  */
     void *code_gen_highwater;
 
+    /* Host NUMA node from which to allocate regions.  */
+    int code_gen_node;
+
     /* Track which vCPU triggers events */
     CPUState *cpu;                      /* *_trans */
 
@@ -757,6 +760,7 @@ void tcg_pool_reset(TCGContext *s);
 TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_reset_all(void);
+bool tcg_region_evict(void (*invalidate)(TranslationBlock *tb));
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
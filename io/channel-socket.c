@@ -528,6 +528,9 @@ static ssize_t qio_channel_socket_readv(QIOChannel *ioc,
     if (flags & QIO_CHANNEL_READ_FLAG_MSG_PEEK) {
         sflags |= MSG_PEEK;
     }
+    if (flags & QIO_CHANNEL_READ_FLAG_WAITALL) {
+        sflags |= MSG_WAITALL;
+    }
 
  retry:
     ret = recvmsg(sioc->fd, &msg, sflags);
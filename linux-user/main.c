@@ -422,6 +422,11 @@ static void handle_arg_strace(const char *arg)
     enable_strace = true;
 }
 
+static void handle_arg_syscall_stats(const char *arg)
+{
+    syscall_stats_enable();
+}
+
 static void handle_arg_version(const char *arg)
 {
     printf("qemu-" TARGET_NAME " version " QEMU_FULL_VERSION
@@ -508,6 +513,9 @@ static const struct qemu_argument arg_table[] = {
      "",           "run with one guest instruction per emulated TB"},
     {"strace",     "QEMU_STRACE",      false, handle_arg_strace,
      "",           "log system calls"},
+    {"syscall-stats",
+                   "QEMU_SYSCALL_STATS", false, handle_arg_syscall_stats,
+     "",           "print per-syscall count and latency at exit"},
     {"seed",       "QEMU_RAND_SEED",   true,  handle_arg_seed,
      "",           "Seed for pseudo-random number generator"},
     {"trace",      "QEMU_TRACE",       true,  handle_arg_trace,
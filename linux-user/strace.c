@@ -4178,6 +4178,18 @@ static const struct syscallname scnames[] = {
 
 static int nsyscalls = ARRAY_SIZE(scnames);
 
+const char *strace_syscall_name(int num)
+{
+    int i;
+
+    for (i = 0; i < nsyscalls; i++) {
+        if (scnames[i].nr == num) {
+            return scnames[i].name;
+        }
+    }
+    return NULL;
+}
+
 /*
  * The public interface to this module.
  */
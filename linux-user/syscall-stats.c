@@ -0,0 +1,91 @@
+/*
+ * Per-syscall count and latency statistics
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/stats64.h"
+#include "qemu.h"
+#include "user-internals.h"
+#include "strace.h"
+
+/* Large enough for the syscall numbers of every target, e.g. MIPS n32. */
+#define SYSCALL_STATS_NR    8192
+
+typedef struct SyscallStats {
+    Stat64 count;
+    Stat64 fast;
+    Stat64 total_ns;
+    Stat64 max_ns;
+} SyscallStats;
+
+bool syscall_stats_enabled;
+static SyscallStats *syscall_stats;
+
+void syscall_stats_enable(void)
+{
+    syscall_stats = g_new0(SyscallStats, SYSCALL_STATS_NR);
+    syscall_stats_enabled = true;
+}
+
+void syscall_stats_record(int num, int64_t ns, bool fast)
+{
+    SyscallStats *s;
+
+    /* Target private syscalls, e.g. ARM's, are not accounted. */
+    if (num < 0 || num >= SYSCALL_STATS_NR) {
+        return;
+    }
+    s = &syscall_stats[num];
+    stat64_add(&s->count, 1);
+    stat64_add(&s->total_ns, ns);
+    stat64_max(&s->max_ns, ns);
+    if (fast) {
+        stat64_add(&s->fast, 1);
+    }
+}
+
+static gint syscall_stats_cmp(gconstpointer a, gconstpointer b)
+{
+    uint64_t ta = stat64_get(&syscall_stats[*(const int *)a].total_ns);
+    uint64_t tb = stat64_get(&syscall_stats[*(const int *)b].total_ns);
+
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+void syscall_stats_dump(void)
+{
+    g_autoptr(GArray) nums = NULL;
+
+    if (!syscall_stats_enabled) {
+        return;
+    }
+
+    nums = g_array_new(false, false, sizeof(int));
+    for (int i = 0; i < SYSCALL_STATS_NR; i++) {
+        if (stat64_get(&syscall_stats[i].count)) {
+            g_array_append_val(nums, i);
+        }
+    }
+    g_array_sort(nums, syscall_stats_cmp);
+
+    fprintf(stderr, "%-20s %12s %12s %14s %12s %12s\n", "syscall",
+            "calls", "fast", "total (us)", "avg (ns)", "max (ns)");
+    for (guint i = 0; i < nums->len; i++) {
+        int num = g_array_index(nums, int, i);
+        SyscallStats *s = &syscall_stats[num];
+        const char *name = strace_syscall_name(num);
+        uint64_t count = stat64_get(&s->count);
+        uint64_t total = stat64_get(&s->total_ns);
+        g_autofree char *unknown = NULL;
+
+        if (!name) {
+            name = unknown = g_strdup_printf("syscall %d", num);
+        }
+        fprintf(stderr, "%-20s %12" PRIu64 " %12" PRIu64 " %14" PRIu64
+                " %12" PRIu64 " %12" PRIu64 "\n", name, count,
+                stat64_get(&s->fast), total / 1000, total / count,
+                stat64_get(&s->max_ns));
+    }
+}
@@ -23,6 +23,7 @@
 #include "qemu/memfd.h"
 #include "qemu/queue.h"
 #include "qemu/plugin.h"
+#include "qemu/timer.h"
 #include "tcg/startup.h"
 #include "target_mman.h"
 #include <elf.h>
@@ -13747,13 +13748,132 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
     return ret;
 }
 
+#ifndef CONFIG_DEBUG_REMAP
+/*
+ * The last guest ranges that passed access_ok() in this thread, for
+ * reading and for writing.  I/O-heavy guests tend to reuse the same
+ * buffers, so this usually saves the walk of the page flags.  The
+ * ranges are dropped whenever page_flags_generation() changes.
+ */
+typedef struct FastAccessRange {
+    abi_ulong start;
+    abi_ulong last;
+    unsigned int gen;
+    bool valid;
+} FastAccessRange;
+
+static __thread FastAccessRange fast_access_range[2];
+
+/*
+ * Like lock_user() for a non-zero @len, but without the bounce buffer
+ * of CONFIG_DEBUG_REMAP there is nothing to unlock.
+ */
+static void *lock_user_fast(int type, abi_ulong guest_addr, abi_ulong len)
+{
+    FastAccessRange *r = &fast_access_range[type == VERIFY_WRITE];
+    unsigned int gen = page_flags_generation();
+    abi_ulong last;
+
+    guest_addr = cpu_untagged_addr(thread_cpu, guest_addr);
+    last = guest_addr + len - 1;
+    if (r->valid && r->gen == gen &&
+        r->start <= guest_addr && guest_addr <= last && last <= r->last) {
+        return g2h_untagged(guest_addr);
+    }
+    if (!access_ok_untagged(type, guest_addr, len)) {
+        return NULL;
+    }
+    r->start = guest_addr & TARGET_PAGE_MASK;
+    r->last = last | ~TARGET_PAGE_MASK;
+    r->gen = gen;
+    r->valid = true;
+    return g2h_untagged(guest_addr);
+}
+
+/*
+ * Fast path for the read and write syscalls that dominate I/O-heavy
+ * guests.  Return false to leave anything out of the ordinary, such as
+ * fds with a data translator or invalid buffers, to do_syscall1().
+ */
+static bool do_syscall_fast(CPUArchState *cpu_env, int num, abi_long arg1,
+                            abi_long arg2, abi_long arg3, abi_long arg4,
+                            abi_long arg5, abi_long arg6, abi_long *ret)
+{
+    void *p;
+
+    switch (num) {
+    case TARGET_NR_read:
+        if (arg3 == 0 || fd_trans_host_to_target_data(arg1)) {
+            return false;
+        }
+        p = lock_user_fast(VERIFY_WRITE, arg2, arg3);
+        if (!p) {
+            return false;
+        }
+        *ret = get_errno(safe_read(arg1, p, arg3));
+        return true;
+    case TARGET_NR_write:
+        if (arg3 == 0 || fd_trans_target_to_host_data(arg1)) {
+            return false;
+        }
+        p = lock_user_fast(VERIFY_READ, arg2, arg3);
+        if (!p) {
+            return false;
+        }
+        *ret = get_errno(safe_write(arg1, p, arg3));
+        return true;
+#ifdef TARGET_NR_pread64
+    case TARGET_NR_pread64:
+        if (regpairs_aligned(cpu_env, num)) {
+            arg4 = arg5;
+            arg5 = arg6;
+        }
+        if (arg3 == 0) {
+            return false;
+        }
+        p = lock_user_fast(VERIFY_WRITE, arg2, arg3);
+        if (!p) {
+            return false;
+        }
+        *ret = get_errno(pread64(arg1, p, arg3, target_offset64(arg4, arg5)));
+        return true;
+    case TARGET_NR_pwrite64:
+        if (regpairs_aligned(cpu_env, num)) {
+            arg4 = arg5;
+            arg5 = arg6;
+        }
+        if (arg3 == 0) {
+            return false;
+        }
+        p = lock_user_fast(VERIFY_READ, arg2, arg3);
+        if (!p) {
+            return false;
+        }
+        *ret = get_errno(pwrite64(arg1, p, arg3, target_offset64(arg4, arg5)));
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+#else
+static bool do_syscall_fast(CPUArchState *cpu_env, int num, abi_long arg1,
+                            abi_long arg2, abi_long arg3, abi_long arg4,
+                            abi_long arg5, abi_long arg6, abi_long *ret)
+{
+    return false;
+}
+#endif
+
 abi_long do_syscall(CPUArchState *cpu_env, int num, abi_long arg1,
                     abi_long arg2, abi_long arg3, abi_long arg4,
                     abi_long arg5, abi_long arg6, abi_long arg7,
                     abi_long arg8)
 {
     CPUState *cpu = env_cpu(cpu_env);
+    int64_t start = 0;
     abi_long ret;
+    bool fast;
 
 #ifdef DEBUG_ERESTARTSYS
     /* Debug-only code for exercising the syscall-restart code paths
@@ -13769,6 +13889,10 @@ abi_long do_syscall(CPUArchState *cpu_env, int num, abi_long arg1,
     }
 #endif
 
+    if (unlikely(syscall_stats_enabled)) {
+        start = get_clock();
+    }
+
     record_syscall_start(cpu, num, arg1,
                          arg2, arg3, arg4, arg5, arg6, arg7, arg8);
 
@@ -13776,8 +13900,12 @@ abi_long do_syscall(CPUArchState *cpu_env, int num, abi_long arg1,
         print_syscall(cpu_env, num, arg1, arg2, arg3, arg4, arg5, arg6);
     }
 
-    ret = do_syscall1(cpu_env, num, arg1, arg2, arg3, arg4,
-                      arg5, arg6, arg7, arg8);
+    fast = do_syscall_fast(cpu_env, num, arg1, arg2, arg3, arg4,
+                           arg5, arg6, &ret);
+    if (!fast) {
+        ret = do_syscall1(cpu_env, num, arg1, arg2, arg3, arg4,
+                          arg5, arg6, arg7, arg8);
+    }
 
     if (unlikely(qemu_loglevel_mask(LOG_STRACE))) {
         print_syscall_ret(cpu_env, num, ret, arg1, arg2,
@@ -13785,5 +13913,9 @@ abi_long do_syscall(CPUArchState *cpu_env, int num, abi_long arg1,
     }
 
     record_syscall_return(cpu, num, ret);
+
+    if (unlikely(syscall_stats_enabled)) {
+        syscall_stats_record(num, get_clock() - start, fast);
+    }
     return ret;
 }
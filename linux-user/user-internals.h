@@ -168,6 +168,12 @@ static inline int regpairs_aligned(CPUArchState *cpu_env, int num) { return 1; }
 static inline int regpairs_aligned(CPUArchState *cpu_env, int num) { return 0; }
 #endif
 
+/* syscall-stats.c */
+extern bool syscall_stats_enabled;
+void syscall_stats_enable(void);
+void syscall_stats_record(int num, int64_t ns, bool fast);
+void syscall_stats_dump(void);
+
 /**
  * preexit_cleanup: housekeeping before the guest exits
  *
@@ -191,6 +191,30 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
                        info->cpu_throttle_percentage);
     }
 
+    if (info->switchover_prediction) {
+        SwitchoverPrediction *pred = info->switchover_prediction;
+
+        monitor_printf(mon, "predicted bandwidth: %" PRIu64 " kbytes/s\n",
+                       pred->bandwidth >> 10);
+        monitor_printf(mon, "predicted dirty rate: %" PRIu64 " kbytes/s\n",
+                       pred->dirty_rate >> 10);
+        monitor_printf(mon, "predicted device state: %" PRIu64 " kbytes\n",
+                       pred->device_state >> 10);
+        monitor_printf(mon, "predicted downtime: %" PRIu64 " ms\n",
+                       pred->downtime);
+        if (pred->converging) {
+            monitor_printf(mon, "predicted switchover: in %" PRIu64
+                           " iterations, %" PRIu64 " ms\n",
+                           pred->iterations, pred->time_to_switchover);
+        } else {
+            monitor_printf(mon, "predicted switchover: not converging\n");
+        }
+        if (pred->has_cpu_throttle) {
+            monitor_printf(mon, "predicted cpu throttle: %" PRId64 "\n",
+                           pred->cpu_throttle);
+        }
+    }
+
     if (info->has_dirty_limit_throttle_time_per_round) {
         monitor_printf(mon, "dirty-limit throttle time: %" PRIu64 " us\n",
                        info->dirty_limit_throttle_time_per_round);
@@ -639,6 +663,10 @@ void hmp_migrate_set_parameter(Monitor *mon, const QDict *qdict)
         p->has_multifd_zstd_level = true;
         visit_type_uint8(v, param, &p->multifd_zstd_level, &err);
         break;
+    case MIGRATION_PARAMETER_MULTIFD_LZ4_LEVEL:
+        p->has_multifd_lz4_level = true;
+        visit_type_uint8(v, param, &p->multifd_lz4_level, &err);
+        break;
     case MIGRATION_PARAMETER_ZERO_PAGE_DETECTION:
         p->has_zero_page_detection = true;
         visit_type_ZeroPageDetection(v, param, &p->zero_page_detection, &err);
@@ -65,6 +65,7 @@
 #include "yank_functions.h"
 #include "sysemu/qtest.h"
 #include "options.h"
+#include "switchover.h"
 #include "sysemu/dirtylimit.h"
 #include "qemu/sockets.h"
 #include "sysemu/kvm.h"
@@ -231,6 +232,7 @@ void migration_object_init(void)
     qemu_sem_init(&current_incoming->postcopy_qemufile_dst_done, 0);
 
     qemu_mutex_init(&current_incoming->page_request_mutex);
+    qemu_mutex_init(&current_incoming->load_buffer_mutex);
     qemu_cond_init(&current_incoming->page_request_cond);
     current_incoming->page_requested = g_tree_new(page_request_addr_cmp);
 
@@ -1201,6 +1203,13 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
     }
 }
 
+static void populate_switchover_info(MigrationInfo *info)
+{
+    if (migrate_predictive_switchover()) {
+        info->switchover_prediction = switchover_get_prediction();
+    }
+}
+
 static void populate_disk_info(MigrationInfo *info)
 {
     if (blk_mig_active()) {
@@ -1253,6 +1262,7 @@ static void fill_source_migration_info(MigrationInfo *info)
         /* TODO add some postcopy stats */
         populate_time_info(info, s);
         populate_ram_info(info, s);
+        populate_switchover_info(info);
         populate_disk_info(info);
         migration_populate_vfio_info(info);
         break;
@@ -1685,6 +1695,7 @@ int migrate_init(MigrationState *s, Error **errp)
      */
     memset(&mig_stats, 0, sizeof(mig_stats));
     migration_reset_vfio_bytes_transferred();
+    switchover_reset();
 
     return 0;
 }
@@ -3149,6 +3160,11 @@ static void migration_update_counters(MigrationState *s,
     time_spent = current_time - s->iteration_start_time;
     bandwidth = (double)transferred / time_spent;
 
+    if (migrate_predictive_switchover()) {
+        /* Do not let a short burst or stall of the link move the threshold */
+        bandwidth = switchover_update_bandwidth(bandwidth);
+    }
+
     if (switchover_bw) {
         /*
          * If the user specified a switchover bandwidth, let's trust the
@@ -3180,6 +3196,10 @@ static void migration_update_counters(MigrationState *s,
             stat64_get(&mig_stats.dirty_bytes_last_sync) / expected_bw_per_ms;
     }
 
+    if (migrate_predictive_switchover()) {
+        switchover_predict(expected_bw_per_ms);
+    }
+
     migration_rate_reset();
 
     update_iteration_initial_status(s);
@@ -3232,6 +3252,10 @@ static MigIterateState migration_iteration_run(MigrationState *s)
         trace_migrate_pending_exact(pending_size, must_precopy, can_postcopy);
     }
 
+    if (migrate_predictive_switchover()) {
+        switchover_update_pending(pending_size);
+    }
+
     if ((!pending_size || pending_size < s->threshold_size) && can_switchover) {
         trace_migration_thread_low_pending(pending_size);
         migration_completion(s);
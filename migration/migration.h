@@ -212,6 +212,8 @@ struct MigrationIncomingState {
      * contains valid information.
      */
     QemuMutex page_request_mutex;
+    /* Protects the device state buffers received through multifd */
+    QemuMutex load_buffer_mutex;
     /*
      * If postcopy preempt is enabled, there is a chance that the main
      * thread finished loading its data before the preempt channel has
@@ -449,6 +451,13 @@ struct MigrationState {
      * (which is in 4M chunk).
      */
     uint8_t clear_bitmap_shift;
+    /*
+     * Whether the multifd channels find the dirty pages themselves in
+     * ranges of the dirty bitmap claimed by the migration thread, when
+     * nothing else needs to look at each page on the migration thread.
+     * Default value is true.  (since 9.1)
+     */
+    bool multifd_parallel_scan;
 
     /*
      * This save hostname when out-going migration starts
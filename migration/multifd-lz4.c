@@ -0,0 +1,323 @@
+/*
+ * Multifd lz4 compression implementation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <lz4.h>
+#include <lz4hc.h>
+#include "qemu/rcu.h"
+#include "exec/ramblock.h"
+#include "exec/target_page.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "trace.h"
+#include "options.h"
+#include "multifd.h"
+
+/* lz4 looks back at most 64KiB, so that is all the dictionary we keep. */
+#define LZ4_DICT_SIZE (64 * 1024)
+
+struct lz4_data {
+    /* stream for compression, depending on the level */
+    LZ4_stream_t *stream;
+    LZ4_streamHC_t *stream_hc;
+    /*
+     * The dictionary followed by the uncompressed pages of one packet.
+     * Both sides keep the last LZ4_DICT_SIZE bytes of the data sent on
+     * the channel, so each packet is compressed with a warm dictionary.
+     */
+    uint8_t *buf;
+    uint32_t dict_len;
+    /* size of the pages after the dictionary, yet to be merged into it */
+    uint32_t pending_len;
+    /* compressed buffer */
+    uint8_t *zbuff;
+    uint32_t zbuff_len;
+};
+
+/* Multifd lz4 compression */
+
+/**
+ * lz4_dict_update: make the pending pages part of the dictionary
+ *
+ * Keep the last LZ4_DICT_SIZE bytes of the dictionary and pending pages
+ * at the start of the buffer.  This must be done in the same way on both
+ * sides.
+ *
+ * @z: the channel's lz4 state
+ */
+static void lz4_dict_update(struct lz4_data *z)
+{
+    uint32_t len = z->dict_len + z->pending_len;
+    uint32_t dict_len = MIN(len, LZ4_DICT_SIZE);
+
+    memmove(z->buf, z->buf + len - dict_len, dict_len);
+    z->dict_len = dict_len;
+    z->pending_len = 0;
+}
+
+static void lz4_data_free(struct lz4_data *z)
+{
+    LZ4_freeStream(z->stream);
+    LZ4_freeStreamHC(z->stream_hc);
+    g_free(z->buf);
+    g_free(z->zbuff);
+    g_free(z);
+}
+
+/**
+ * lz4_send_setup: setup send side
+ *
+ * Setup each channel with lz4 compression, or with lz4hc if the
+ * compression level is not zero.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_send_setup(MultiFDSendParams *p, Error **errp)
+{
+    struct lz4_data *z = g_new0(struct lz4_data, 1);
+    int level = migrate_multifd_lz4_level();
+
+    if (level) {
+        z->stream_hc = LZ4_createStreamHC();
+        if (z->stream_hc) {
+            LZ4_setCompressionLevel(z->stream_hc, level);
+        }
+    } else {
+        z->stream = LZ4_createStream();
+    }
+    if (!z->stream && !z->stream_hc) {
+        lz4_data_free(z);
+        error_setg(errp, "multifd %u: lz4 createStream failed", p->id);
+        return -1;
+    }
+
+    z->buf = g_try_malloc(LZ4_DICT_SIZE + MULTIFD_PACKET_SIZE);
+    /* Anything that does not compress below the raw size is sent raw */
+    z->zbuff_len = MULTIFD_PACKET_SIZE;
+    z->zbuff = g_try_malloc(z->zbuff_len);
+    if (!z->buf || !z->zbuff) {
+        lz4_data_free(z);
+        error_setg(errp, "multifd %u: out of memory for zbuff", p->id);
+        return -1;
+    }
+    p->compress_data = z;
+    return 0;
+}
+
+/**
+ * lz4_send_cleanup: cleanup send side
+ *
+ * Close the channel and return memory.
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static void lz4_send_cleanup(MultiFDSendParams *p, Error **errp)
+{
+    lz4_data_free(p->compress_data);
+    p->compress_data = NULL;
+}
+
+/**
+ * lz4_send_prepare: prepare date to be able to send
+ *
+ * Create a compressed buffer with all the pages that we are going to
+ * send, or send a copy of the pages if they do not compress.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_send_prepare(MultiFDSendParams *p, Error **errp)
+{
+    MultiFDPages_t *pages = p->pages;
+    struct lz4_data *z = p->compress_data;
+    uint8_t *src;
+    uint32_t in_size;
+    int out_size;
+    uint32_t i;
+
+    if (!multifd_send_prepare_common(p)) {
+        goto out;
+    }
+
+    /* The previous packet has been sent, its pages can be moved. */
+    lz4_dict_update(z);
+
+    /*
+     * Since the VM might be running, the pages may be changing
+     * concurrently.  Both the dictionary and the raw fallback need
+     * exactly what was compressed, so work on a copy.
+     */
+    src = z->buf + z->dict_len;
+    in_size = pages->normal_num * p->page_size;
+    for (i = 0; i < pages->normal_num; i++) {
+        memcpy(src + i * p->page_size,
+               p->pages->block->host + pages->offset[i], p->page_size);
+    }
+    z->pending_len = in_size;
+
+    if (z->stream_hc) {
+        LZ4_loadDictHC(z->stream_hc, (const char *)z->buf, z->dict_len);
+        out_size = LZ4_compress_HC_continue(z->stream_hc, (const char *)src,
+                                            (char *)z->zbuff, in_size,
+                                            in_size - 1);
+    } else {
+        LZ4_loadDict(z->stream, (const char *)z->buf, z->dict_len);
+        out_size = LZ4_compress_fast_continue(z->stream, (const char *)src,
+                                              (char *)z->zbuff, in_size,
+                                              in_size - 1, 1);
+    }
+
+    if (out_size > 0) {
+        p->iov[p->iovs_num].iov_base = z->zbuff;
+        p->iov[p->iovs_num].iov_len = out_size;
+    } else {
+        /* Incompressible, a packet of the raw size means raw pages */
+        p->iov[p->iovs_num].iov_base = src;
+        p->iov[p->iovs_num].iov_len = in_size;
+    }
+    p->next_packet_size = p->iov[p->iovs_num].iov_len;
+    p->iovs_num++;
+
+out:
+    p->flags |= MULTIFD_FLAG_LZ4;
+    multifd_send_fill_packet(p);
+    return 0;
+}
+
+/**
+ * lz4_recv_setup: setup receive side
+ *
+ * Create the buffers for the dictionary and the compressed data.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_recv_setup(MultiFDRecvParams *p, Error **errp)
+{
+    struct lz4_data *z = g_new0(struct lz4_data, 1);
+
+    z->buf = g_try_malloc(LZ4_DICT_SIZE + MULTIFD_PACKET_SIZE);
+    z->zbuff_len = MULTIFD_PACKET_SIZE;
+    z->zbuff = g_try_malloc(z->zbuff_len);
+    if (!z->buf || !z->zbuff) {
+        lz4_data_free(z);
+        error_setg(errp, "multifd %u: out of memory for zbuff", p->id);
+        return -1;
+    }
+    p->compress_data = z;
+    return 0;
+}
+
+/**
+ * lz4_recv_cleanup: cleanup receive side
+ *
+ * Return memory.
+ *
+ * @p: Params for the channel that we are using
+ */
+static void lz4_recv_cleanup(MultiFDRecvParams *p)
+{
+    lz4_data_free(p->compress_data);
+    p->compress_data = NULL;
+}
+
+/**
+ * lz4_recv: read the data from the channel into actual pages
+ *
+ * Read the compressed buffer, and uncompress it into the actual
+ * pages.
+ *
+ * Returns 0 for success or -1 for error
+ *
+ * @p: Params for the channel that we are using
+ * @errp: pointer to an error
+ */
+static int lz4_recv(MultiFDRecvParams *p, Error **errp)
+{
+    uint32_t in_size = p->next_packet_size;
+    uint32_t expected_size = p->normal_num * p->page_size;
+    uint32_t flags = p->flags & MULTIFD_FLAG_COMPRESSION_MASK;
+    struct lz4_data *z = p->compress_data;
+    uint8_t *dst = z->buf + z->dict_len;
+    int ret;
+    int i;
+
+    if (flags != MULTIFD_FLAG_LZ4) {
+        error_setg(errp, "multifd %u: flags received %x flags expected %x",
+                   p->id, flags, MULTIFD_FLAG_LZ4);
+        return -1;
+    }
+
+    multifd_recv_zero_page_process(p);
+
+    if (!p->normal_num) {
+        assert(in_size == 0);
+        return 0;
+    }
+
+    if (in_size > expected_size) {
+        error_setg(errp, "multifd %u: packet size received %u size expected %u",
+                   p->id, in_size, expected_size);
+        return -1;
+    }
+
+    if (in_size == expected_size) {
+        ret = qio_channel_read_all(p->c, (void *)dst, in_size, errp);
+        if (ret != 0) {
+            return ret;
+        }
+    } else {
+        ret = qio_channel_read_all(p->c, (void *)z->zbuff, in_size, errp);
+        if (ret != 0) {
+            return ret;
+        }
+        ret = LZ4_decompress_safe_usingDict((const char *)z->zbuff,
+                                            (char *)dst, in_size,
+                                            expected_size,
+                                            (const char *)z->buf,
+                                            z->dict_len);
+        if (ret != expected_size) {
+            error_setg(errp, "multifd %u: lz4 decompress returned %d "
+                       "size expected %u", p->id, ret, expected_size);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < p->normal_num; i++) {
+        ramblock_recv_bitmap_set_offset(p->block, p->normal[i]);
+        memcpy(p->host + p->normal[i], dst + i * p->page_size,
+               p->page_size);
+    }
+
+    z->pending_len = expected_size;
+    lz4_dict_update(z);
+    return 0;
+}
+
+static MultiFDMethods multifd_lz4_ops = {
+    .send_setup = lz4_send_setup,
+    .send_cleanup = lz4_send_cleanup,
+    .send_prepare = lz4_send_prepare,
+    .recv_setup = lz4_recv_setup,
+    .recv_cleanup = lz4_recv_cleanup,
+    .recv = lz4_recv
+};
+
+static void multifd_lz4_register(void)
+{
+    multifd_register_ops(MULTIFD_COMPRESSION_LZ4, &multifd_lz4_ops);
+}
+
+migration_init(multifd_lz4_register);
@@ -28,6 +28,8 @@
 #include "multifd.h"
 #include "threadinfo.h"
 #include "options.h"
+#include "savevm.h"
+#include "migration/misc.h"
 #include "qemu/yank.h"
 #include "io/channel-file.h"
 #include "io/channel-socket.h"
@@ -77,6 +79,8 @@ struct {
      * We will use atomic operations.  Only valid values are 0 and 1.
      */
     int exiting;
+    /* serializes the device state threads queueing buffers */
+    QemuMutex device_state_mutex;
     /* multifd ops */
     MultiFDMethods *ops;
 } *multifd_send_state;
@@ -255,6 +259,7 @@ static void nocomp_recv_cleanup(MultiFDRecvParams *p)
 static int nocomp_recv(MultiFDRecvParams *p, Error **errp)
 {
     uint32_t flags;
+    uint32_t niov = 0;
 
     if (!multifd_use_packets()) {
         return multifd_file_recv_data(p, errp);
@@ -274,12 +279,29 @@ static int nocomp_recv(MultiFDRecvParams *p, Error **errp)
         return 0;
     }
 
+    /*
+     * Read straight into guest memory, merging contiguous pages so that
+     * both the socket read and the receive bitmap update work on runs
+     * of pages rather than on each page.
+     */
     for (int i = 0; i < p->normal_num; i++) {
-        p->iov[i].iov_base = p->host + p->normal[i];
-        p->iov[i].iov_len = p->page_size;
-        ramblock_recv_bitmap_set_offset(p->block, p->normal[i]);
+        void *host = p->host + p->normal[i];
+
+        if (niov && p->iov[niov - 1].iov_base +
+            p->iov[niov - 1].iov_len == host) {
+            p->iov[niov - 1].iov_len += p->page_size;
+        } else {
+            p->iov[niov].iov_base = host;
+            p->iov[niov].iov_len = p->page_size;
+            niov++;
+        }
+    }
+    for (int i = 0; i < niov; i++) {
+        ramblock_recv_bitmap_set_range(p->block, p->iov[i].iov_base,
+                                       p->iov[i].iov_len / p->page_size);
     }
-    return qio_channel_readv_all(p->c, p->iov, p->normal_num, errp);
+    return qio_channel_readv_full_all(p->c, p->iov, niov, NULL, NULL,
+                                      QIO_CHANNEL_READ_FLAG_WAITALL, errp);
 }
 
 static MultiFDMethods multifd_nocomp_ops = {
@@ -556,33 +578,18 @@ static void multifd_send_kick_main(MultiFDSendParams *p)
 }
 
 /*
- * How we use multifd_send_state->pages and channel->pages?
- *
- * We create a pages for each channel, and a main one.  Each time that
- * we need to send a batch of pages we interchange the ones between
- * multifd_send_state and the channel that is sending it.  There are
- * two reasons for that:
- *    - to not have to do so many mallocs during migration
- *    - to make easier to know what to free at the end of migration
- *
- * This way we always know who is the owner of each "pages" struct,
- * and we don't need any locking.  It belongs to the migration thread
- * or to the channel thread.  Switching is safe because the migration
- * thread is using the channel mutex when changing it, and the channel
- * have to had finish with its own, otherwise pending_job can't be
- * false.
- *
- * Returns true if succeed, false otherwise.
+ * Wait for a channel without a pending job and return it, or NULL if
+ * the multifd threads are quitting.  The caller owns the channel's
+ * 'pages' and 'scan' until it sets pending_job again.
  */
-static bool multifd_send_pages(void)
+static MultiFDSendParams *multifd_send_pick_channel(void)
 {
     int i;
     static int next_channel;
     MultiFDSendParams *p = NULL; /* make happy gcc */
-    MultiFDPages_t *pages = multifd_send_state->pages;
 
     if (multifd_send_should_exit()) {
-        return false;
+        return NULL;
     }
 
     /* We wait here, until at least one channel is ready */
@@ -596,7 +603,7 @@ static bool multifd_send_pages(void)
     next_channel %= migrate_multifd_channels();
     for (i = next_channel;; i = (i + 1) % migrate_multifd_channels()) {
         if (multifd_send_should_exit()) {
-            return false;
+            return NULL;
         }
         p = &multifd_send_state->params[i];
         /*
@@ -614,6 +621,38 @@ static bool multifd_send_pages(void)
      * qatomic_store_release() in multifd_send_thread().
      */
     smp_mb_acquire();
+    return p;
+}
+
+/*
+ * How we use multifd_send_state->pages and channel->pages?
+ *
+ * We create a pages for each channel, and a main one.  Each time that
+ * we need to send a batch of pages we interchange the ones between
+ * multifd_send_state and the channel that is sending it.  There are
+ * two reasons for that:
+ *    - to not have to do so many mallocs during migration
+ *    - to make easier to know what to free at the end of migration
+ *
+ * This way we always know who is the owner of each "pages" struct,
+ * and we don't need any locking.  It belongs to the migration thread
+ * or to the channel thread.  Switching is safe because the migration
+ * thread is using the channel mutex when changing it, and the channel
+ * have to had finish with its own, otherwise pending_job can't be
+ * false.
+ *
+ * Returns true if succeed, false otherwise.
+ */
+static bool multifd_send_pages(void)
+{
+    MultiFDSendParams *p;
+    MultiFDPages_t *pages = multifd_send_state->pages;
+
+    p = multifd_send_pick_channel();
+    if (!p) {
+        return false;
+    }
+
     assert(!p->pages->num);
     multifd_send_state->pages = p->pages;
     p->pages = pages;
@@ -627,6 +666,86 @@ static bool multifd_send_pages(void)
     return true;
 }
 
+/*
+ * Hand a range of the dirty bitmap to a channel, which will find and
+ * send the dirty pages itself.  The dirty bits must already have been
+ * claimed by the caller, so the channel never touches the RAMBlock
+ * bitmaps and can run concurrently with a bitmap sync.
+ *
+ * Returns true if succeed, false otherwise.
+ */
+bool multifd_queue_scan(RAMBlock *block, unsigned long start,
+                        unsigned long npages, const unsigned long *bmap)
+{
+    MultiFDSendParams *p;
+
+    assert(npages && npages <= MULTIFD_SCAN_PAGES);
+    assert(!(start % BITS_PER_LONG));
+
+    p = multifd_send_pick_channel();
+    if (!p) {
+        return false;
+    }
+
+    assert(!p->pages->num && !p->scan.npages);
+    p->scan.block = block;
+    p->scan.start = start;
+    p->scan.npages = npages;
+    bitmap_copy(p->scan.bmap, bmap, npages);
+    /* Pairs with the qatomic_load_acquire() in multifd_send_thread(). */
+    qatomic_store_release(&p->pending_job, true);
+    qemu_sem_post(&p->sem);
+
+    return true;
+}
+
+bool multifd_device_state_supported(void)
+{
+    /*
+     * The capability alone is not enough: savevm saves to a single
+     * stream and never sets up the multifd channels.
+     */
+    return migrate_multifd() && !migrate_mapped_ram() && multifd_send_state;
+}
+
+/*
+ * Queue a device state buffer on a channel.  This is called by the
+ * device state threads, so unlike the RAM queueing functions it can
+ * race with itself, but never with the migration thread.
+ *
+ * Returns true if succeed, false otherwise.
+ */
+bool multifd_queue_device_state(SaveLiveCompletePrecopyThreadData *d,
+                                const void *data, size_t len)
+{
+    MultiFDSendParams *p;
+
+    if (!len || len > MULTIFD_DEVICE_STATE_MAX) {
+        error_report("%s: device %s buffer of %zu bytes, maximum is %d",
+                     __func__, d->idstr, len, MULTIFD_DEVICE_STATE_MAX);
+        return false;
+    }
+
+    QEMU_LOCK_GUARD(&multifd_send_state->device_state_mutex);
+
+    p = multifd_send_pick_channel();
+    if (!p) {
+        return false;
+    }
+
+    assert(!p->pages->num && !p->scan.npages && !p->device_state.data);
+    pstrcpy(p->device_state.idstr, sizeof(p->device_state.idstr), d->idstr);
+    p->device_state.instance_id = d->instance_id;
+    p->device_state.idx = d->idx++;
+    p->device_state.data = g_memdup2(data, len);
+    p->device_state.len = len;
+    /* Pairs with the qatomic_load_acquire() in multifd_send_thread(). */
+    qatomic_store_release(&p->pending_job, true);
+    qemu_sem_post(&p->sem);
+
+    return true;
+}
+
 static inline bool multifd_queue_empty(MultiFDPages_t *pages)
 {
     return pages->num == 0;
@@ -785,6 +904,8 @@ static bool multifd_send_cleanup_channel(MultiFDSendParams *p, Error **errp)
     p->packet = NULL;
     g_free(p->iov);
     p->iov = NULL;
+    g_free(p->device_state.data);
+    p->device_state.data = NULL;
     multifd_send_state->ops->send_cleanup(p, errp);
 
     return *errp == NULL;
@@ -796,6 +917,7 @@ static void multifd_send_cleanup_state(void)
     socket_cleanup_outgoing_migration();
     qemu_sem_destroy(&multifd_send_state->channels_created);
     qemu_sem_destroy(&multifd_send_state->channels_ready);
+    qemu_mutex_destroy(&multifd_send_state->device_state_mutex);
     g_free(multifd_send_state->params);
     multifd_send_state->params = NULL;
     multifd_pages_clear(multifd_send_state->pages);
@@ -898,6 +1020,120 @@ int multifd_send_sync_main(void)
     return 0;
 }
 
+/* Send the pages queued in p->pages; returns 0 for success, -1 for error */
+static int multifd_send_batch(MultiFDSendParams *p, Error **errp)
+{
+    MultiFDPages_t *pages = p->pages;
+    int ret;
+
+    p->iovs_num = 0;
+    assert(pages->num);
+
+    ret = multifd_send_state->ops->send_prepare(p, errp);
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (migrate_mapped_ram()) {
+        ret = file_write_ramblock_iov(p->c, p->iov, p->iovs_num,
+                                      p->pages->block, errp);
+    } else {
+        ret = qio_channel_writev_full_all(p->c, p->iov, p->iovs_num,
+                                          NULL, 0, p->write_flags, errp);
+    }
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    stat64_add(&mig_stats.multifd_bytes,
+               p->next_packet_size + p->packet_len);
+    stat64_add(&mig_stats.normal_pages, pages->normal_num);
+    stat64_add(&mig_stats.zero_pages, pages->num - pages->normal_num);
+
+    multifd_pages_reset(p->pages);
+    p->next_packet_size = 0;
+    return 0;
+}
+
+/*
+ * Send the buffer in p->device_state, in a packet of its own that is
+ * not seen by the compression methods.
+ *
+ * Returns 0 for success, -1 for error
+ */
+static int multifd_send_device_state(MultiFDSendParams *p, Error **errp)
+{
+    MultiFDDeviceState_t *ds = &p->device_state;
+    MultiFDPacket_t *packet = p->packet;
+    uint64_t packet_num = qatomic_fetch_inc(&multifd_send_state->packet_num);
+    struct iovec iov[2] = {
+        { .iov_base = packet, .iov_len = p->packet_len },
+        { .iov_base = ds->data, .iov_len = ds->len },
+    };
+    int ret;
+
+    packet->flags = cpu_to_be32(MULTIFD_FLAG_DEVICE_STATE);
+    packet->pages_alloc = 0;
+    packet->normal_pages = 0;
+    packet->zero_pages = 0;
+    packet->next_packet_size = cpu_to_be32(ds->len);
+    packet->packet_num = cpu_to_be64(packet_num);
+    packet->instance_id = cpu_to_be32(ds->instance_id);
+    packet->buffer_idx = cpu_to_be64(ds->idx);
+    strncpy(packet->ramblock, ds->idstr, 256);
+    p->packets_sent++;
+
+    trace_multifd_send_device_state(p->id, packet_num, ds->idstr,
+                                    ds->instance_id, ds->idx, ds->len);
+
+    ret = qio_channel_writev_all(p->c, iov, ARRAY_SIZE(iov), errp);
+
+    /* The packet is reused for pages, which leave these fields alone */
+    packet->instance_id = 0;
+    packet->buffer_idx = 0;
+
+    if (ret == 0) {
+        stat64_add(&mig_stats.multifd_bytes, p->packet_len + ds->len);
+    }
+    g_free(ds->data);
+    ds->data = NULL;
+    ds->len = 0;
+    return ret;
+}
+
+/*
+ * Send the dirty pages of the range in p->scan, one batch at a time.
+ *
+ * Returns 0 for success, -1 for error
+ */
+static int multifd_send_scan(MultiFDSendParams *p, Error **errp)
+{
+    MultiFDScan_t *scan = &p->scan;
+    MultiFDPages_t *pages = p->pages;
+    int page_bits = qemu_target_page_bits();
+    unsigned long i;
+    int ret;
+
+    for (i = find_first_bit(scan->bmap, scan->npages); i < scan->npages;
+         i = find_next_bit(scan->bmap, scan->npages, i + 1)) {
+        if (multifd_queue_full(pages)) {
+            if (multifd_send_should_exit()) {
+                multifd_pages_reset(pages);
+                return 0;
+            }
+            ret = multifd_send_batch(p, errp);
+            if (ret != 0) {
+                return ret;
+            }
+        }
+        pages->block = scan->block;
+        multifd_enqueue(pages, (ram_addr_t)(scan->start + i) << page_bits);
+    }
+
+    return multifd_queue_empty(pages) ? 0 : multifd_send_batch(p, errp);
+}
+
 static void *multifd_send_thread(void *opaque)
 {
     MultiFDSendParams *p = opaque;
@@ -931,41 +1167,22 @@ static void *multifd_send_thread(void *opaque)
          * qatomic_store_release() in multifd_send_pages().
          */
         if (qatomic_load_acquire(&p->pending_job)) {
-            MultiFDPages_t *pages = p->pages;
-
-            p->iovs_num = 0;
-            assert(pages->num);
-
-            ret = multifd_send_state->ops->send_prepare(p, &local_err);
-            if (ret != 0) {
-                break;
-            }
-
-            if (migrate_mapped_ram()) {
-                ret = file_write_ramblock_iov(p->c, p->iov, p->iovs_num,
-                                              p->pages->block, &local_err);
+            if (p->device_state.data) {
+                ret = multifd_send_device_state(p, &local_err);
+            } else if (p->scan.npages) {
+                ret = multifd_send_scan(p, &local_err);
+                p->scan.npages = 0;
             } else {
-                ret = qio_channel_writev_full_all(p->c, p->iov, p->iovs_num,
-                                                  NULL, 0, p->write_flags,
-                                                  &local_err);
+                ret = multifd_send_batch(p, &local_err);
             }
-
             if (ret != 0) {
                 break;
             }
 
-            stat64_add(&mig_stats.multifd_bytes,
-                       p->next_packet_size + p->packet_len);
-            stat64_add(&mig_stats.normal_pages, pages->normal_num);
-            stat64_add(&mig_stats.zero_pages, pages->num - pages->normal_num);
-
-            multifd_pages_reset(p->pages);
-            p->next_packet_size = 0;
-
             /*
              * Making sure p->pages is published before saying "we're
              * free".  Pairs with the smp_mb_acquire() in
-             * multifd_send_pages().
+             * multifd_send_pick_channel().
              */
             qatomic_store_release(&p->pending_job, false);
         } else {
@@ -1162,6 +1379,7 @@ bool multifd_send_setup(void)
     multifd_send_state->pages = multifd_pages_init(page_count);
     qemu_sem_init(&multifd_send_state->channels_created, 0);
     qemu_sem_init(&multifd_send_state->channels_ready, 0);
+    qemu_mutex_init(&multifd_send_state->device_state_mutex);
     qatomic_set(&multifd_send_state->exiting, 0);
     multifd_send_state->ops = multifd_ops[migrate_multifd_compression()];
 
@@ -1456,6 +1674,38 @@ void multifd_recv_sync_main(void)
     trace_multifd_recv_sync_main(multifd_recv_state->packet_num);
 }
 
+/*
+ * Read the buffer of a device state packet and hand it to the device.
+ *
+ * Returns 0 for success, -1 for error
+ */
+static int multifd_recv_device_state(MultiFDRecvParams *p, Error **errp)
+{
+    MultiFDPacket_t *packet = p->packet;
+    uint32_t instance_id = be32_to_cpu(packet->instance_id);
+    uint64_t idx = be64_to_cpu(packet->buffer_idx);
+    size_t len = p->next_packet_size;
+    g_autofree char *buf = NULL;
+
+    if (!len || len > MULTIFD_DEVICE_STATE_MAX) {
+        error_setg(errp, "multifd %u: device state buffer of %zu bytes, "
+                   "maximum is %d", p->id, len, MULTIFD_DEVICE_STATE_MAX);
+        return -1;
+    }
+
+    buf = g_malloc(len);
+    if (qio_channel_read_all(p->c, buf, len, errp)) {
+        return -1;
+    }
+
+    /* make sure that idstr is 0 terminated */
+    packet->ramblock[255] = 0;
+    trace_multifd_recv_device_state(p->id, packet->ramblock, instance_id,
+                                    idx, len);
+    return qemu_loadvm_load_state_buffer(packet->ramblock, instance_id, idx,
+                                         g_steal_pointer(&buf), len, errp);
+}
+
 static void *multifd_recv_thread(void *opaque)
 {
     MultiFDRecvParams *p = opaque;
@@ -1494,6 +1744,13 @@ static void *multifd_recv_thread(void *opaque)
             p->flags &= ~MULTIFD_FLAG_SYNC;
             has_data = p->normal_num || p->zero_num;
             qemu_mutex_unlock(&p->mutex);
+
+            if (flags & MULTIFD_FLAG_DEVICE_STATE) {
+                ret = multifd_recv_device_state(p, &local_err);
+                if (ret != 0) {
+                    break;
+                }
+            }
         } else {
             /*
              * No packets, so we need to wait for the vmstate code to
@@ -28,6 +28,8 @@ void multifd_recv_new_channel(QIOChannel *ioc, Error **errp);
 void multifd_recv_sync_main(void);
 int multifd_send_sync_main(void);
 bool multifd_queue_page(RAMBlock *block, ram_addr_t offset);
+bool multifd_queue_scan(RAMBlock *block, unsigned long start,
+                        unsigned long npages, const unsigned long *bmap);
 bool multifd_recv(void);
 MultiFDRecvData *multifd_get_recv_data(void);
 
@@ -40,10 +42,20 @@ MultiFDRecvData *multifd_get_recv_data(void);
 #define MULTIFD_FLAG_NOCOMP (0 << 1)
 #define MULTIFD_FLAG_ZLIB (1 << 1)
 #define MULTIFD_FLAG_ZSTD (2 << 1)
+#define MULTIFD_FLAG_LZ4 (3 << 1)
+
+/* The packet carries a device state buffer instead of pages */
+#define MULTIFD_FLAG_DEVICE_STATE (1 << 4)
 
 /* This value needs to be a multiple of qemu_target_page_size() */
 #define MULTIFD_PACKET_SIZE (512 * 1024)
 
+/* Maximum size of a device state buffer */
+#define MULTIFD_DEVICE_STATE_MAX (16 * 1024 * 1024)
+
+/* Maximum number of target pages in one range of the dirty bitmap */
+#define MULTIFD_SCAN_PAGES 4096
+
 typedef struct {
     uint32_t magic;
     uint32_t version;
@@ -57,8 +69,12 @@ typedef struct {
     uint64_t packet_num;
     /* zero pages */
     uint32_t zero_pages;
-    uint32_t unused32[1];    /* Reserved for future use */
-    uint64_t unused64[3];    /* Reserved for future use */
+    /* device state packets: instance id of the device */
+    uint32_t instance_id;
+    /* device state packets: index of the buffer for the device */
+    uint64_t buffer_idx;
+    uint64_t unused64[2];    /* Reserved for future use */
+    /* RAMBlock, or device idstr for device state packets */
     char ramblock[256];
     /*
      * This array contains the pointers to:
@@ -80,6 +96,25 @@ typedef struct {
     RAMBlock *block;
 } MultiFDPages_t;
 
+typedef struct {
+    RAMBlock *block;
+    /* first page of the range, a multiple of BITS_PER_LONG */
+    unsigned long start;
+    /* number of pages in the range, zero if there is none */
+    unsigned long npages;
+    /* dirty pages of the range, already cleared in the RAMBlock bitmap */
+    unsigned long bmap[BITS_TO_LONGS(MULTIFD_SCAN_PAGES)];
+} MultiFDScan_t;
+
+typedef struct {
+    char idstr[256];
+    uint32_t instance_id;
+    uint64_t idx;
+    /* buffer to send, NULL if there is none */
+    void *data;
+    size_t len;
+} MultiFDDeviceState_t;
+
 struct MultiFDRecvData {
     void *opaque;
     size_t size;
@@ -135,6 +170,13 @@ typedef struct {
      * pending_job != 0 -> multifd_channel can use it.
      */
     MultiFDPages_t *pages;
+    /*
+     * Range of the dirty bitmap to send, with the same ownership rules
+     * as 'pages'.  When it is set, 'pages' is filled by the channel.
+     */
+    MultiFDScan_t scan;
+    /* Device state buffer to send, with the same ownership rules */
+    MultiFDDeviceState_t device_state;
 
     /* thread local variables. No locking required */
 
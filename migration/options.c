@@ -64,6 +64,8 @@
 #define DEFAULT_MIGRATE_MULTIFD_ZLIB_LEVEL 1
 /* 0: means nocompress, 1: best speed, ... 20: best compress ratio */
 #define DEFAULT_MIGRATE_MULTIFD_ZSTD_LEVEL 1
+/* 0: means the fast lz4 compressor, 1-12 select lz4hc */
+#define DEFAULT_MIGRATE_MULTIFD_LZ4_LEVEL 0
 
 /* Background transfer rate for postcopy, 0 means unlimited, note
  * that page requests can still exceed this limit.
@@ -100,6 +102,8 @@ Property migration_properties[] = {
                       clear_bitmap_shift, CLEAR_BITMAP_SHIFT_DEFAULT),
     DEFINE_PROP_BOOL("x-preempt-pre-7-2", MigrationState,
                      preempt_pre_7_2, false),
+    DEFINE_PROP_BOOL("x-multifd-parallel-scan", MigrationState,
+                     multifd_parallel_scan, true),
 
     /* Migration parameters */
     DEFINE_PROP_UINT8("x-compress-level", MigrationState,
@@ -146,6 +150,9 @@ Property migration_properties[] = {
     DEFINE_PROP_UINT8("multifd-zstd-level", MigrationState,
                       parameters.multifd_zstd_level,
                       DEFAULT_MIGRATE_MULTIFD_ZSTD_LEVEL),
+    DEFINE_PROP_UINT8("multifd-lz4-level", MigrationState,
+                      parameters.multifd_lz4_level,
+                      DEFAULT_MIGRATE_MULTIFD_LZ4_LEVEL),
     DEFINE_PROP_SIZE("xbzrle-cache-size", MigrationState,
                       parameters.xbzrle_cache_size,
                       DEFAULT_MIGRATE_XBZRLE_CACHE_SIZE),
@@ -208,6 +215,8 @@ Property migration_properties[] = {
                         MIGRATION_CAPABILITY_SWITCHOVER_ACK),
     DEFINE_PROP_MIG_CAP("x-dirty-limit", MIGRATION_CAPABILITY_DIRTY_LIMIT),
     DEFINE_PROP_MIG_CAP("mapped-ram", MIGRATION_CAPABILITY_MAPPED_RAM),
+    DEFINE_PROP_MIG_CAP("x-predictive-switchover",
+                        MIGRATION_CAPABILITY_PREDICTIVE_SWITCHOVER),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -323,6 +332,13 @@ bool migrate_postcopy_ram(void)
     return s->capabilities[MIGRATION_CAPABILITY_POSTCOPY_RAM];
 }
 
+bool migrate_predictive_switchover(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    return s->capabilities[MIGRATION_CAPABILITY_PREDICTIVE_SWITCHOVER];
+}
+
 bool migrate_rdma_pin_all(void)
 {
     MigrationState *s = migrate_get_current();
@@ -388,6 +404,13 @@ bool migrate_multifd_flush_after_each_section(void)
     return s->multifd_flush_after_each_section;
 }
 
+bool migrate_multifd_parallel_scan(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    return s->multifd_parallel_scan;
+}
+
 bool migrate_postcopy(void)
 {
     return migrate_postcopy_ram() || migrate_dirty_bitmaps();
@@ -899,6 +922,13 @@ int migrate_multifd_zstd_level(void)
     return s->parameters.multifd_zstd_level;
 }
 
+int migrate_multifd_lz4_level(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    return s->parameters.multifd_lz4_level;
+}
+
 uint8_t migrate_throttle_trigger_threshold(void)
 {
     MigrationState *s = migrate_get_current();
@@ -1030,6 +1060,8 @@ MigrationParameters *qmp_query_migrate_parameters(Error **errp)
     params->multifd_zlib_level = s->parameters.multifd_zlib_level;
     params->has_multifd_zstd_level = true;
     params->multifd_zstd_level = s->parameters.multifd_zstd_level;
+    params->has_multifd_lz4_level = true;
+    params->multifd_lz4_level = s->parameters.multifd_lz4_level;
     params->has_xbzrle_cache_size = true;
     params->xbzrle_cache_size = s->parameters.xbzrle_cache_size;
     params->has_max_postcopy_bandwidth = true;
@@ -1086,6 +1118,7 @@ void migrate_params_init(MigrationParameters *params)
     params->has_multifd_compression = true;
     params->has_multifd_zlib_level = true;
     params->has_multifd_zstd_level = true;
+    params->has_multifd_lz4_level = true;
     params->has_xbzrle_cache_size = true;
     params->has_max_postcopy_bandwidth = true;
     params->has_max_cpu_throttle = true;
@@ -1204,6 +1237,13 @@ bool migrate_params_check(MigrationParameters *params, Error **errp)
         return false;
     }
 
+    if (params->has_multifd_lz4_level &&
+        (params->multifd_lz4_level > 12)) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE, "multifd_lz4_level",
+                   "a value between 0 and 12");
+        return false;
+    }
+
     if (params->has_xbzrle_cache_size &&
         (params->xbzrle_cache_size < qemu_target_page_size() ||
          !is_power_of_2(params->xbzrle_cache_size))) {
@@ -1374,6 +1414,9 @@ static void migrate_params_test_apply(MigrateSetParameters *params,
     if (params->has_multifd_zstd_level) {
         dest->multifd_zstd_level = params->multifd_zstd_level;
     }
+    if (params->has_multifd_lz4_level) {
+        dest->multifd_lz4_level = params->multifd_lz4_level;
+    }
     if (params->has_xbzrle_cache_size) {
         dest->xbzrle_cache_size = params->xbzrle_cache_size;
     }
@@ -1519,6 +1562,9 @@ static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
     if (params->has_multifd_zstd_level) {
         s->parameters.multifd_zstd_level = params->multifd_zstd_level;
     }
+    if (params->has_multifd_lz4_level) {
+        s->parameters.multifd_lz4_level = params->multifd_lz4_level;
+    }
     if (params->has_xbzrle_cache_size) {
         s->parameters.xbzrle_cache_size = params->xbzrle_cache_size;
         xbzrle_cache_resize(params->xbzrle_cache_size, errp);
@@ -61,6 +61,7 @@
 #include "sysemu/runstate.h"
 #include "rdma.h"
 #include "options.h"
+#include "switchover.h"
 #include "sysemu/dirtylimit.h"
 #include "sysemu/kvm.h"
 
@@ -471,6 +472,8 @@ void ram_transferred_add(uint64_t bytes)
 
 struct MigrationOps {
     int (*ram_save_target_page)(RAMState *rs, PageSearchStatus *pss);
+    /* If set, used instead of ram_save_host_page() for dirty pages */
+    int (*ram_save_dirty_range)(RAMState *rs, PageSearchStatus *pss);
 };
 typedef struct MigrationOps MigrationOps;
 
@@ -569,6 +572,32 @@ static void mig_throttle_guest_down(uint64_t bytes_dirty_period,
     }
 }
 
+/**
+ * mig_throttle_guest_predict: throttle the guest as the model predicts
+ *
+ * Set the CPU throttle to the smallest value with which the switchover
+ * controller predicts that migration converges, which may also reduce
+ * or stop the throttling.
+ *
+ * Returns false if no throttle value can make migration converge.
+ */
+static bool mig_throttle_guest_predict(void)
+{
+    int pct = switchover_cpu_throttle();
+
+    if (pct < 0) {
+        return false;
+    }
+
+    trace_migration_throttle_predict(cpu_throttle_get_percentage(), pct);
+    if (pct) {
+        cpu_throttle_set(pct);
+    } else if (cpu_throttle_active()) {
+        cpu_throttle_stop();
+    }
+    return true;
+}
+
 void mig_throttle_counter_reset(void)
 {
     RAMState *rs = ram_state;
@@ -923,6 +952,7 @@ static void ramblock_sync_dirty_bitmap(RAMState *rs, RAMBlock *rb)
 
     rs->migration_dirty_pages += new_dirty_pages;
     rs->num_dirty_pages_period += new_dirty_pages;
+    rb->dirty_pages_period += new_dirty_pages;
 }
 
 /**
@@ -953,6 +983,58 @@ uint64_t ram_get_total_transferred_pages(void)
         compress_ram_pages() + xbzrle_counters.pages;
 }
 
+/**
+ * ram_predict_dirty_bytes: predict how much RAM the guest dirties
+ *
+ * Returns the number of bytes that the guest is expected to dirty in
+ * @ms milliseconds, based on the dirty rate of each RAMBlock.  A block
+ * never contributes more than its size, so a small block that is
+ * rewritten all the time does not make the prediction grow without
+ * bound.
+ *
+ * @ms: length of the period in milliseconds
+ * @scale: factor to apply to the dirty rates, e.g. to account for a
+ *         different CPU throttle
+ */
+uint64_t ram_predict_dirty_bytes(double ms, double scale)
+{
+    RAMBlock *block;
+    uint64_t total = 0;
+
+    RCU_READ_LOCK_GUARD();
+
+    RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+        total += MIN(block->dirty_rate * scale * ms,
+                     (double)block->used_length);
+    }
+    return total;
+}
+
+/* Called with RCU critical section */
+static void ramblock_update_dirty_rate(RAMBlock *rb, int64_t period)
+{
+    double rate = (double)rb->dirty_pages_period * TARGET_PAGE_SIZE / period;
+
+    /* Smooth out bursts, but follow changes within a few periods */
+    if (rb->dirty_rate) {
+        rate = (rb->dirty_rate + rate) / 2;
+    }
+    rb->dirty_rate = rate;
+    rb->dirty_pages_period = 0;
+}
+
+static void ram_update_dirty_rates(RAMState *rs, int64_t end_time)
+{
+    int64_t period = end_time - rs->time_last_bitmap_sync;
+    RAMBlock *block;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+            ramblock_update_dirty_rate(block, period);
+        }
+    }
+}
+
 static void migration_update_rates(RAMState *rs, int64_t end_time)
 {
     uint64_t page_count = rs->target_page_count - rs->target_page_count_prev;
@@ -1032,6 +1114,17 @@ static void migration_trigger_throttle(RAMState *rs)
         return;
     }
 
+    /*
+     * With a prediction at hand, go straight to the throttle that makes
+     * migration converge.  Otherwise, or if throttling cannot help
+     * according to the model, fall back to the step-wise increase.
+     */
+    if (migrate_auto_converge() && migrate_predictive_switchover() &&
+        mig_throttle_guest_predict()) {
+        rs->dirty_rate_high_cnt = 0;
+        return;
+    }
+
     /*
      * The following detection logic can be refined later. For now:
      * Check to see if the ratio between dirtied bytes and the approx.
@@ -1082,6 +1175,9 @@ static void migration_bitmap_sync(RAMState *rs, bool last_stage)
 
     /* more than 1 second = 1000 millisecons */
     if (end_time > rs->time_last_bitmap_sync + 1000) {
+        /* The switchover model needs them to decide on the throttle */
+        ram_update_dirty_rates(rs, end_time);
+
         migration_trigger_throttle(rs);
 
         migration_update_rates(rs, end_time);
@@ -2127,6 +2223,54 @@ static int ram_save_target_page_multifd(RAMState *rs, PageSearchStatus *pss)
     return ram_save_multifd_page(block, offset);
 }
 
+/**
+ * ram_save_dirty_range_multifd: let a multifd channel send a range of pages
+ *
+ * Claim the dirty bits of the range of the bitmap that starts with
+ * pss->page, and hand them to a multifd channel which finds and queues
+ * the dirty pages itself.  This leaves the migration thread with one
+ * word of the bitmap to handle per BITS_PER_LONG pages, instead of the
+ * work for each page.
+ *
+ * The caller must be with ram_state.bitmap_mutex held.
+ *
+ * Returns the number of dirty pages in the range or negative on error
+ *
+ * @rs: current RAM state
+ * @pss: data about the page we want to send
+ */
+static int ram_save_dirty_range_multifd(RAMState *rs, PageSearchStatus *pss)
+{
+    RAMBlock *rb = pss->block;
+    unsigned long size = rb->used_length >> TARGET_PAGE_BITS;
+    unsigned long start = QEMU_ALIGN_DOWN(pss->page, BITS_PER_LONG);
+    unsigned long npages = MIN(MULTIFD_SCAN_PAGES, size - start);
+    unsigned long bmap[BITS_TO_LONGS(MULTIFD_SCAN_PAGES)];
+    unsigned long dirty;
+
+    if (migrate_ram_is_ignored(rb)) {
+        error_report("block %s should not be migrated !", rb->idstr);
+        return 0;
+    }
+
+    /* Same as migration_bitmap_clear_dirty(), for the whole range */
+    migration_clear_memory_region_dirty_bitmap_range(rb, start, npages);
+    bitmap_copy(bmap, rb->bmap + BIT_WORD(start), npages);
+    bitmap_clear(rb->bmap, start, npages);
+    dirty = bitmap_count_one(bmap, npages);
+    rs->migration_dirty_pages -= dirty;
+
+    pss->page = start + npages;
+    if (!dirty) {
+        return 0;
+    }
+    if (!multifd_queue_scan(rb, start, npages, bmap)) {
+        return -1;
+    }
+
+    return dirty;
+}
+
 /* Should be called before sending a host page */
 static void pss_host_page_prepare(PageSearchStatus *pss)
 {
@@ -2366,7 +2510,11 @@ static int ram_find_and_save_block(RAMState *rs)
                 }
             }
         }
-        pages = ram_save_host_page(rs, pss);
+        if (migration_ops->ram_save_dirty_range) {
+            pages = migration_ops->ram_save_dirty_range(rs, pss);
+        } else {
+            pages = ram_save_host_page(rs, pss);
+        }
         if (pages) {
             break;
         }
@@ -2839,6 +2987,8 @@ static void ram_list_init_bitmaps(void)
              */
             block->bmap = bitmap_new(pages);
             bitmap_set(block->bmap, 0, pages);
+            block->dirty_pages_period = 0;
+            block->dirty_rate = 0;
             if (migrate_mapped_ram()) {
                 block->file_bmap = bitmap_new(pages);
             }
@@ -3157,6 +3307,16 @@ static int ram_save_setup(QEMUFile *f, void *opaque, Error **errp)
 
     if (migrate_multifd()) {
         migration_ops->ram_save_target_page = ram_save_target_page_multifd;
+        /*
+         * The multifd channels can find the dirty pages themselves, as
+         * long as nothing needs to look at each page on this thread.
+         */
+        if (migrate_multifd_parallel_scan() && !migrate_postcopy_ram() &&
+            !migrate_xbzrle() && !migrate_mapped_ram() && !migrate_colo() &&
+            !migrate_background_snapshot() &&
+            migrate_zero_page_detection() != ZERO_PAGE_DETECTION_LEGACY) {
+            migration_ops->ram_save_dirty_range = ram_save_dirty_range_multifd;
+        }
     } else {
         migration_ops->ram_save_target_page = ram_save_target_page_legacy;
     }
@@ -47,6 +47,7 @@ extern XBZRLECacheStats xbzrle_counters;
 int xbzrle_cache_resize(uint64_t new_size, Error **errp);
 uint64_t ram_bytes_remaining(void);
 uint64_t ram_bytes_total(void);
+uint64_t ram_predict_dirty_bytes(double ms, double scale);
 void mig_throttle_counter_reset(void);
 
 uint64_t ram_pagesize_summary(void);
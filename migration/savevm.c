@@ -69,6 +69,7 @@
 #include "yank_functions.h"
 #include "sysemu/qtest.h"
 #include "options.h"
+#include "multifd.h"
 
 const unsigned int postcopy_ram_discard_version;
 
@@ -91,6 +92,8 @@ enum qemu_vm_cmd {
     MIG_CMD_ENABLE_COLO,       /* Enable COLO */
     MIG_CMD_POSTCOPY_RESUME,   /* resume postcopy on dest */
     MIG_CMD_RECV_BITMAP,       /* Request for recved bitmap on dst */
+    MIG_CMD_MULTIFD_SYNC,      /* Wait for the multifd channels to sync */
+    MIG_CMD_DEVICE_STATE_COUNT, /* Number of device state buffers sent */
     MIG_CMD_MAX
 };
 
@@ -110,6 +113,9 @@ static struct mig_cmd_args {
     [MIG_CMD_POSTCOPY_RESUME]  = { .len =  0, .name = "POSTCOPY_RESUME" },
     [MIG_CMD_PACKAGED]         = { .len =  4, .name = "PACKAGED" },
     [MIG_CMD_RECV_BITMAP]      = { .len = -1, .name = "RECV_BITMAP" },
+    [MIG_CMD_MULTIFD_SYNC]     = { .len =  0, .name = "MULTIFD_SYNC" },
+    [MIG_CMD_DEVICE_STATE_COUNT] = {
+                                   .len = -1, .name = "DEVICE_STATE_COUNT" },
     [MIG_CMD_MAX]              = { .len = -1, .name = "MAX" },
 };
 
@@ -217,6 +223,20 @@ typedef struct SaveStateEntry {
     void *opaque;
     CompatEntry *compat;
     int is_ram;
+    /*
+     * Device state buffers received through multifd, protected by
+     * MigrationIncomingState.load_buffer_mutex.
+     *
+     * @load_buffers holds the buffers that arrived ahead of the next one
+     * to load, indexed by their position in the stream of the device.
+     * @load_buffer_busy is set while a thread is loading buffers for
+     * the device; other threads only add theirs to @load_buffers.
+     * @load_buffer_count is the number of buffers that the source sent.
+     */
+    GHashTable *load_buffers;
+    uint64_t load_buffer_idx;
+    uint64_t load_buffer_count;
+    bool load_buffer_busy;
 } SaveStateEntry;
 
 typedef struct SaveState {
@@ -1076,6 +1096,34 @@ void qemu_savevm_send_colo_enable(QEMUFile *f)
     qemu_savevm_command_send(f, MIG_CMD_ENABLE_COLO, 0, NULL);
 }
 
+void qemu_savevm_send_multifd_sync(QEMUFile *f)
+{
+    trace_savevm_send_multifd_sync();
+    qemu_savevm_command_send(f, MIG_CMD_MULTIFD_SYNC, 0, NULL);
+}
+
+/*
+ * Tell the destination how many device state buffers were sent through
+ * multifd for a device, so that it can tell if the last ones are lost.
+ */
+static void qemu_savevm_send_device_state_count(QEMUFile *f,
+                                                const char *idstr,
+                                                uint32_t instance_id,
+                                                uint64_t count)
+{
+    uint8_t buf[1 + 255 + 4 + 8];
+    size_t len = strlen(idstr);
+
+    trace_savevm_send_device_state_count(idstr, instance_id, count);
+
+    buf[0] = len;
+    memcpy(buf + 1, idstr, len);
+    stl_be_p(buf + 1 + len, instance_id);
+    stq_be_p(buf + 1 + len + 4, count);
+    qemu_savevm_command_send(f, MIG_CMD_DEVICE_STATE_COUNT, len + 1 + 4 + 8,
+                             buf);
+}
+
 void qemu_savevm_send_ping(QEMUFile *f, uint32_t value)
 {
     uint32_t buf;
@@ -1531,6 +1579,111 @@ int qemu_savevm_state_complete_precopy_iterable(QEMUFile *f, bool in_postcopy)
     return 0;
 }
 
+typedef struct SaveCompletePrecopyThread {
+    QemuThread thread;
+    const SaveVMHandlers *ops;
+    SaveLiveCompletePrecopyThreadData data;
+    Error *err;
+    int ret;
+} SaveCompletePrecopyThread;
+
+static void *qemu_savevm_complete_precopy_thread(void *opaque)
+{
+    SaveCompletePrecopyThread *t = opaque;
+
+    rcu_register_thread();
+    t->ret = t->ops->save_live_complete_precopy_thread(&t->data, &t->err);
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/*
+ * Run the save_live_complete_precopy_thread handlers in parallel, and
+ * make sure that the destination has loaded everything they sent
+ * before it sees anything that follows in the main stream.
+ */
+static int qemu_savevm_state_complete_precopy_threads(QEMUFile *f)
+{
+    MigrationState *ms = migrate_get_current();
+    g_autoptr(GPtrArray) threads = NULL;
+    SaveStateEntry *se;
+    Error *local_err = NULL;
+    int ret;
+
+    if (!multifd_device_state_supported()) {
+        return 0;
+    }
+
+    threads = g_ptr_array_new_with_free_func(g_free);
+    QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        SaveCompletePrecopyThread *t;
+
+        if (!se->ops || !se->ops->save_live_complete_precopy_thread) {
+            continue;
+        }
+        if (se->ops->is_active) {
+            if (!se->ops->is_active(se->opaque)) {
+                continue;
+            }
+        }
+
+        t = g_new0(SaveCompletePrecopyThread, 1);
+        t->ops = se->ops;
+        t->data.idstr = se->idstr;
+        t->data.instance_id = se->instance_id;
+        t->data.opaque = se->opaque;
+        qemu_thread_create(&t->thread, "mig/src/devstate",
+                           qemu_savevm_complete_precopy_thread, t,
+                           QEMU_THREAD_JOINABLE);
+        g_ptr_array_add(threads, t);
+    }
+
+    trace_savevm_state_complete_precopy_threads(threads->len);
+    if (!threads->len) {
+        return 0;
+    }
+
+    for (guint i = 0; i < threads->len; i++) {
+        SaveCompletePrecopyThread *t = g_ptr_array_index(threads, i);
+
+        qemu_thread_join(&t->thread);
+        if (t->ret && !local_err) {
+            if (!t->err) {
+                /* Do not let a failure without an error go unnoticed */
+                error_setg(&t->err, "error %d", t->ret);
+            }
+            error_propagate_prepend(&local_err, t->err,
+                                    "Saving state of device %s failed: ",
+                                    t->data.idstr);
+        } else {
+            error_free(t->err);
+        }
+    }
+    if (local_err) {
+        migrate_set_error(ms, local_err);
+        error_report_err(local_err);
+        qemu_file_set_error(f, -EINVAL);
+        return -EINVAL;
+    }
+
+    ret = multifd_send_sync_main();
+    if (ret) {
+        qemu_file_set_error(f, ret);
+        return ret;
+    }
+    for (guint i = 0; i < threads->len; i++) {
+        SaveCompletePrecopyThread *t = g_ptr_array_index(threads, i);
+
+        qemu_savevm_send_device_state_count(f, t->data.idstr,
+                                            t->data.instance_id,
+                                            t->data.idx);
+    }
+    qemu_savevm_send_multifd_sync(f);
+
+    trace_vmstate_downtime_checkpoint("src-device-state-threads-saved");
+    return 0;
+}
+
 int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
                                                     bool in_postcopy,
                                                     bool inactivate_disks)
@@ -1627,6 +1780,13 @@ int qemu_savevm_state_complete_precopy(QEMUFile *f, bool iterable_only,
         goto flush;
     }
 
+    if (!in_postcopy) {
+        ret = qemu_savevm_state_complete_precopy_threads(f);
+        if (ret) {
+            return ret;
+        }
+    }
+
     ret = qemu_savevm_state_complete_precopy_non_iterable(f, in_postcopy,
                                                           inactivate_disks);
     if (ret) {
@@ -2435,6 +2595,162 @@ static int loadvm_process_enable_colo(MigrationIncomingState *mis)
     return ret;
 }
 
+typedef struct LoadStateBuffer {
+    uint64_t idx;
+    char *data;
+    size_t len;
+} LoadStateBuffer;
+
+static void load_state_buffer_free(gpointer opaque)
+{
+    LoadStateBuffer *lb = opaque;
+
+    g_free(lb->data);
+    g_free(lb);
+}
+
+/*
+ * Called by the multifd receive threads for each device state buffer.
+ * Takes ownership of @buf.
+ *
+ * The buffer is passed to the device right away if it is the next one
+ * the device expects and no other thread is loading state for it.
+ * Otherwise it is kept, and loaded by the thread that loads the buffers
+ * before it.
+ *
+ * Returns 0 for success, -1 for error
+ */
+int qemu_loadvm_load_state_buffer(const char *idstr, uint32_t instance_id,
+                                  uint64_t idx, char *buf, size_t len,
+                                  Error **errp)
+{
+    MigrationIncomingState *mis = migration_incoming_get_current();
+    SaveStateEntry *se = find_se(idstr, instance_id);
+    LoadStateBuffer *lb;
+    int ret;
+
+    if (!se || !se->ops || !se->ops->load_state_buffer) {
+        error_setg(errp, "Unexpected device state buffer for %s "
+                   "instance %u", idstr, instance_id);
+        g_free(buf);
+        return -1;
+    }
+
+    lb = g_new(LoadStateBuffer, 1);
+    lb->idx = idx;
+    lb->data = buf;
+    lb->len = len;
+
+    WITH_QEMU_LOCK_GUARD(&mis->load_buffer_mutex) {
+        if (!se->load_buffers) {
+            se->load_buffers = g_hash_table_new_full(g_int64_hash,
+                                                     g_int64_equal, NULL,
+                                                     load_state_buffer_free);
+        }
+        if (idx < se->load_buffer_idx ||
+            g_hash_table_contains(se->load_buffers, &idx)) {
+            error_setg(errp, "Duplicate device state buffer %" PRIu64
+                       " for %s instance %u", idx, idstr, instance_id);
+            load_state_buffer_free(lb);
+            return -1;
+        }
+        g_hash_table_insert(se->load_buffers, &lb->idx, lb);
+        if (se->load_buffer_busy) {
+            return 0;
+        }
+        se->load_buffer_busy = true;
+    }
+
+    while (true) {
+        WITH_QEMU_LOCK_GUARD(&mis->load_buffer_mutex) {
+            /* The buffers are gone if the migration failed meanwhile */
+            lb = se->load_buffers ?
+                g_hash_table_lookup(se->load_buffers, &se->load_buffer_idx) :
+                NULL;
+            if (!lb) {
+                se->load_buffer_busy = false;
+                return 0;
+            }
+            g_hash_table_steal(se->load_buffers, &se->load_buffer_idx);
+            se->load_buffer_idx++;
+        }
+
+        ret = se->ops->load_state_buffer(se->opaque, lb->data, lb->len, errp);
+        load_state_buffer_free(lb);
+        if (ret) {
+            error_prepend(errp, "Loading state of device %s failed: ",
+                          se->idstr);
+            WITH_QEMU_LOCK_GUARD(&mis->load_buffer_mutex) {
+                se->load_buffer_busy = false;
+            }
+            return -1;
+        }
+    }
+}
+
+static int loadvm_handle_device_state_count(MigrationIncomingState *mis,
+                                            uint16_t len)
+{
+    QEMUFile *file = mis->from_src_file;
+    SaveStateEntry *se;
+    char idstr[256];
+    uint32_t instance_id;
+    uint64_t count;
+    size_t cnt;
+
+    cnt = qemu_get_counted_string(file, idstr);
+    instance_id = qemu_get_be32(file);
+    count = qemu_get_be64(file);
+
+    /* Validate before using the data */
+    if (qemu_file_get_error(file)) {
+        return qemu_file_get_error(file);
+    }
+
+    if (!cnt || len != cnt + 1 + 4 + 8) {
+        error_report("%s: invalid payload length (%d)", __func__, len);
+        return -EINVAL;
+    }
+
+    trace_loadvm_handle_device_state_count(idstr, instance_id, count);
+
+    se = find_se(idstr, instance_id);
+    if (!se || !se->ops || !se->ops->load_state_buffer) {
+        error_report("Unexpected device state buffers for %s instance %u",
+                     idstr, instance_id);
+        return -EINVAL;
+    }
+
+    QEMU_LOCK_GUARD(&mis->load_buffer_mutex);
+    se->load_buffer_count = count;
+    return 0;
+}
+
+/*
+ * The source has sent all device state buffers, told how many there are
+ * for each device, and synced the multifd channels; wait for them to have
+ * loaded everything.
+ */
+static int loadvm_handle_multifd_sync(MigrationIncomingState *mis)
+{
+    SaveStateEntry *se;
+
+    trace_loadvm_handle_multifd_sync();
+    multifd_recv_sync_main();
+
+    QEMU_LOCK_GUARD(&mis->load_buffer_mutex);
+    QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        if ((se->load_buffers && g_hash_table_size(se->load_buffers)) ||
+            se->load_buffer_idx < se->load_buffer_count) {
+            error_report("Device %s instance %u is missing device state "
+                         "buffer %" PRIu64, se->idstr, se->instance_id,
+                         se->load_buffer_idx);
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
 /*
  * Process an incoming 'QEMU_VM_COMMAND'
  * 0           just a normal return
@@ -2533,6 +2849,12 @@ static int loadvm_process_command(QEMUFile *f)
 
     case MIG_CMD_ENABLE_COLO:
         return loadvm_process_enable_colo(mis);
+
+    case MIG_CMD_MULTIFD_SYNC:
+        return loadvm_handle_multifd_sync(mis);
+
+    case MIG_CMD_DEVICE_STATE_COUNT:
+        return loadvm_handle_device_state_count(mis, len);
     }
 
     return 0;
@@ -2798,9 +3120,17 @@ static int qemu_loadvm_state_setup(QEMUFile *f, Error **errp)
 
 void qemu_loadvm_state_cleanup(void)
 {
+    MigrationIncomingState *mis = migration_incoming_get_current();
     SaveStateEntry *se;
 
     trace_loadvm_state_cleanup();
+    WITH_QEMU_LOCK_GUARD(&mis->load_buffer_mutex) {
+        QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+            g_clear_pointer(&se->load_buffers, g_hash_table_destroy);
+            se->load_buffer_idx = 0;
+            se->load_buffer_count = 0;
+        }
+    }
     QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
         if (se->ops && se->ops->load_cleanup) {
             se->ops->load_cleanup(se->opaque);
@@ -0,0 +1,76 @@
+/*
+ * Migration switchover simulation
+ *
+ * The arithmetic of the switchover model, kept apart from the state of
+ * the migration so that it can be unit tested.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "switchover.h"
+
+/* Migration that needs more iterations than this is not converging */
+#define SWITCHOVER_MAX_ITERATIONS   10
+
+bool switchover_simulate(const SwitchoverSim *sim, uint64_t ram,
+                         double scale, uint64_t *iterations, double *time)
+{
+    double limit = sim->switchover_bw * sim->downtime_limit;
+    double elapsed = 0;
+    double round;
+    int i;
+
+    for (i = 0; i < SWITCHOVER_MAX_ITERATIONS; i++) {
+        if (ram + sim->device_state <= limit) {
+            if (iterations) {
+                *iterations = i;
+            }
+            if (time) {
+                *time = elapsed;
+            }
+            return true;
+        }
+        round = ram / sim->bandwidth;
+        elapsed += round;
+        ram = sim->dirty_bytes(round, scale);
+    }
+    return false;
+}
+
+/*
+ * Scale of the dirty rates at throttle @pct, given that they were
+ * measured at throttle @pct_now: the guest dirties memory in proportion
+ * to the CPU time it gets.
+ */
+static double switchover_throttle_scale(int pct, int pct_now)
+{
+    return (100.0 - pct) / (100 - pct_now);
+}
+
+int switchover_min_throttle(const SwitchoverSim *sim, uint64_t ram,
+                            int pct_now, int pct_max)
+{
+    int pct_min = 0;
+
+    if (!switchover_simulate(sim, ram,
+                             switchover_throttle_scale(pct_max, pct_now),
+                             NULL, NULL)) {
+        return -1;
+    }
+
+    /* More throttle never dirties more, so look for the least needed */
+    while (pct_min < pct_max) {
+        int pct = (pct_min + pct_max) / 2;
+
+        if (switchover_simulate(sim, ram,
+                                switchover_throttle_scale(pct, pct_now),
+                                NULL, NULL)) {
+            pct_max = pct;
+        } else {
+            pct_min = pct + 1;
+        }
+    }
+    return pct_min;
+}
@@ -0,0 +1,145 @@
+/*
+ * Migration switchover prediction
+ *
+ * Model the migration from the dirty rate of each RAMBlock, the
+ * bandwidth of the link and the amount of device state, to predict
+ * when the guest can be stopped within downtime-limit and how much it
+ * has to be throttled for that to happen.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/lockable.h"
+#include "qapi/clone-visitor.h"
+#include "qapi/qapi-visit-migration.h"
+#include "sysemu/cpu-throttle.h"
+#include "options.h"
+#include "ram.h"
+#include "switchover.h"
+#include "trace.h"
+
+/*
+ * Weight of a new bandwidth sample.  There is one sample every
+ * BUFFER_DELAY milliseconds, so this follows a change of the link
+ * within about a second.
+ */
+#define SWITCHOVER_BW_WEIGHT        0.25
+
+typedef struct {
+    QemuMutex lock;
+    /* inputs of the simulation */
+    SwitchoverSim sim;
+    /* whether pred holds a prediction */
+    bool valid;
+    SwitchoverPrediction pred;
+} SwitchoverModel;
+
+static SwitchoverModel switchover;
+
+static void __attribute__((constructor)) switchover_init(void)
+{
+    qemu_mutex_init(&switchover.lock);
+}
+
+void switchover_reset(void)
+{
+    QEMU_LOCK_GUARD(&switchover.lock);
+    switchover.sim.bandwidth = 0;
+    switchover.sim.switchover_bw = 0;
+    switchover.sim.device_state = 0;
+    switchover.valid = false;
+}
+
+double switchover_update_bandwidth(double bandwidth)
+{
+    QEMU_LOCK_GUARD(&switchover.lock);
+    if (switchover.sim.bandwidth) {
+        bandwidth = switchover.sim.bandwidth +
+                    (bandwidth - switchover.sim.bandwidth) *
+                    SWITCHOVER_BW_WEIGHT;
+    }
+    switchover.sim.bandwidth = bandwidth;
+    return bandwidth;
+}
+
+void switchover_update_pending(uint64_t pending)
+{
+    uint64_t ram = ram_bytes_remaining();
+
+    QEMU_LOCK_GUARD(&switchover.lock);
+    switchover.sim.device_state = pending > ram ? pending - ram : 0;
+}
+
+/* Called with the model lock held */
+static void switchover_predict_locked(SwitchoverModel *m)
+{
+    SwitchoverPrediction *pred = &m->pred;
+    SwitchoverSim *sim = &m->sim;
+    uint64_t ram = ram_bytes_remaining();
+    int pct_now = cpu_throttle_active() ? cpu_throttle_get_percentage() : 0;
+    uint64_t iterations;
+    double time;
+    int pct;
+
+    if (!sim->bandwidth || !sim->switchover_bw) {
+        return;
+    }
+    sim->downtime_limit = migrate_downtime_limit();
+    sim->dirty_bytes = ram_predict_dirty_bytes;
+
+    memset(pred, 0, sizeof(*pred));
+    pred->bandwidth = sim->bandwidth * 1000;
+    pred->dirty_rate = ram_predict_dirty_bytes(1000, 1);
+    pred->device_state = sim->device_state;
+    pred->downtime = (ram + sim->device_state) / sim->switchover_bw;
+
+    pred->converging = switchover_simulate(sim, ram, 1, &iterations, &time);
+    if (pred->converging) {
+        pred->has_iterations = true;
+        pred->iterations = iterations;
+        pred->has_time_to_switchover = true;
+        pred->time_to_switchover = time;
+    }
+
+    pct = switchover_min_throttle(sim, ram, pct_now,
+                                  migrate_max_cpu_throttle());
+    if (pct >= 0) {
+        pred->has_cpu_throttle = true;
+        pred->cpu_throttle = pct;
+    }
+    m->valid = true;
+
+    trace_switchover_predict(pred->bandwidth, pred->dirty_rate,
+                             pred->device_state, pred->downtime,
+                             pred->converging,
+                             pred->has_cpu_throttle ? pred->cpu_throttle : -1);
+}
+
+void switchover_predict(double switchover_bw)
+{
+    QEMU_LOCK_GUARD(&switchover.lock);
+    switchover.sim.switchover_bw = switchover_bw;
+    switchover_predict_locked(&switchover);
+}
+
+int switchover_cpu_throttle(void)
+{
+    QEMU_LOCK_GUARD(&switchover.lock);
+    /* The dirty rates have just been updated, refresh the prediction */
+    switchover_predict_locked(&switchover);
+    if (!switchover.valid || !switchover.pred.has_cpu_throttle) {
+        return -1;
+    }
+    return switchover.pred.cpu_throttle;
+}
+
+SwitchoverPrediction *switchover_get_prediction(void)
+{
+    QEMU_LOCK_GUARD(&switchover.lock);
+    if (!switchover.valid) {
+        return NULL;
+    }
+    return QAPI_CLONE(SwitchoverPrediction, &switchover.pred);
+}
@@ -0,0 +1,110 @@
+/*
+ * Migration switchover prediction
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_MIGRATION_SWITCHOVER_H
+#define QEMU_MIGRATION_SWITCHOVER_H
+
+#include "qapi/qapi-types-migration.h"
+
+typedef struct SwitchoverSim {
+    /* smoothed migration bandwidth, in bytes per millisecond */
+    double bandwidth;
+    /* bandwidth expected at switchover, in bytes per millisecond */
+    double switchover_bw;
+    /* pending data that is not RAM, in bytes */
+    uint64_t device_state;
+    /* maximum downtime, in milliseconds */
+    uint64_t downtime_limit;
+    /* bytes the guest dirties in @ms milliseconds, with rates scaled */
+    uint64_t (*dirty_bytes)(double ms, double scale);
+} SwitchoverSim;
+
+/**
+ * switchover_simulate: simulate the remaining iterations
+ *
+ * Each iteration sends the dirty RAM, while the guest dirties more of
+ * it.  Switchover happens as soon as the dirty RAM and the device state
+ * can be sent within the downtime limit.
+ *
+ * Returns true if switchover happens within a bounded number of
+ * iterations.
+ *
+ * @sim: the inputs of the simulation
+ * @ram: dirty RAM at the start, in bytes
+ * @scale: scale of the dirty rates
+ * @iterations: if not NULL, set to the number of iterations before
+ *              switchover
+ * @time: if not NULL, set to the time before switchover, in milliseconds
+ */
+bool switchover_simulate(const SwitchoverSim *sim, uint64_t ram,
+                         double scale, uint64_t *iterations, double *time);
+
+/**
+ * switchover_min_throttle: find the least CPU throttle that converges
+ *
+ * Returns the smallest CPU throttle percentage, up to @pct_max, with
+ * which switchover_simulate() succeeds, or -1 if there is none.
+ *
+ * @sim: the inputs of the simulation
+ * @ram: dirty RAM at the start, in bytes
+ * @pct_now: CPU throttle at which the dirty rates were measured
+ * @pct_max: the largest CPU throttle allowed
+ */
+int switchover_min_throttle(const SwitchoverSim *sim, uint64_t ram,
+                            int pct_now, int pct_max);
+
+/**
+ * switchover_reset: forget everything learnt by a previous migration
+ */
+void switchover_reset(void);
+
+/**
+ * switchover_update_bandwidth: add a bandwidth sample to the model
+ *
+ * Returns the smoothed bandwidth, in bytes per millisecond.
+ *
+ * @bandwidth: bandwidth measured in the last period, in bytes per
+ *             millisecond
+ */
+double switchover_update_bandwidth(double bandwidth);
+
+/**
+ * switchover_update_pending: tell the model how much is left to send
+ *
+ * Anything that is pending but is not dirty RAM is accounted as device
+ * state, which has to be sent again while the guest is stopped.
+ *
+ * @pending: total amount of pending data, in bytes
+ */
+void switchover_update_pending(uint64_t pending);
+
+/**
+ * switchover_predict: update the predictions of the model
+ *
+ * @switchover_bw: bandwidth expected while the guest is stopped, in
+ *                 bytes per millisecond
+ */
+void switchover_predict(double switchover_bw);
+
+/**
+ * switchover_cpu_throttle: predict the CPU throttle needed to converge
+ *
+ * Returns the smallest CPU throttle percentage, up to max-cpu-throttle,
+ * with which migration is predicted to meet downtime-limit, or -1 if
+ * no throttle is enough or there is no prediction yet.
+ */
+int switchover_cpu_throttle(void);
+
+/**
+ * switchover_get_prediction: get the last predictions of the model
+ *
+ * Returns a copy of the predictions, to be freed by the caller, or
+ * NULL if there are none yet.
+ */
+SwitchoverPrediction *switchover_get_prediction(void);
+
+#endif
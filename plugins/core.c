@@ -399,6 +399,19 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
     dyn_cb->regular.info = &info[flags];
 }
 
+void plugin_register_vcpu_mem_record(GArray **arr,
+                                     enum qemu_plugin_mem_rw rw,
+                                     struct qemu_plugin_mem_buffer *buf,
+                                     void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+
+    dyn_cb->userp = udata;
+    dyn_cb->type = PLUGIN_CB_MEM_RECORD;
+    dyn_cb->rw = rw;
+    dyn_cb->record.buf = buf;
+}
+
 /*
  * Disable CFI checks.
  * The callback function has been loaded from an external library so we do not
@@ -530,6 +543,57 @@ void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index)
     }
 }
 
+QEMU_DISABLE_CFI
+void plugin_mem_buffer_flush(struct qemu_plugin_mem_buffer *buf,
+                             unsigned int vcpu_index)
+{
+    struct qemu_plugin_mem_ring *ring =
+        plugin_scoreboard_find(buf->score, vcpu_index);
+    size_t ring_size = 2 * buf->n_records;
+    uint64_t count = ring->count;
+
+    /*
+     * Clear the count first, so that a buffer with a plugin that
+     * flushes it from its own callback is not delivered twice.
+     */
+    ring->count = 0;
+    if (count > ring_size) {
+        /* The ring wrapped around; the oldest records start at count. */
+        size_t start = count & (ring_size - 1);
+
+        buf->cb(vcpu_index, ring->records + start,
+                ring_size - start, buf->userdata);
+        count = start;
+    }
+    if (count) {
+        buf->cb(vcpu_index, ring->records, count, buf->userdata);
+    }
+}
+
+void qemu_plugin_vcpu_mem_buffer_full(unsigned int vcpu_index, void *buf)
+{
+    plugin_mem_buffer_flush(buf, vcpu_index);
+}
+
+/* Record an access performed from a helper, as generated code would. */
+static void plugin_mem_record(struct qemu_plugin_dyn_cb *cb,
+                              unsigned int vcpu_index, uint64_t vaddr,
+                              qemu_plugin_meminfo_t info)
+{
+    struct qemu_plugin_mem_buffer *buf = cb->record.buf;
+    struct qemu_plugin_mem_ring *ring =
+        plugin_scoreboard_find(buf->score, vcpu_index);
+    struct qemu_plugin_mem_record *rec;
+
+    if (ring->count >= buf->n_records) {
+        plugin_mem_buffer_flush(buf, vcpu_index);
+    }
+    rec = &ring->records[ring->count++ & (2 * buf->n_records - 1)];
+    rec->vaddr = vaddr;
+    rec->userdata = cb->userp;
+    rec->info = info;
+}
+
 void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                              MemOpIdx oi, enum qemu_plugin_mem_rw rw)
 {
@@ -554,6 +618,10 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
         case PLUGIN_CB_INLINE:
             exec_inline_op(cb, cpu->cpu_index);
             break;
+        case PLUGIN_CB_MEM_RECORD:
+            plugin_mem_record(cb, cpu->cpu_index, vaddr,
+                              make_plugin_meminfo(oi, rw));
+            break;
         default:
             g_assert_not_reached();
         }
@@ -688,3 +756,33 @@ void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
     g_array_free(score->data, TRUE);
     g_free(score);
 }
+
+void *plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                             unsigned int vcpu_index)
+{
+    /* we can't use g_array_index since entry size is not statically known */
+    char *base_ptr = score->data->data;
+    return base_ptr + vcpu_index * g_array_get_element_size(score->data);
+}
+
+struct qemu_plugin_mem_buffer *
+plugin_mem_buffer_new(size_t n_records,
+                      qemu_plugin_vcpu_mem_batch_cb_t cb, void *userdata)
+{
+    struct qemu_plugin_mem_buffer *buf =
+        g_new0(struct qemu_plugin_mem_buffer, 1);
+
+    buf->n_records = pow2ceil(MAX(n_records, 1));
+    buf->cb = cb;
+    buf->userdata = userdata;
+    buf->score = plugin_scoreboard_new(
+        sizeof(struct qemu_plugin_mem_ring) +
+        2 * buf->n_records * sizeof(struct qemu_plugin_mem_record));
+    return buf;
+}
+
+void plugin_mem_buffer_free(struct qemu_plugin_mem_buffer *buf)
+{
+    plugin_scoreboard_free(buf->score);
+    g_free(buf);
+}
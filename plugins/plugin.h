@@ -100,6 +100,11 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
                                  enum qemu_plugin_mem_rw rw,
                                  void *udata);
 
+void plugin_register_vcpu_mem_record(GArray **arr,
+                                     enum qemu_plugin_mem_rw rw,
+                                     struct qemu_plugin_mem_buffer *buf,
+                                     void *udata);
+
 void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index);
 
 int plugin_num_vcpus(void);
@@ -108,4 +113,16 @@ struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size);
 
 void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
 
+void *plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                             unsigned int vcpu_index);
+
+struct qemu_plugin_mem_buffer *
+plugin_mem_buffer_new(size_t n_records,
+                      qemu_plugin_vcpu_mem_batch_cb_t cb, void *userdata);
+
+void plugin_mem_buffer_free(struct qemu_plugin_mem_buffer *buf);
+
+void plugin_mem_buffer_flush(struct qemu_plugin_mem_buffer *buf,
+                             unsigned int vcpu_index);
+
 #endif /* PLUGIN_H */
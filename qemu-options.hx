@@ -186,7 +186,13 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                kvm-shadow-mem=size of KVM shadow MMU in bytes\n"
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
+    "                superblock=on|off (continue TCG translation blocks across direct jumps)\n"
+    "                superblock-threshold=n (retranslate hot TCG translation blocks as superblocks)\n"
+    "                translate-ahead=on|off (translate TCG jump targets before they run)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                tb-hugepages=transparent|explicit|off (huge pages for TCG translation block cache)\n"
+    "                tb-numa=on|off (NUMA-local TCG translation block cache regions)\n"
+    "                tb-stats=off|sample|full (collect per TCG translation block statistics)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                eager-split-size=n (KVM Eager Page Split chunk size, default 0, disabled. ARM only)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
@@ -227,9 +233,64 @@ SRST
         such a case this will default on. On other operating systems, this
         will default off, but one may enable this for testing or debugging.
 
+    ``superblock=on|off``
+        Lets the TCG accelerator keep translating through direct
+        unconditional jumps that stay within the page of the current
+        translation block, instead of ending the block at the jump.
+        This reduces the number of block transitions on branchy code.
+        Only guests whose front-end supports it are affected
+        (currently AArch64). The default is off.
+
+    ``superblock-threshold=n``
+        Enables tiered translation: translation blocks are first
+        translated without superblocks, and once one has been looked
+        up by the execution loop more than ``n`` times it is
+        retranslated as a superblock, replacing the original. This
+        keeps translation cheap for cold code. The default is 0,
+        which disables retranslation. It has no effect when
+        ``superblock=on``, with ``-d nochain`` or single-stepping, or
+        on code that the guest's translator cannot form superblocks
+        from, such as Arm code in AArch32 state.
+
+    ``translate-ahead=on|off``
+        When a new translation block is created, also translate the
+        targets of its direct jumps that lie in the same guest page,
+        so that they can be chained as soon as the block first exits.
+        This trades some translation of code that may never run for
+        fewer returns to the main execution loop. It has no effect on
+        guests whose translator has not been checked to fetch code
+        safely ahead of execution. The default is off.
+
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``tb-hugepages=transparent|explicit|off``
+        Controls how the TCG translation block cache is backed by huge
+        pages. ``transparent``, the default, requests transparent huge
+        pages. ``explicit`` allocates the cache from the hugetlbfs pool,
+        which must have been reserved on the host; this is only supported
+        on Linux hosts, and falls back to normal pages with a warning if
+        the allocation fails. ``off`` uses normal pages only.
+
+    ``tb-numa=on|off``
+        Spread the regions of the TCG translation block cache over the
+        host NUMA nodes, and have each vCPU thread allocate regions from
+        the node on which it runs where possible. This requires
+        multi-threaded TCG and a host with NUMA support. The default is
+        off.
+
+    ``tb-stats=off|sample|full``
+        Collects statistics for each block of guest code: how often it
+        was executed, how often and for how long it was translated, the
+        size of the generated host code, how its executions ended and how
+        often it could not be chained to the next block. ``sample`` only
+        counts executions that start from the main execution loop, which
+        adds no overhead to the generated code but misses blocks reached
+        through chained jumps; ``full`` counts every execution. The
+        statistics are cleared when the translation cache is flushed,
+        and can be read with the ``x-query-tb-stats`` and
+        ``x-query-tb-stats-folded`` QMP commands. The default is off.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
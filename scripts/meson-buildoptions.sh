@@ -145,6 +145,7 @@ meson_options_help() {
   printf "%s\n" '  linux-io-uring  Linux io_uring support'
   printf "%s\n" '  live-block-migration'
   printf "%s\n" '                  block migration in the main migration stream'
+  printf "%s\n" '  lz4             lz4 compression support'
   printf "%s\n" '  lzfse           lzfse support for DMG images'
   printf "%s\n" '  lzo             lzo compression support'
   printf "%s\n" '  malloc-trim     enable libc malloc_trim() for memory optimization'
@@ -386,6 +387,8 @@ _meson_option_parse() {
     --disable-live-block-migration) printf "%s" -Dlive_block_migration=disabled ;;
     --localedir=*) quote_sh "-Dlocaledir=$2" ;;
     --localstatedir=*) quote_sh "-Dlocalstatedir=$2" ;;
+    --enable-lz4) printf "%s" -Dlz4=enabled ;;
+    --disable-lz4) printf "%s" -Dlz4=disabled ;;
     --enable-lzfse) printf "%s" -Dlzfse=enabled ;;
     --disable-lzfse) printf "%s" -Dlzfse=disabled ;;
     --enable-lzo) printf "%s" -Dlzo=enabled ;;
@@ -96,6 +96,14 @@ void arm_cpu_synchronize_from_tb(CPUState *cs,
     }
 }
 
+#ifdef TARGET_AARCH64
+static bool arm_cpu_superblock(const TranslationBlock *tb)
+{
+    /* Only the A64 decoder follows jumps */
+    return FIELD_EX32(tb->flags, TBFLAG_ANY, AARCH64_STATE);
+}
+#endif
+
 void arm_restore_state_to_opc(CPUState *cs,
                               const TranslationBlock *tb,
                               const uint64_t *data)
@@ -2615,6 +2623,10 @@ static const struct SysemuCPUOps arm_sysemu_ops = {
 #ifdef CONFIG_TCG
 static const TCGCPUOps arm_tcg_ops = {
     .initialize = arm_translate_init,
+#ifdef TARGET_AARCH64
+    .superblock = arm_cpu_superblock,
+#endif
+    .translate_ahead = true,
     .synchronize_from_tb = arm_cpu_synchronize_from_tb,
     .debug_excp_handler = arm_debug_excp_handler,
     .restore_state_to_opc = arm_restore_state_to_opc,
@@ -426,10 +426,48 @@ typedef struct DisasCompare64 {
     TCGv_i64 value;
 } DisasCompare64;
 
-static void a64_test_cc(DisasCompare64 *c64, int cc)
+/*
+ * Evaluate condition @cc from the operands of the previous compare,
+ * if they are known, rather than from NZCV.
+ */
+static bool a64_test_cc_lazy(DisasContext *s, DisasCompare64 *c64, int cc)
+{
+    /* Conditions that depend only on the relation of the operands. */
+    static const TCGCond cc_to_cond[16] = {
+        [0] = TCG_COND_EQ,      /* eq */
+        [1] = TCG_COND_NE,      /* ne */
+        [2] = TCG_COND_GEU,     /* cs */
+        [3] = TCG_COND_LTU,     /* cc */
+        [8] = TCG_COND_GTU,     /* hi */
+        [9] = TCG_COND_LEU,     /* ls */
+        [10] = TCG_COND_GE,     /* ge */
+        [11] = TCG_COND_LT,     /* lt */
+        [12] = TCG_COND_GT,     /* gt */
+        [13] = TCG_COND_LE,     /* le */
+    };
+    TCGCond cond = cc_to_cond[cc];
+    TCGv_i64 value;
+
+    if (cond == TCG_COND_NEVER) {
+        return false;
+    }
+    value = translator_cc_setcond(&s->base, cond);
+    if (!value) {
+        return false;
+    }
+    c64->cond = TCG_COND_NE;
+    c64->value = value;
+    return true;
+}
+
+static void a64_test_cc(DisasContext *s, DisasCompare64 *c64, int cc)
 {
     DisasCompare c32;
 
+    if (a64_test_cc_lazy(s, c64, cc)) {
+        return;
+    }
+
     arm_test_cc(&c32, cc);
 
     /*
@@ -1378,6 +1416,15 @@ static inline AArch64DecodeFn *lookup_disas_fn(const AArch64DecodeTable *table,
 static bool trans_B(DisasContext *s, arg_i *a)
 {
     reset_btype(s);
+    if (!s->ss_active &&
+        translator_follow_jump(&s->base, s->pc_curr + a->imm)) {
+        /* Re-bound the number of insns to those left on the page.  */
+        int bound = -(s->base.pc_next | TARGET_PAGE_MASK) / 4;
+
+        s->base.max_insns = MIN(s->base.max_insns,
+                                s->base.num_insns + bound);
+        return true;
+    }
     gen_goto_tb(s, 0, a->imm);
     return true;
 }
@@ -1437,7 +1484,13 @@ static bool trans_B_cond(DisasContext *s, arg_B_cond *a)
     if (a->cond < 0x0e) {
         /* genuinely conditional branches */
         DisasLabel match = gen_disas_label(s);
-        arm_gen_test_cc(a->cond, match.label);
+        DisasCompare64 c;
+
+        if (a64_test_cc_lazy(s, &c, a->cond)) {
+            tcg_gen_brcondi_i64(c.cond, c.value, 0, match.label);
+        } else {
+            arm_gen_test_cc(a->cond, match.label);
+        }
         gen_goto_tb(s, 0, 4);
         set_disas_label(s, match);
         gen_goto_tb(s, 1, a->imm);
@@ -4230,8 +4283,20 @@ static bool trans_ADRP(DisasContext *s, arg_ri *a)
  */
 TRANS(ADD_i, gen_rri, a, 1, 1, tcg_gen_add_i64)
 TRANS(SUB_i, gen_rri, a, 1, 1, tcg_gen_sub_i64)
-TRANS(ADDS_i, gen_rri, a, 0, 1, a->sf ? gen_add64_CC : gen_add32_CC)
-TRANS(SUBS_i, gen_rri, a, 0, 1, a->sf ? gen_sub64_CC : gen_sub32_CC)
+
+static bool gen_rri_CC(DisasContext *s, arg_rri_sf *a, bool sub_op)
+{
+    translator_cc_set(&s->base,
+                      sub_op ? TRANSLATOR_CC_SUB : TRANSLATOR_CC_ADD,
+                      a->sf, cpu_reg_sp(s, a->rn), tcg_constant_i64(a->imm));
+    if (sub_op) {
+        return gen_rri(s, a, 0, 1, a->sf ? gen_sub64_CC : gen_sub32_CC);
+    }
+    return gen_rri(s, a, 0, 1, a->sf ? gen_add64_CC : gen_add32_CC);
+}
+
+TRANS(ADDS_i, gen_rri_CC, a, false)
+TRANS(SUBS_i, gen_rri_CC, a, true)
 
 /*
  * Add/subtract (immediate, with tags)
@@ -4769,6 +4834,9 @@ static void disas_add_sub_ext_reg(DisasContext *s, uint32_t insn)
             tcg_gen_add_i64(tcg_result, tcg_rn, tcg_rm);
         }
     } else {
+        translator_cc_set(&s->base,
+                          sub_op ? TRANSLATOR_CC_SUB : TRANSLATOR_CC_ADD,
+                          sf, tcg_rn, tcg_rm);
         if (sub_op) {
             gen_sub_CC(sf, tcg_result, tcg_rn, tcg_rm);
         } else {
@@ -4831,6 +4899,9 @@ static void disas_add_sub_reg(DisasContext *s, uint32_t insn)
             tcg_gen_add_i64(tcg_result, tcg_rn, tcg_rm);
         }
     } else {
+        translator_cc_set(&s->base,
+                          sub_op ? TRANSLATOR_CC_SUB : TRANSLATOR_CC_ADD,
+                          sf, tcg_rn, tcg_rm);
         if (sub_op) {
             gen_sub_CC(sf, tcg_result, tcg_rn, tcg_rm);
         } else {
@@ -5175,7 +5246,7 @@ static void disas_cond_select(DisasContext *s, uint32_t insn)
 
     tcg_rd = cpu_reg(s, rd);
 
-    a64_test_cc(&c, cond);
+    a64_test_cc(s, &c, cond);
     zero = tcg_constant_i64(0);
 
     if (rn == 31 && rm == 31 && (else_inc ^ else_inv)) {
@@ -5998,7 +6069,7 @@ static void disas_fp_csel(DisasContext *s, uint32_t insn)
     read_vec_element(s, t_true, rn, 0, sz);
     read_vec_element(s, t_false, rm, 0, sz);
 
-    a64_test_cc(&c, cond);
+    a64_test_cc(s, &c, cond);
     tcg_gen_movcond_i64(c.cond, t_true, c.value, tcg_constant_i64(0),
                         t_true, t_false);
 
@@ -45,6 +45,18 @@ typedef struct MemCopyInfo {
     TCGType type;
 } MemCopyInfo;
 
+/*
+ * A store to env which has not yet been observed, and may therefore
+ * be removed if it is overwritten by a later store.
+ */
+typedef struct EnvStoreInfo {
+    TCGOp *op;
+    intptr_t start;
+    intptr_t last;
+} EnvStoreInfo;
+
+#define MAX_ENV_STORES  16
+
 typedef struct TempOptInfo {
     bool is_const;
     TCGTemp *prev_copy;
@@ -63,6 +75,13 @@ typedef struct OptContext {
     IntervalTreeRoot mem_copy;
     QSIMPLEQ_HEAD(, MemCopyInfo) mem_free;
 
+    /* Unobserved stores to env, for dead store elimination. */
+    EnvStoreInfo env_st[MAX_ENV_STORES];
+    int nb_env_st;
+
+    /* The last guest memory store, for store to load forwarding. */
+    TCGOp *prev_qemu_st;
+
     /* In flight values from optimization. */
     uint64_t a_mask;  /* mask bit is 0 iff value identical to first input */
     uint64_t z_mask;  /* mask bit is 0 iff value bit is 0 */
@@ -267,6 +286,13 @@ static void reset_ts(OptContext *ctx, TCGTemp *ts)
     ti->z_mask = -1;
     ti->s_mask = 0;
 
+    /* The value or the address of the last guest store is gone. */
+    if (ctx->prev_qemu_st &&
+        (arg_temp(ctx->prev_qemu_st->args[0]) == ts ||
+         arg_temp(ctx->prev_qemu_st->args[1]) == ts)) {
+        ctx->prev_qemu_st = NULL;
+    }
+
     if (!QSIMPLEQ_EMPTY(&ti->mem_copy)) {
         if (ts == nts) {
             /* Last temp copy being removed, the mem copies die. */
@@ -349,6 +375,48 @@ static TCGTemp *find_mem_copy_for(OptContext *ctx, TCGType type, intptr_t s)
     return NULL;
 }
 
+/*
+ * Record a store to env at [start, last], removing any previous
+ * store that it completely overwrites.
+ */
+static void record_env_store(OptContext *ctx, TCGOp *op,
+                             intptr_t start, intptr_t last)
+{
+    int i, n = 0;
+
+    for (i = 0; i < ctx->nb_env_st; i++) {
+        EnvStoreInfo *es = &ctx->env_st[i];
+
+        if (es->start >= start && es->last <= last) {
+            tcg_op_remove(ctx->tcg, es->op);
+        } else {
+            ctx->env_st[n++] = *es;
+        }
+    }
+    if (n < MAX_ENV_STORES) {
+        ctx->env_st[n].op = op;
+        ctx->env_st[n].start = start;
+        ctx->env_st[n].last = last;
+        n++;
+    }
+    ctx->nb_env_st = n;
+}
+
+/* A load from env at [start, last] observes any overlapping stores. */
+static void observe_env_store(OptContext *ctx, intptr_t start, intptr_t last)
+{
+    int i, n = 0;
+
+    for (i = 0; i < ctx->nb_env_st; i++) {
+        EnvStoreInfo *es = &ctx->env_st[i];
+
+        if (es->last < start || es->start > last) {
+            ctx->env_st[n++] = *es;
+        }
+    }
+    ctx->nb_env_st = n;
+}
+
 static TCGArg arg_new_constant(OptContext *ctx, uint64_t val)
 {
     TCGType type = ctx->type;
@@ -978,6 +1046,7 @@ static void finish_folding(OptContext *ctx, TCGOp *op)
         if (!(def->flags & TCG_OPF_COND_BRANCH)) {
             memset(&ctx->temps_used, 0, sizeof(ctx->temps_used));
             remove_mem_copy_all(ctx);
+            ctx->prev_qemu_st = NULL;
         }
         return;
     }
@@ -1528,8 +1597,12 @@ static bool fold_call(OptContext *ctx, TCGOp *op)
     /* If the function has side effects, reset mem data. */
     if (!(flags & TCG_CALL_NO_SIDE_EFFECTS)) {
         remove_mem_copy_all(ctx);
+        ctx->prev_qemu_st = NULL;
     }
 
+    /* Any helper may read env, which makes all pending stores live. */
+    ctx->nb_env_st = 0;
+
     /* Reset temp data for outputs. */
     for (i = 0; i < nb_oargs; i++) {
         reset_temp(ctx, op->args[i]);
@@ -1839,6 +1912,9 @@ static bool fold_mb(OptContext *ctx, TCGOp *op)
     } else {
         ctx->prev_mb = op;
     }
+
+    /* Do not forward a guest store across a barrier. */
+    ctx->prev_qemu_st = NULL;
     return true;
 }
 
@@ -2070,6 +2146,27 @@ static bool fold_qemu_ld(OptContext *ctx, TCGOp *op)
     MemOp mop = get_memop(oi);
     int width = 8 * memop_size(mop);
 
+#ifdef CONFIG_USER_ONLY
+    /*
+     * Forward the value of a store to the same address with the same
+     * size.  With no intervening barrier, the load may observe our own
+     * store without going back to memory.  This is not valid for system
+     * mode, where the address may be MMIO.
+     */
+    if (ctx->prev_qemu_st && def->nb_oargs == 1 && def->nb_iargs == 1) {
+        TCGOp *st = ctx->prev_qemu_st;
+        MemOpIdx st_oi = st->args[2];
+
+        if (ts_are_copies(arg_temp(op->args[1]), arg_temp(st->args[1])) &&
+            get_mmuidx(oi) == get_mmuidx(st_oi) &&
+            (mop & ~MO_SIGN) == (get_memop(st_oi) & ~MO_SIGN) &&
+            memop_size(mop) == tcg_type_size(ctx->type) &&
+            arg_temp(st->args[0])->base_type == ctx->type) {
+            return tcg_opt_gen_mov(ctx, op, op->args[0], st->args[0]);
+        }
+    }
+#endif
+
     if (width < 64) {
         ctx->s_mask = MAKE_64BIT_MASK(width, 64 - width);
         if (!(mop & MO_SIGN)) {
@@ -2085,6 +2182,20 @@ static bool fold_qemu_ld(OptContext *ctx, TCGOp *op)
 
 static bool fold_qemu_st(OptContext *ctx, TCGOp *op)
 {
+    const TCGOpDef *def = &tcg_op_defs[op->opc];
+
+    /*
+     * Remember a store of a single value for forwarding.
+     * The i128 and 32-bit host split forms are not handled.
+     */
+    if (def->nb_oargs == 0 && def->nb_iargs == 2 &&
+        op->opc != INDEX_op_qemu_st_a32_i128 &&
+        op->opc != INDEX_op_qemu_st_a64_i128) {
+        ctx->prev_qemu_st = op;
+    } else {
+        ctx->prev_qemu_st = NULL;
+    }
+
     /* Opcodes that touch guest memory stop the mb optimization.  */
     ctx->prev_mb = NULL;
     return false;
@@ -2457,32 +2568,47 @@ static bool fold_sub2(OptContext *ctx, TCGOp *op)
 
 static bool fold_tcg_ld(OptContext *ctx, TCGOp *op)
 {
+    intptr_t ofs = op->args[2];
+    intptr_t lm1;
+
     /* We can't do any folding with a load, but we can record bits. */
     switch (op->opc) {
     CASE_OP_32_64(ld8s):
         ctx->s_mask = MAKE_64BIT_MASK(8, 56);
+        lm1 = 0;
         break;
     CASE_OP_32_64(ld8u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 8);
         ctx->s_mask = MAKE_64BIT_MASK(9, 55);
+        lm1 = 0;
         break;
     CASE_OP_32_64(ld16s):
         ctx->s_mask = MAKE_64BIT_MASK(16, 48);
+        lm1 = 1;
         break;
     CASE_OP_32_64(ld16u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 16);
         ctx->s_mask = MAKE_64BIT_MASK(17, 47);
+        lm1 = 1;
         break;
     case INDEX_op_ld32s_i64:
         ctx->s_mask = MAKE_64BIT_MASK(32, 32);
+        lm1 = 3;
         break;
     case INDEX_op_ld32u_i64:
         ctx->z_mask = MAKE_64BIT_MASK(0, 32);
         ctx->s_mask = MAKE_64BIT_MASK(33, 31);
+        lm1 = 3;
         break;
     default:
         g_assert_not_reached();
     }
+
+    if (op->args[1] == tcgv_ptr_arg(tcg_env)) {
+        observe_env_store(ctx, ofs, ofs + lm1);
+    } else {
+        ctx->nb_env_st = 0;
+    }
     return false;
 }
 
@@ -2493,6 +2619,7 @@ static bool fold_tcg_ld_memcopy(OptContext *ctx, TCGOp *op)
     TCGType type;
 
     if (op->args[1] != tcgv_ptr_arg(tcg_env)) {
+        ctx->nb_env_st = 0;
         return false;
     }
 
@@ -2504,6 +2631,7 @@ static bool fold_tcg_ld_memcopy(OptContext *ctx, TCGOp *op)
         return tcg_opt_gen_mov(ctx, op, temp_arg(dst), temp_arg(src));
     }
 
+    observe_env_store(ctx, ofs, ofs + tcg_type_size(type) - 1);
     reset_ts(ctx, dst);
     record_mem_copy(ctx, type, dst, ofs, ofs + tcg_type_size(type) - 1);
     return true;
@@ -2540,6 +2668,7 @@ static bool fold_tcg_st(OptContext *ctx, TCGOp *op)
         g_assert_not_reached();
     }
     remove_mem_copy_in(ctx, ofs, ofs + lm1);
+    record_env_store(ctx, op, ofs, ofs + lm1);
     return false;
 }
 
@@ -2573,6 +2702,7 @@ static bool fold_tcg_st_memcopy(OptContext *ctx, TCGOp *op)
     last = ofs + tcg_type_size(type) - 1;
     remove_mem_copy_in(ctx, ofs, last);
     record_mem_copy(ctx, type, src, ofs, last);
+    record_env_store(ctx, op, ofs, last);
     return false;
 }
 
@@ -2640,6 +2770,14 @@ void tcg_optimize(TCGContext *s)
         ctx.z_mask = -1;
         ctx.s_mask = 0;
 
+        /*
+         * Pending env stores are live across the end of a BB, and
+         * across anything that may raise an exception.
+         */
+        if (def->flags & (TCG_OPF_BB_END | TCG_OPF_SIDE_EFFECTS)) {
+            ctx.nb_env_st = 0;
+        }
+
         /*
          * Process each opcode.
          * Sorted alphabetically by opcode as much as possible.
@@ -2691,6 +2829,10 @@ void tcg_optimize(TCGContext *s)
         case INDEX_op_dup2_vec:
             done = fold_dup2(&ctx, op);
             break;
+        case INDEX_op_dupm_vec:
+            /* Reads memory through an arbitrary base. */
+            ctx.nb_env_st = 0;
+            break;
         CASE_OP_32_64_VEC(eqv):
             done = fold_eqv(&ctx, op);
             break;
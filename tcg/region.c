@@ -29,11 +29,19 @@
 #include "qemu/memalign.h"
 #include "qemu/cacheinfo.h"
 #include "qemu/qtree.h"
+#include "qemu/bitmap.h"
+#include "qemu/error-report.h"
 #include "qapi/error.h"
 #include "tcg/tcg.h"
 #include "exec/translation-block.h"
 #include "tcg-internal.h"
 #include "host/cpuinfo.h"
+#if defined(CONFIG_NUMA) && !defined(CONFIG_USER_ONLY)
+#include <sched.h>
+#include <numa.h>
+#include <numaif.h>
+#define TCG_REGION_NUMA
+#endif
 
 
 /*
@@ -68,10 +76,41 @@ struct tcg_region_state {
     size_t size; /* size of one region */
     size_t stride; /* .size + guard size */
     size_t total_size; /* size of entire buffer, >= n * stride */
+    bool hugetlb; /* buffer is allocated from the hugetlbfs pool */
+
+    /*
+     * Regions are split into contiguous groups, one per host NUMA node;
+     * without NUMA placement there is a single group.  Group i covers
+     * regions [node_first[i], node_first[i + 1]).
+     */
+    size_t n_nodes;
+    size_t *node_first;
+    /*
+     * With NUMA placement, the pages of group i prefer host node
+     * group_node[i], and threads on host node n allocate from group
+     * node_group[n].  Host node ids need not be contiguous, and there
+     * may be more nodes than groups, in which case some share a group.
+     */
+    int *group_node;
+    int *node_group;
+    int n_host_nodes; /* size of node_group */
 
     /* fields protected by the lock */
-    size_t current; /* current region index */
+    size_t current; /* number of regions in use */
+    size_t *node_next; /* next free region in each group */
     size_t agg_size_full; /* aggregate size of full regions */
+
+    /*
+     * Full regions in the order in which they filled up, as a ring
+     * of region.n entries; the oldest is evicted first.
+     */
+    size_t *full;
+    size_t full_head;
+    size_t n_full;
+
+    /* Regions which have been evicted and not yet reused. */
+    size_t *evicted;
+    size_t n_evicted;
 };
 
 static struct tcg_region_state region;
@@ -191,10 +230,23 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+/* Return the index of the region containing @p, within the rw buffer. */
+static size_t tcg_region_index(const void *p)
 {
-    size_t region_idx;
+    ptrdiff_t offset;
 
+    if (p < region.start_aligned) {
+        return 0;
+    }
+    offset = p - region.start_aligned;
+    if (offset > region.stride * (region.n - 1)) {
+        return region.n - 1;
+    }
+    return offset / region.stride;
+}
+
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
      * a signal handler over which the caller has no control.
@@ -206,18 +258,7 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
         }
     }
 
-    if (p < region.start_aligned) {
-        region_idx = 0;
-    } else {
-        ptrdiff_t offset = p - region.start_aligned;
-
-        if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
-        }
-    }
-    return region_trees + region_idx * tree_size;
+    return region_trees + tcg_region_index(p) * tree_size;
 }
 
 void tcg_tb_insert(TranslationBlock *tb)
@@ -311,6 +352,13 @@ size_t tcg_nb_tbs(void)
     return nb_tbs;
 }
 
+static gboolean tcg_region_collect_tb(gpointer key, gpointer value,
+                                      gpointer data)
+{
+    g_ptr_array_add(data, value);
+    return false;
+}
+
 static void tcg_region_tree_reset_all(void)
 {
     size_t i;
@@ -357,12 +405,44 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
     s->code_gen_highwater = end - TCG_HIGHWATER;
 }
 
+/* Return the next free region, preferably from the group of @node. */
+static size_t tcg_region_next__locked(int node)
+{
+    if (region.n_evicted) {
+        size_t *ev = region.evicted;
+        size_t i, r;
+
+        /* Reuse an evicted region, if possible from the same group. */
+        for (i = 0; i < region.n_evicted; i++) {
+            if (ev[i] >= region.node_first[node] &&
+                ev[i] < region.node_first[node + 1]) {
+                break;
+            }
+        }
+        if (i == region.n_evicted) {
+            i = 0;
+        }
+        r = ev[i];
+        ev[i] = ev[--region.n_evicted];
+        return r;
+    }
+
+    for (size_t i = 0; i < region.n_nodes; i++) {
+        size_t g = (node + i) % region.n_nodes;
+
+        if (region.node_next[g] < region.node_first[g + 1]) {
+            return region.node_next[g]++;
+        }
+    }
+    g_assert_not_reached();
+}
+
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
     if (region.current == region.n) {
         return true;
     }
-    tcg_region_assign(s, region.current);
+    tcg_region_assign(s, tcg_region_next__locked(s->code_gen_node));
     region.current++;
     return false;
 }
@@ -376,16 +456,76 @@ bool tcg_region_alloc(TCGContext *s)
     bool err;
     /* read the region size now; alloc__locked will overwrite it on success */
     size_t size_full = s->code_gen_buffer_size;
+    size_t idx_full = tcg_region_index(s->code_gen_buffer);
 
     qemu_mutex_lock(&region.lock);
     err = tcg_region_alloc__locked(s);
     if (!err) {
         region.agg_size_full += size_full - TCG_HIGHWATER;
+        region.full[(region.full_head + region.n_full) % region.n] = idx_full;
+        region.n_full++;
     }
     qemu_mutex_unlock(&region.lock);
     return err;
 }
 
+/*
+ * Evict the region that filled up first, which approximates the least
+ * recently used one.  @invalidate is called for each TB in the region,
+ * and must unlink it from everything that might still reference it.
+ * Afterward the region is available to tcg_region_alloc().
+ * Returns false if no region is full, in which case the caller must
+ * fall back to tcg_region_reset_all().
+ *
+ * Call from a safe-work context.
+ */
+bool tcg_region_evict(void (*invalidate)(TranslationBlock *tb))
+{
+    struct tcg_region_tree *rt;
+    g_autoptr(GPtrArray) tbs = NULL;
+    void *start, *end;
+    size_t i;
+
+    qemu_mutex_lock(&region.lock);
+    if (region.n_full == 0) {
+        qemu_mutex_unlock(&region.lock);
+        return false;
+    }
+    i = region.full[region.full_head];
+    region.full_head = (region.full_head + 1) % region.n;
+    region.n_full--;
+    qemu_mutex_unlock(&region.lock);
+
+    /*
+     * Collect the TBs first: @invalidate takes page locks, which must
+     * not nest within the tree lock.
+     */
+    rt = region_trees + i * tree_size;
+    tbs = g_ptr_array_new();
+    qemu_mutex_lock(&rt->lock);
+    q_tree_foreach(rt->tree, tcg_region_collect_tb, tbs);
+    qemu_mutex_unlock(&rt->lock);
+
+    for (guint j = 0; j < tbs->len; j++) {
+        invalidate(g_ptr_array_index(tbs, j));
+    }
+
+    qemu_mutex_lock(&rt->lock);
+    /* Increment the refcount first so that destroy acts as a reset */
+    q_tree_ref(rt->tree);
+    q_tree_destroy(rt->tree);
+    qemu_mutex_unlock(&rt->lock);
+
+    tcg_region_bounds(i, &start, &end);
+
+    qemu_mutex_lock(&region.lock);
+    region.evicted[region.n_evicted++] = i;
+    region.current--;
+    region.agg_size_full -= (end - start) - TCG_HIGHWATER;
+    qemu_mutex_unlock(&region.lock);
+    return true;
+}
+
 /*
  * Perform a context's first region allocation.
  * This function does _not_ increment region.agg_size_full.
@@ -396,8 +536,30 @@ static void tcg_region_initial_alloc__locked(TCGContext *s)
     g_assert(!err);
 }
 
+/* Return the region group for the host NUMA node of the calling thread. */
+static int tcg_region_local_node(void)
+{
+#ifdef TCG_REGION_NUMA
+    if (region.n_nodes > 1) {
+        int cpu = sched_getcpu();
+        int node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+
+        if (node >= 0 && node < region.n_host_nodes) {
+            return region.node_group[node];
+        }
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Called from the thread that will use @s, whose current host node
+ * is remembered for all later allocations.
+ */
 void tcg_region_initial_alloc(TCGContext *s)
 {
+    s->code_gen_node = tcg_region_local_node();
+
     qemu_mutex_lock(&region.lock);
     tcg_region_initial_alloc__locked(s);
     qemu_mutex_unlock(&region.lock);
@@ -412,6 +574,12 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    region.full_head = 0;
+    region.n_full = 0;
+    region.n_evicted = 0;
+    for (i = 0; i < region.n_nodes; i++) {
+        region.node_next[i] = region.node_first[i];
+    }
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -499,7 +667,8 @@ static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
 static uint8_t static_code_gen_buffer[DEFAULT_CODE_GEN_BUFFER_SIZE]
     __attribute__((aligned(CODE_GEN_ALIGN)));
 
-static int alloc_code_gen_buffer(size_t tb_size, int splitwx, Error **errp)
+static int alloc_code_gen_buffer(size_t tb_size, int splitwx,
+                                 TCGHugePages hugepages, Error **errp)
 {
     void *buf, *end;
     size_t size;
@@ -528,7 +697,8 @@ static int alloc_code_gen_buffer(size_t tb_size, int splitwx, Error **errp)
     return PROT_READ | PROT_WRITE;
 }
 #elif defined(_WIN32)
-static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
+static int alloc_code_gen_buffer(size_t size, int splitwx,
+                                 TCGHugePages hugepages, Error **errp)
 {
     void *buf;
 
@@ -666,6 +836,72 @@ static int alloc_code_gen_buffer_splitwx_vmremap(size_t size, Error **errp)
     return PROT_READ | PROT_WRITE;
 }
 #endif /* CONFIG_DARWIN */
+
+#ifdef CONFIG_LINUX
+#include "qemu/mmap-alloc.h"
+
+/*
+ * Allocate from the hugetlbfs pool, via memfd so that the same pages
+ * may also be mapped a second time for splitwx.  The size is rounded
+ * up to a multiple of the huge page size.
+ */
+static int alloc_code_gen_buffer_hugetlb(size_t size, int splitwx,
+                                         Error **errp)
+{
+    void *buf_rw = MAP_FAILED, *buf_rx = MAP_FAILED;
+    size_t hpagesize;
+    int fd, prot;
+
+    fd = qemu_memfd_create("tcg-jit", 0, true, 0, 0, errp);
+    if (fd < 0) {
+        return -1;
+    }
+
+    hpagesize = qemu_fd_getpagesize(fd);
+    size = ROUND_UP(size, hpagesize);
+    if (ftruncate(fd, size) < 0) {
+        error_setg_errno(errp, errno,
+                         "failed to resize huge page jit buffer to %zu", size);
+        goto fail;
+    }
+
+    if (splitwx) {
+        prot = PROT_READ | PROT_WRITE;
+    } else {
+        prot = PROT_READ | PROT_WRITE | host_prot_read_exec();
+    }
+    buf_rw = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if (buf_rw == MAP_FAILED) {
+        error_setg_errno(errp, errno,
+                         "allocate %zu bytes of huge pages for jit buffer",
+                         size);
+        goto fail;
+    }
+
+    if (splitwx) {
+        buf_rx = mmap(NULL, size, host_prot_read_exec(), MAP_SHARED, fd, 0);
+        if (buf_rx == MAP_FAILED) {
+            error_setg_errno(errp, errno,
+                             "failed to map shared memory for execute");
+            goto fail;
+        }
+        tcg_splitwx_diff = buf_rx - buf_rw;
+    }
+
+    close(fd);
+    region.start_aligned = buf_rw;
+    region.total_size = size;
+    region.hugetlb = true;
+    return prot;
+
+ fail:
+    if (buf_rw != MAP_FAILED) {
+        munmap(buf_rw, size);
+    }
+    close(fd);
+    return -1;
+}
+#endif /* CONFIG_LINUX */
 #endif /* CONFIG_TCG_INTERPRETER */
 
 static int alloc_code_gen_buffer_splitwx(size_t size, Error **errp)
@@ -682,11 +918,24 @@ static int alloc_code_gen_buffer_splitwx(size_t size, Error **errp)
     return -1;
 }
 
-static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
+static int alloc_code_gen_buffer(size_t size, int splitwx,
+                                 TCGHugePages hugepages, Error **errp)
 {
     ERRP_GUARD();
     int prot, flags;
 
+#if defined(CONFIG_LINUX) && !defined(CONFIG_TCG_INTERPRETER)
+    if (hugepages == TCG_HUGEPAGES_EXPLICIT) {
+        prot = alloc_code_gen_buffer_hugetlb(size, splitwx, errp);
+        if (prot >= 0) {
+            return prot;
+        }
+        warn_report_err(*errp);
+        *errp = NULL;
+        warn_report("jit buffer falling back to normal pages");
+    }
+#endif
+
     if (splitwx) {
         prot = alloc_code_gen_buffer_splitwx(size, errp);
         if (prot >= 0) {
@@ -721,6 +970,83 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
 }
 #endif /* USE_STATIC_CODE_GEN_BUFFER, WIN32, POSIX */
 
+/*
+ * Split the regions into one group per host NUMA node, and prefer that
+ * node for the pages of each group.  This is only a preference: the
+ * kernel may still allocate elsewhere under memory pressure.
+ */
+static void tcg_region_numa_init(bool numa)
+{
+    size_t n_nodes = 1;
+
+#ifdef TCG_REGION_NUMA
+    if (numa) {
+        if (numa_available() < 0) {
+            warn_report("host NUMA information unavailable for jit buffer");
+        } else {
+            int max_node = numa_max_node();
+            size_t n_allowed = 0;
+
+            /* Give a group to each node we may allocate from, in order */
+            region.n_host_nodes = max_node + 1;
+            region.node_group = g_new(int, region.n_host_nodes);
+            region.group_node = g_new(int, MIN(region.n_host_nodes,
+                                               region.n));
+            for (int node = 0; node <= max_node; node++) {
+                if (!numa_bitmask_isbitset(numa_all_nodes_ptr, node)) {
+                    region.node_group[node] = 0;
+                    continue;
+                }
+                if (n_allowed < region.n) {
+                    region.group_node[n_allowed] = node;
+                }
+                region.node_group[node] = n_allowed % region.n;
+                n_allowed++;
+            }
+            n_nodes = MAX(MIN(n_allowed, region.n), 1);
+        }
+    }
+#endif
+
+    region.n_nodes = n_nodes;
+    region.node_first = g_new(size_t, n_nodes + 1);
+    region.node_next = g_new(size_t, n_nodes);
+    for (size_t i = 0; i <= n_nodes; i++) {
+        region.node_first[i] = i * region.n / n_nodes;
+    }
+    for (size_t i = 0; i < n_nodes; i++) {
+        region.node_next[i] = region.node_first[i];
+    }
+
+#ifdef TCG_REGION_NUMA
+    for (size_t i = 0; n_nodes > 1 && i < n_nodes; i++) {
+        int node = region.group_node[i];
+        g_autofree unsigned long *nodemask =
+            bitmap_new(region.n_host_nodes + 1);
+        void *start = region.start_aligned +
+                      region.node_first[i] * region.stride;
+        void *end = region.start_aligned +
+                    region.node_first[i + 1] * region.stride;
+
+        if (i == n_nodes - 1) {
+            end = region.start_aligned + region.total_size;
+        }
+
+        /*
+         * For splitwx the policy applies to the shared memory object,
+         * and so to the rx mapping as well.
+         */
+        set_bit(node, nodemask);
+        if (mbind(start, end - start, MPOL_PREFERRED,
+                  nodemask, region.n_host_nodes + 1, 0)) {
+            warn_report("failed to bind jit buffer to host NUMA node %d: %s",
+                        node, strerror(errno));
+            break;
+        }
+    }
+#endif
+}
+
 /*
  * Initializes region partitioning.
  *
@@ -749,7 +1075,8 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
  * in practice. Multi-threaded guests share most if not all of their translated
  * code, which makes parallel code generation less appealing than in system-mode
  */
-void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
+void tcg_region_init(size_t tb_size, int splitwx, TCGHugePages hugepages,
+                     bool numa, unsigned max_cpus)
 {
     const size_t page_size = qemu_real_host_page_size();
     size_t region_size;
@@ -772,14 +1099,18 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
         tb_size = MAX_CODE_GEN_BUFFER_SIZE;
     }
 
-    have_prot = alloc_code_gen_buffer(tb_size, splitwx, &error_fatal);
+    have_prot = alloc_code_gen_buffer(tb_size, splitwx, hugepages,
+                                      &error_fatal);
     assert(have_prot >= 0);
 
     /* Request large pages for the buffer and the splitwx.  */
-    qemu_madvise(region.start_aligned, region.total_size, QEMU_MADV_HUGEPAGE);
-    if (tcg_splitwx_diff) {
-        qemu_madvise(region.start_aligned + tcg_splitwx_diff,
-                     region.total_size, QEMU_MADV_HUGEPAGE);
+    if (hugepages != TCG_HUGEPAGES_OFF && !region.hugetlb) {
+        qemu_madvise(region.start_aligned, region.total_size,
+                     QEMU_MADV_HUGEPAGE);
+        if (tcg_splitwx_diff) {
+            qemu_madvise(region.start_aligned + tcg_splitwx_diff,
+                         region.total_size, QEMU_MADV_HUGEPAGE);
+        }
     }
 
     /*
@@ -844,13 +1175,20 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
                                  "mprotect of jit buffer");
             }
         }
-        if (have_prot != 0) {
-            /* Guard pages are nice for bug detection but are not essential. */
+        /*
+         * Guard pages are nice for bug detection but are not essential.
+         * They cannot be set within a hugetlbfs page.
+         */
+        if (have_prot != 0 && !region.hugetlb) {
             (void)qemu_mprotect_none(end, page_size);
         }
     }
 
+    region.full = g_new(size_t, region.n);
+    region.evicted = g_new(size_t, region.n);
+
     tcg_region_trees_init();
+    tcg_region_numa_init(numa);
 
     /*
      * Leave the initial context initialized to the first region.
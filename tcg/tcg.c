@@ -1384,10 +1384,11 @@ static void tcg_context_init(unsigned max_cpus)
     tcg_env = temp_tcgv_ptr(ts);
 }
 
-void tcg_init(size_t tb_size, int splitwx, unsigned max_cpus)
+void tcg_init(size_t tb_size, int splitwx, TCGHugePages hugepages,
+              bool numa, unsigned max_cpus)
 {
     tcg_context_init(max_cpus);
-    tcg_region_init(tb_size, splitwx, max_cpus);
+    tcg_region_init(tb_size, splitwx, hugepages, numa, max_cpus);
 }
 
 /*
@@ -0,0 +1,110 @@
+/*
+ * QEMU host vector gvec operations speed benchmark
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "qemu/gvec-accel.h"
+
+/* The maximum vector size of the generic vector expanders. */
+#define MAX_OPRSZ   256
+
+static uint64_t buf_d[MAX_OPRSZ / 8], buf_a[MAX_OPRSZ / 8];
+static uint64_t buf_b[MAX_OPRSZ / 8], buf_c[MAX_OPRSZ / 8];
+
+typedef struct BenchOp {
+    const char *name;
+    void (*run)(const GVecAccel *g, intptr_t oprsz);
+} BenchOp;
+
+static void run_ssadd8(const GVecAccel *g, intptr_t oprsz)
+{
+    g->ssadd[0](buf_d, buf_a, buf_b, oprsz);
+}
+
+static void run_ussub16(const GVecAccel *g, intptr_t oprsz)
+{
+    g->ussub[1](buf_d, buf_a, buf_b, oprsz);
+}
+
+static void run_sari32(const GVecAccel *g, intptr_t oprsz)
+{
+    g->sari[2](buf_d, buf_a, 7, oprsz);
+}
+
+static void run_shli64(const GVecAccel *g, intptr_t oprsz)
+{
+    g->shli[3](buf_d, buf_a, 13, oprsz);
+}
+
+static void run_lt8(const GVecAccel *g, intptr_t oprsz)
+{
+    g->lt[0](buf_d, buf_a, buf_b, oprsz);
+}
+
+static void run_ltu64(const GVecAccel *g, intptr_t oprsz)
+{
+    g->ltu[3](buf_d, buf_a, buf_b, oprsz);
+}
+
+static void run_bitsel(const GVecAccel *g, intptr_t oprsz)
+{
+    g->bitsel(buf_d, buf_a, buf_b, buf_c, oprsz);
+}
+
+static void run_dup(const GVecAccel *g, intptr_t oprsz)
+{
+    g->dup(buf_d, 0x0123456789abcdefull, oprsz);
+}
+
+static const BenchOp bench_ops[] = {
+    { "ssadd8", run_ssadd8 },
+    { "ussub16", run_ussub16 },
+    { "sari32", run_sari32 },
+    { "shli64", run_shli64 },
+    { "lt8", run_lt8 },
+    { "ltu64", run_ltu64 },
+    { "bitsel", run_bitsel },
+    { "dup", run_dup },
+};
+
+static void test(void)
+{
+    for (int i = 0; i < MAX_OPRSZ / 8; i++) {
+        buf_a[i] = g_test_rand_int() * 0x100000001ull;
+        buf_b[i] = g_test_rand_int() * 0x100000001ull;
+        buf_c[i] = g_test_rand_int() * 0x100000001ull;
+    }
+
+    do {
+        for (int i = 0; i < ARRAY_SIZE(bench_ops); i++) {
+            const BenchOp *op = &bench_ops[i];
+
+            for (intptr_t oprsz = 16; oprsz <= MAX_OPRSZ; oprsz *= 4) {
+                double total = 0.0;
+
+                g_test_timer_start();
+                do {
+                    for (int j = 0; j < 1000; j++) {
+                        op->run(gvec_accel, oprsz);
+                    }
+                    total += 1000.0 * oprsz;
+                } while (g_test_timer_elapsed() < 0.2);
+
+                g_test_message("%-8s %-8s %3dB %8.0f MB/sec",
+                               gvec_accel->name, op->name, (int)oprsz,
+                               total / MiB / g_test_timer_last());
+            }
+        }
+    } while (test_gvec_accel_next());
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/gvec/speed", test);
+    return g_test_run();
+}
@@ -64,6 +64,8 @@ static bool precompute_hash;
 
 static double update_rate; /* 0.0 to 1.0 */
 static uint64_t update_threshold;
+static double insert_rate = -1.0; /* 0.0 to 1.0; < 0 to alternate */
+static uint64_t insert_threshold;
 static uint64_t resize_threshold;
 
 static size_t qht_n_elems = DEFAULT_QHT_N_ELEMS;
@@ -89,8 +91,10 @@ static const char commands_string[] =
     " -r = update range of keys (will be rounded up to pow2)\n"
     "\n"
     " -u = update rate (0.0 to 100.0), 50/50 split of insertions/removals\n"
+    " -i = share of insertions among updates (0.0 to 100.0)\n"
     "\n"
     " -R = enable auto-resize\n"
+    " -I = enable incremental auto-resize (implies -R)\n"
     " -S = resize rate (0.0 to 100.0)\n"
     " -D = delay (in us) between potential resizes\n"
     " -N = number of resize threads";
@@ -175,9 +179,14 @@ static void do_rw(struct thread_info *info)
             stats->not_rd++;
         }
     } else {
+        bool insert = info->write_op;
+
+        if (insert_rate >= 0) {
+            insert = xorshift64star(r) < insert_threshold;
+        }
         p = &keys[r & (update_range - 1)];
         hash = hfunc(*p);
-        if (info->write_op) {
+        if (insert) {
             bool written = false;
 
             if (qht_lookup(&ht, p, hash) == NULL) {
@@ -275,6 +284,7 @@ static void pr_params(void)
     printf(" initial # of keys: %zu\n", init_size);
     printf(" initial size hint: %zu\n", qht_n_elems);
     printf(" auto-resize:       %s\n",
+           qht_mode & QHT_MODE_INCREMENTAL_RESIZE ? "incremental" :
            qht_mode & QHT_MODE_AUTO_RESIZE ? "on" : "off");
     if (resize_rate) {
         printf(" resize_rate:       %f%%\n", resize_rate * 100.0);
@@ -282,6 +292,9 @@ static void pr_params(void)
         printf(" # resize threads   %u\n", n_rz_threads);
     }
     printf(" update rate:       %f%%\n", update_rate * 100.0);
+    if (insert_rate >= 0) {
+        printf(" insertion share:   %f%%\n", insert_rate * 100.0);
+    }
     printf(" offset:            %ld\n", populate_offset);
     printf(" initial key range: %zu\n", init_range);
     printf(" lookup range:      %lu\n", lookup_range);
@@ -333,6 +346,9 @@ static void htable_init(void)
     /* compute thresholds */
     do_threshold(update_rate, &update_threshold);
     do_threshold(resize_rate, &resize_threshold);
+    if (insert_rate >= 0) {
+        do_threshold(insert_rate, &insert_threshold);
+    }
 
     if (resize_rate) {
         resize_min = n / 2;
@@ -445,7 +461,7 @@ static void parse_args(int argc, char *argv[])
     int c;
 
     for (;;) {
-        c = getopt(argc, argv, "d:D:g:k:K:l:hn:N:o:pr:Rs:S:u:");
+        c = getopt(argc, argv, "d:D:g:i:Ik:K:l:hn:N:o:pr:Rs:S:u:");
         if (c < 0) {
             break;
         }
@@ -466,6 +482,15 @@ static void parse_args(int argc, char *argv[])
         case 'h':
             usage_complete(argc, argv);
             exit(0);
+        case 'i':
+            insert_rate = atof(optarg) / 100.0;
+            if (insert_rate > 1.0) {
+                insert_rate = 1.0;
+            }
+            break;
+        case 'I':
+            qht_mode |= QHT_MODE_AUTO_RESIZE | QHT_MODE_INCREMENTAL_RESIZE;
+            break;
         case 'k':
             init_size = atol(optarg);
             break;
@@ -0,0 +1,155 @@
+/*
+ * QEMU softfloat speed benchmark
+ *
+ * Measure the throughput of common operations with the inexact flag
+ * already set, which allows the host FPU fast paths, and with the flags
+ * cleared before each operation, which leaves only the fast paths that
+ * do not depend on the host FPU.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#ifndef HW_POISON_H
+#error Must define HW_POISON_H to work around TARGET_* poisoning
+#endif
+
+#include "qemu/osdep.h"
+#include "fpu/softfloat.h"
+
+#define N_INPUTS    1024
+
+static uint64_t in_a[N_INPUTS], in_b[N_INPUTS];
+static volatile uint64_t sink;
+
+typedef struct BenchOp {
+    const char *name;
+    uint64_t (*run)(uint64_t a, uint64_t b, float_status *s);
+} BenchOp;
+
+#define OP2(NAME, T)                                                    \
+static uint64_t run_##NAME(uint64_t a, uint64_t b, float_status *s)     \
+{                                                                       \
+    return T##_val(NAME(make_##T(a), make_##T(b), s));                  \
+}
+
+#define OP1(NAME, T, RT)                                                \
+static uint64_t run_##NAME(uint64_t a, uint64_t b, float_status *s)     \
+{                                                                       \
+    return RT(NAME(make_##T(a), s));                                    \
+}
+
+#define bfloat16_val(x)     (x)
+#define make_bfloat16(x)    ((bfloat16)(x))
+
+OP2(float16_add, float16)
+OP2(float16_mul, float16)
+OP2(float16_div, float16)
+OP2(bfloat16_add, bfloat16)
+OP2(bfloat16_mul, bfloat16)
+OP2(float16_maxnum, float16)
+OP2(float32_minnum, float32)
+OP2(float64_max, float64)
+OP1(float32_round_to_int, float32, float32_val)
+OP1(float64_round_to_int, float64, float64_val)
+OP1(float32_to_int32, float32, (int32_t))
+OP1(float64_to_int64_round_to_zero, float64, (int64_t))
+OP1(float64_to_float32, float64, float32_val)
+OP1(float32_to_bfloat16, float32, bfloat16_val)
+
+static uint64_t run_float16_compare(uint64_t a, uint64_t b, float_status *s)
+{
+    return float16_compare(make_float16(a), make_float16(b), s);
+}
+
+static uint64_t run_int64_to_float64(uint64_t a, uint64_t b, float_status *s)
+{
+    return float64_val(int64_to_float64(a >> 40, s));
+}
+
+/* The format of the random inputs of each operation. */
+typedef enum {
+    IN_F16, IN_BF16, IN_F32, IN_F64,
+} InputFmt;
+
+static const struct {
+    BenchOp op;
+    InputFmt fmt;
+} bench_ops[] = {
+    { { "f16_add", run_float16_add }, IN_F16 },
+    { { "f16_mul", run_float16_mul }, IN_F16 },
+    { { "f16_div", run_float16_div }, IN_F16 },
+    { { "bf16_add", run_bfloat16_add }, IN_BF16 },
+    { { "bf16_mul", run_bfloat16_mul }, IN_BF16 },
+    { { "f16_maxnum", run_float16_maxnum }, IN_F16 },
+    { { "f16_cmp", run_float16_compare }, IN_F16 },
+    { { "f32_minnum", run_float32_minnum }, IN_F32 },
+    { { "f64_max", run_float64_max }, IN_F64 },
+    { { "f32_rint", run_float32_round_to_int }, IN_F32 },
+    { { "f64_rint", run_float64_round_to_int }, IN_F64 },
+    { { "f32_to_i32", run_float32_to_int32 }, IN_F32 },
+    { { "f64_to_i64_rz", run_float64_to_int64_round_to_zero }, IN_F64 },
+    { { "f64_to_f32", run_float64_to_float32 }, IN_F64 },
+    { { "f32_to_bf16", run_float32_to_bfloat16 }, IN_F32 },
+    { { "i64_to_f64", run_int64_to_float64 }, IN_F64 },
+};
+
+/* A normal number of magnitude around 1, with a random sign. */
+static uint64_t random_normal(InputFmt fmt)
+{
+    uint64_t r = ((uint64_t)g_test_rand_int() << 32) | g_test_rand_int();
+
+    switch (fmt) {
+    case IN_F16:
+        return (r & 0x83ff) | ((12 + r % 6) << 10);
+    case IN_BF16:
+        return (r & 0x807f) | ((124 + r % 6) << 7);
+    case IN_F32:
+        return (r & 0x807fffff) | ((124 + r % 6) << 23);
+    case IN_F64:
+        return (r & 0x800fffffffffffffull) | ((1020 + r % 6) << 52);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static void test(void)
+{
+    for (int i = 0; i < ARRAY_SIZE(bench_ops); i++) {
+        const BenchOp *op = &bench_ops[i].op;
+
+        for (int j = 0; j < N_INPUTS; j++) {
+            in_a[j] = random_normal(bench_ops[i].fmt);
+            in_b[j] = random_normal(bench_ops[i].fmt);
+        }
+
+        for (int hard = 1; hard >= 0; hard--) {
+            float_status s = {
+                .float_rounding_mode = float_round_nearest_even,
+            };
+            double total = 0.0;
+            uint64_t acc = 0;
+
+            g_test_timer_start();
+            do {
+                for (int j = 0; j < N_INPUTS; j++) {
+                    s.float_exception_flags = hard ? float_flag_inexact : 0;
+                    acc += op->run(in_a[j], in_b[j], &s);
+                }
+                total += N_INPUTS;
+            } while (g_test_timer_elapsed() < 0.2);
+            sink = acc;
+
+            g_test_message("%-14s %-4s %8.2f Mops/sec", op->name,
+                           hard ? "hard" : "soft",
+                           total / 1e6 / g_test_timer_last());
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/softfloat/speed", test);
+    return g_test_run();
+}
@@ -20,6 +20,7 @@ typedef struct {
     uint64_t count_insn_inline;
     uint64_t count_mem;
     uint64_t count_mem_inline;
+    uint64_t count_mem_record;
 } CPUCount;
 
 static struct qemu_plugin_scoreboard *counts;
@@ -29,6 +30,9 @@ static qemu_plugin_u64 count_insn;
 static qemu_plugin_u64 count_insn_inline;
 static qemu_plugin_u64 count_mem;
 static qemu_plugin_u64 count_mem_inline;
+static qemu_plugin_u64 count_mem_record;
+static struct qemu_plugin_mem_buffer *mem_records;
+static char mem_record_udata;
 
 static uint64_t global_count_tb;
 static uint64_t global_count_insn;
@@ -74,12 +78,16 @@ static void stats_mem(void)
     const uint64_t per_vcpu = qemu_plugin_u64_sum(count_mem);
     const uint64_t inl_per_vcpu =
         qemu_plugin_u64_sum(count_mem_inline);
+    const uint64_t rec_per_vcpu =
+        qemu_plugin_u64_sum(count_mem_record);
     printf("mem: %" PRIu64 "\n", expected);
     printf("mem: %" PRIu64 " (per vcpu)\n", per_vcpu);
     printf("mem: %" PRIu64 " (per vcpu inline)\n", inl_per_vcpu);
+    printf("mem: %" PRIu64 " (per vcpu record)\n", rec_per_vcpu);
     g_assert(expected > 0);
     g_assert(per_vcpu == expected);
     g_assert(inl_per_vcpu == expected);
+    g_assert(rec_per_vcpu == expected);
 }
 
 static void plugin_exit(qemu_plugin_id_t id, void *udata)
@@ -87,6 +95,10 @@ static void plugin_exit(qemu_plugin_id_t id, void *udata)
     const unsigned int num_cpus = qemu_plugin_num_vcpus();
     g_assert(num_cpus == max_cpu_index + 1);
 
+    for (int i = 0; i < num_cpus ; ++i) {
+        qemu_plugin_mem_buffer_flush(mem_records, i);
+    }
+
     for (int i = 0; i < num_cpus ; ++i) {
         const uint64_t tb = qemu_plugin_u64_get(count_tb, i);
         const uint64_t tb_inline = qemu_plugin_u64_get(count_tb_inline, i);
@@ -94,20 +106,24 @@ static void plugin_exit(qemu_plugin_id_t id, void *udata)
         const uint64_t insn_inline = qemu_plugin_u64_get(count_insn_inline, i);
         const uint64_t mem = qemu_plugin_u64_get(count_mem, i);
         const uint64_t mem_inline = qemu_plugin_u64_get(count_mem_inline, i);
+        const uint64_t mem_record = qemu_plugin_u64_get(count_mem_record, i);
         printf("cpu %d: tb (%" PRIu64 ", %" PRIu64 ") | "
                "insn (%" PRIu64 ", %" PRIu64 ") | "
-               "mem (%" PRIu64 ", %" PRIu64 ")"
+               "mem (%" PRIu64 ", %" PRIu64 ", %" PRIu64 ")"
                "\n",
-               i, tb, tb_inline, insn, insn_inline, mem, mem_inline);
+               i, tb, tb_inline, insn, insn_inline,
+               mem, mem_inline, mem_record);
         g_assert(tb == tb_inline);
         g_assert(insn == insn_inline);
         g_assert(mem == mem_inline);
+        g_assert(mem == mem_record);
     }
 
     stats_tb();
     stats_insn();
     stats_mem();
 
+    qemu_plugin_mem_buffer_free(mem_records);
     qemu_plugin_scoreboard_free(counts);
 }
 
@@ -139,6 +155,16 @@ static void vcpu_mem_access(unsigned int cpu_index,
     g_mutex_unlock(&mem_lock);
 }
 
+static void vcpu_mem_records(unsigned int cpu_index,
+                             const struct qemu_plugin_mem_record *records,
+                             size_t n, void *udata)
+{
+    for (size_t i = 0; i < n; i++) {
+        g_assert(records[i].userdata == &mem_record_udata);
+    }
+    qemu_plugin_u64_add(count_mem_record, cpu_index, n);
+}
+
 static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
 {
     qemu_plugin_register_vcpu_tb_exec_cb(
@@ -159,6 +185,8 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
             insn, QEMU_PLUGIN_MEM_RW,
             QEMU_PLUGIN_INLINE_ADD_U64,
             count_mem_inline, 1);
+        qemu_plugin_register_vcpu_mem_record(insn, QEMU_PLUGIN_MEM_RW,
+                                             mem_records, &mem_record_udata);
     }
 }
 
@@ -179,6 +207,10 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
         counts, CPUCount, count_insn_inline);
     count_mem_inline = qemu_plugin_scoreboard_u64_in_struct(
         counts, CPUCount, count_mem_inline);
+    count_mem_record = qemu_plugin_scoreboard_u64_in_struct(
+        counts, CPUCount, count_mem_record);
+    /* small, so that records are delivered often */
+    mem_records = qemu_plugin_mem_buffer_new(256, vcpu_mem_records, NULL);
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
 
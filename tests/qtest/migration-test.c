@@ -2706,6 +2706,117 @@ static void test_migrate_auto_converge(void)
     test_migrate_end(from, to, true);
 }
 
+/*
+ * Without predictive-switchover, auto-converge must keep throttling step
+ * by step: first cpu-throttle-initial, then cpu-throttle-increment more.
+ */
+static void test_migrate_auto_converge_step(void)
+{
+    g_autofree char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
+    MigrateStart args = {};
+    QTestState *from, *to;
+    int64_t percentage;
+    QDict *rsp_return;
+
+    const int64_t init_pct = 5, inc_pct = 25, max_pct = 95;
+
+    if (test_migrate_start(&from, &to, uri, &args)) {
+        return;
+    }
+
+    migrate_set_capability(from, "auto-converge", true);
+    migrate_set_parameter_int(from, "cpu-throttle-initial", init_pct);
+    migrate_set_parameter_int(from, "cpu-throttle-increment", inc_pct);
+    migrate_set_parameter_int(from, "max-cpu-throttle", max_pct);
+    migrate_ensure_non_converge(from);
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+
+    migrate_qmp(from, to, uri, NULL, "{}");
+
+    do {
+        percentage = read_migrate_property_int(from, "cpu-throttle-percentage");
+        usleep(20);
+        g_assert_false(src_state.stop_seen);
+    } while (!percentage);
+    g_assert_cmpint(percentage, ==, init_pct);
+
+    do {
+        percentage = read_migrate_property_int(from, "cpu-throttle-percentage");
+        usleep(20);
+        g_assert_false(src_state.stop_seen);
+    } while (percentage == init_pct);
+    g_assert_cmpint(percentage, ==, init_pct + inc_pct);
+
+    /* Nothing is predicted */
+    rsp_return = migrate_query_not_failed(from);
+    g_assert_false(qdict_haskey(rsp_return, "switchover-prediction"));
+    qobject_unref(rsp_return);
+
+    migrate_ensure_converge(from);
+
+    qtest_qmp_eventwait(to, "RESUME");
+
+    wait_for_serial("dest_serial");
+    wait_for_migration_complete(from);
+
+    test_migrate_end(from, to, true);
+}
+
+/*
+ * With predictive-switchover, query-migrate reports what the model
+ * predicts while migration is running.
+ */
+static void test_migrate_predictive_switchover(void)
+{
+    g_autofree char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
+    MigrateStart args = {};
+    QTestState *from, *to;
+    QDict *rsp_return, *pred;
+
+    if (test_migrate_start(&from, &to, uri, &args)) {
+        return;
+    }
+
+    migrate_set_capability(from, "predictive-switchover", true);
+    migrate_ensure_non_converge(from);
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+
+    migrate_qmp(from, to, uri, NULL, "{}");
+
+    /* The first prediction needs a bandwidth sample */
+    while (true) {
+        rsp_return = migrate_query_not_failed(from);
+        if (qdict_haskey(rsp_return, "switchover-prediction")) {
+            break;
+        }
+        qobject_unref(rsp_return);
+        usleep(1000);
+    }
+
+    pred = qdict_get_qdict(rsp_return, "switchover-prediction");
+    g_assert_cmpint(qdict_get_int(pred, "bandwidth"), >, 0);
+    g_assert(qdict_haskey(pred, "dirty-rate"));
+    g_assert(qdict_haskey(pred, "device-state"));
+    g_assert(qdict_haskey(pred, "downtime"));
+    /* There is no way to converge within 1ms */
+    g_assert_false(qdict_get_bool(pred, "converging"));
+    g_assert_false(qdict_haskey(pred, "iterations"));
+    qobject_unref(rsp_return);
+
+    migrate_ensure_converge(from);
+
+    qtest_qmp_eventwait(to, "RESUME");
+
+    wait_for_serial("dest_serial");
+    wait_for_migration_complete(from);
+
+    test_migrate_end(from, to, true);
+}
+
 static void *
 test_migrate_precopy_tcp_multifd_start_common(QTestState *from,
                                               QTestState *to,
@@ -2777,6 +2888,25 @@ test_migrate_precopy_tcp_multifd_zstd_start(QTestState *from,
 }
 #endif /* CONFIG_ZSTD */
 
+#ifdef CONFIG_LZ4
+static void *
+test_migrate_precopy_tcp_multifd_lz4_start(QTestState *from,
+                                           QTestState *to)
+{
+    return test_migrate_precopy_tcp_multifd_start_common(from, to, "lz4");
+}
+
+static void *
+test_migrate_precopy_tcp_multifd_lz4hc_start(QTestState *from,
+                                             QTestState *to)
+{
+    migrate_set_parameter_int(from, "multifd-lz4-level", 9);
+    migrate_set_parameter_int(to, "multifd-lz4-level", 9);
+
+    return test_migrate_precopy_tcp_multifd_start_common(from, to, "lz4");
+}
+#endif /* CONFIG_LZ4 */
+
 static void test_multifd_tcp_uri_none(void)
 {
     MigrateCommon args = {
@@ -2857,6 +2987,26 @@ static void test_multifd_tcp_zstd(void)
 }
 #endif
 
+#ifdef CONFIG_LZ4
+static void test_multifd_tcp_lz4(void)
+{
+    MigrateCommon args = {
+        .listen_uri = "defer",
+        .start_hook = test_migrate_precopy_tcp_multifd_lz4_start,
+    };
+    test_precopy_common(&args);
+}
+
+static void test_multifd_tcp_lz4hc(void)
+{
+    MigrateCommon args = {
+        .listen_uri = "defer",
+        .start_hook = test_migrate_precopy_tcp_multifd_lz4hc_start,
+    };
+    test_precopy_common(&args);
+}
+#endif
+
 #ifdef CONFIG_GNUTLS
 static void *
 test_migrate_multifd_tcp_tls_psk_start_match(QTestState *from,
@@ -3094,6 +3244,99 @@ static void test_multifd_tcp_cancel(void)
     test_migrate_end(from, to2, true);
 }
 
+#define DEVICE_STATE_TESTDEV_BUFFERS    64
+
+/*
+ * Send the buffers of a device-state-testdev through the multifd
+ * channels, last to first so that the destination has to put them back
+ * in order.  If @skip is not negative, the buffer with that index is not
+ * sent, which the destination must notice.
+ */
+static void test_multifd_tcp_device_state_common(int skip)
+{
+    bool missing = skip >= 0;
+    g_autofree char *opts_source = NULL;
+    g_autofree char *opts_target = NULL;
+    g_autofree char *opts_skip = NULL;
+    MigrateStart args = {
+        .hide_stderr = missing,
+    };
+    QTestState *from, *to;
+    QDict *rsp;
+
+    if (!qtest_has_device("device-state-testdev")) {
+        g_test_skip("device-state-testdev is not available");
+        return;
+    }
+
+    opts_skip = missing ? g_strdup_printf(",skip=%d", skip) : g_strdup("");
+    opts_source = g_strdup_printf("-device device-state-testdev,id=ds0,"
+                                  "buffers=%d,reverse=on%s",
+                                  DEVICE_STATE_TESTDEV_BUFFERS, opts_skip);
+    opts_target = g_strdup_printf("-device device-state-testdev,id=ds0,"
+                                  "buffers=%d",
+                                  DEVICE_STATE_TESTDEV_BUFFERS);
+    args.opts_source = opts_source;
+    args.opts_target = opts_target;
+
+    if (test_migrate_start(&from, &to, "defer", &args)) {
+        return;
+    }
+
+    test_migrate_precopy_tcp_multifd_start(from, to);
+    /* Let the source know if the destination fails */
+    migrate_set_capability(from, "return-path", true);
+    migrate_set_capability(to, "return-path", true);
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+    qtest_qmp_assert_success(from, "{ 'execute' : 'stop'}");
+    wait_for_stop(from, &src_state);
+    migrate_ensure_converge(from);
+
+    migrate_qmp(from, to, NULL, NULL, "{}");
+
+    if (missing) {
+        wait_for_migration_status(from, "failed",
+                                  (const char * []) { "completed", NULL });
+        qtest_set_expected_status(to, EXIT_FAILURE);
+        test_migrate_end(from, to, false);
+        return;
+    }
+
+    wait_for_migration_complete(from);
+    wait_for_migration_complete(to);
+
+    rsp = qtest_qmp(to, "{ 'execute': 'qom-get',"
+                    "  'arguments': {"
+                    "    'path': '/machine/peripheral/ds0',"
+                    "    'property': 'loaded' } }");
+    g_assert_cmpint(qdict_get_int(rsp, "return"), ==,
+                    DEVICE_STATE_TESTDEV_BUFFERS);
+    qobject_unref(rsp);
+
+    qtest_qmp_assert_success(to, "{ 'execute' : 'cont'}");
+    wait_for_resume(to, &dst_state);
+    wait_for_serial("dest_serial");
+    test_migrate_end(from, to, true);
+}
+
+static void test_multifd_tcp_device_state(void)
+{
+    test_multifd_tcp_device_state_common(-1);
+}
+
+static void test_multifd_tcp_device_state_missing(void)
+{
+    test_multifd_tcp_device_state_common(3);
+}
+
+/* Nothing is left waiting for the missing buffer if it is the last one */
+static void test_multifd_tcp_device_state_missing_last(void)
+{
+    test_multifd_tcp_device_state_common(DEVICE_STATE_TESTDEV_BUFFERS - 1);
+}
+
 static void calc_dirty_rate(QTestState *who, uint64_t calc_time)
 {
     qtest_qmp_assert_success(who,
@@ -3738,12 +3981,16 @@ int main(int argc, char **argv)
     if (g_test_slow()) {
         migration_test_add("/migration/auto_converge",
                            test_migrate_auto_converge);
+        migration_test_add("/migration/auto_converge/step",
+                           test_migrate_auto_converge_step);
         if (g_str_equal(arch, "x86_64") &&
             has_kvm && kvm_dirty_ring_supported()) {
             migration_test_add("/migration/dirty_limit",
                                test_migrate_dirty_limit);
         }
     }
+    migration_test_add("/migration/predictive_switchover",
+                       test_migrate_predictive_switchover);
     migration_test_add("/migration/multifd/tcp/uri/plain/none",
                        test_multifd_tcp_uri_none);
     migration_test_add("/migration/multifd/tcp/channels/plain/none",
@@ -3754,12 +4001,24 @@ int main(int argc, char **argv)
                        test_multifd_tcp_no_zero_page);
     migration_test_add("/migration/multifd/tcp/plain/cancel",
                        test_multifd_tcp_cancel);
+    migration_test_add("/migration/multifd/tcp/plain/device-state",
+                       test_multifd_tcp_device_state);
+    migration_test_add("/migration/multifd/tcp/plain/device-state/missing",
+                       test_multifd_tcp_device_state_missing);
+    migration_test_add("/migration/multifd/tcp/plain/device-state/missing-last",
+                       test_multifd_tcp_device_state_missing_last);
     migration_test_add("/migration/multifd/tcp/plain/zlib",
                        test_multifd_tcp_zlib);
 #ifdef CONFIG_ZSTD
     migration_test_add("/migration/multifd/tcp/plain/zstd",
                        test_multifd_tcp_zstd);
 #endif
+#ifdef CONFIG_LZ4
+    migration_test_add("/migration/multifd/tcp/plain/lz4",
+                       test_multifd_tcp_lz4);
+    migration_test_add("/migration/multifd/tcp/plain/lz4hc",
+                       test_multifd_tcp_lz4hc);
+#endif
 #ifdef CONFIG_GNUTLS
     migration_test_add("/migration/multifd/tcp/tls/psk/match",
                        test_multifd_tcp_tls_psk_match);
@@ -0,0 +1,116 @@
+/*
+ * QTest testcase for TCG per-TB statistics
+ *
+ * Run the firmware under TCG with TB statistics enabled, and check what
+ * x-query-tb-stats and "info tb-stats" report.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
+
+/* How long to wait for the firmware to run, in 10ms steps */
+#define TB_STATS_WAIT   1000
+
+typedef struct {
+    uint64_t blocks;
+    uint64_t executions;
+    uint64_t chain_failures;
+} TbStatsTotal;
+
+static void tb_stats_total(QTestState *qts, TbStatsTotal *total)
+{
+    QDict *rsp = qtest_qmp(qts, "{ 'execute': 'x-query-tb-stats' }");
+    QListEntry *entry;
+
+    memset(total, 0, sizeof(*total));
+    QLIST_FOREACH_ENTRY(qdict_get_qlist(rsp, "return"), entry) {
+        QDict *s = qobject_to(QDict, qlist_entry_obj(entry));
+
+        total->blocks++;
+        total->executions += qdict_get_int(s, "executions");
+        total->chain_failures += qdict_get_int(s, "chain-failures");
+    }
+    qobject_unref(rsp);
+}
+
+static void tb_stats_wait(QTestState *qts, TbStatsTotal *total,
+                          bool chain_failures)
+{
+    int i;
+
+    for (i = 0; i < TB_STATS_WAIT; i++) {
+        tb_stats_total(qts, total);
+        if (total->executions && (!chain_failures || total->chain_failures)) {
+            return;
+        }
+        g_usleep(10 * 1000);
+    }
+    g_assert_not_reached();
+}
+
+static void test_tb_stats_disabled(void)
+{
+    QTestState *qts = qtest_init("-accel tcg");
+    QDict *rsp;
+
+    rsp = qtest_qmp_assert_failure_ref(qts,
+                                       "{ 'execute': 'x-query-tb-stats' }");
+    qobject_unref(rsp);
+    qtest_quit(qts);
+}
+
+static void test_tb_stats_nochain(void)
+{
+    QTestState *qts = qtest_init("-accel tcg,tb-stats=full,"
+                                 "one-insn-per-tb=on");
+    TbStatsTotal total;
+
+    /* No direct jump is ever chained, so failures must show up */
+    tb_stats_wait(qts, &total, true);
+    g_assert_cmpint(total.blocks, >, 0);
+    g_assert_cmpint(total.chain_failures, >, 0);
+
+    qtest_quit(qts);
+}
+
+static void test_tb_stats_folded(void)
+{
+    QTestState *qts = qtest_init("-accel tcg,tb-stats=sample");
+    g_auto(GStrv) lines = NULL;
+    g_autofree char *out = NULL;
+    TbStatsTotal total;
+    int i;
+
+    tb_stats_wait(qts, &total, false);
+
+    /* One "symbol;0xpc count" line per executed block */
+    out = qtest_hmp(qts, "info tb-stats");
+    lines = g_strsplit(out, "\n", -1);
+    g_assert(lines[0] && lines[0][0]);
+    for (i = 0; lines[i] && lines[i][0]; i++) {
+        g_assert(g_regex_match_simple("^[^; ]+;0x[0-9a-f]+ [1-9][0-9]*\r?$",
+                                      lines[i], 0, 0));
+    }
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (!qtest_has_accel("tcg")) {
+        return 0;
+    }
+
+    qtest_add_func("/tb-stats/disabled", test_tb_stats_disabled);
+    qtest_add_func("/tb-stats/nochain", test_tb_stats_nochain);
+    qtest_add_func("/tb-stats/folded", test_tb_stats_folded);
+
+    return g_test_run();
+}
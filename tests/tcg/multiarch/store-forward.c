@@ -0,0 +1,199 @@
+/*
+ * Test that loads observe the stores before them, in the cases that
+ * store to load forwarding and dead store elimination must not fold:
+ * aliasing stores, partially overlapping stores, and stores separated
+ * from the load by helper calls, faults or memory barriers.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#define _GNU_SOURCE 1
+
+#include <assert.h>
+#include <endian.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Keep the compiler from doing the folding itself. */
+#define barrier()   asm volatile("" ::: "memory")
+
+static union {
+    uint64_t d;
+    uint32_t w[2];
+    uint16_t h[4];
+    uint8_t b[8];
+} mem __attribute__((aligned(8)));
+
+static uint32_t __attribute__((noinline))
+store_alias(uint32_t *p, uint32_t *q)
+{
+    *p = 1;
+    barrier();
+    *q = 2;
+    barrier();
+    return *p;
+}
+
+static void test_alias(void)
+{
+    uint32_t *volatile q = &mem.w[0];
+
+    assert(store_alias(&mem.w[0], q) == 2);
+    assert(store_alias(&mem.w[0], &mem.w[1]) == 1);
+}
+
+static void test_overlap(void)
+{
+    const int le = BYTE_ORDER == LITTLE_ENDIAN;
+
+    /* A narrower store into the middle of a wider one. */
+    mem.d = 0x0101010101010101ull;
+    barrier();
+    mem.b[3] = 0xff;
+    barrier();
+    assert(mem.d == (le ? 0x01010101ff010101ull : 0x010101ff01010101ull));
+
+    /* A narrower load from the start of a wider store. */
+    mem.w[0] = 0x01020304;
+    barrier();
+    assert(mem.h[0] == (le ? 0x0304 : 0x0102));
+    assert(mem.b[0] == (le ? 0x04 : 0x01));
+
+    /* A wider load over two narrower stores. */
+    mem.w[0] = 0x11111111;
+    barrier();
+    mem.w[1] = 0x22222222;
+    barrier();
+    assert(mem.d == (le ? 0x2222222211111111ull : 0x1111111122222222ull));
+
+    /* The same address, once with each size. */
+    mem.w[0] = 0xaaaaaaaa;
+    barrier();
+    mem.h[0] = 0x5555;
+    barrier();
+    assert(mem.w[0] == (le ? 0xaaaa5555 : 0x5555aaaa));
+}
+
+static volatile double fp_a = 1.0, fp_b = 3.0, fp_c;
+
+static void test_helper(void)
+{
+    int i;
+
+    /*
+     * Floating point operations are helper calls on most guests; keep
+     * them between the store and the load.
+     */
+    for (i = 0; i < 16; i++) {
+        mem.w[0] = i;
+        barrier();
+        fp_c = fp_a / fp_b + i;
+        barrier();
+        assert(mem.w[0] == i);
+        assert(fp_c > i && fp_c < i + 1);
+    }
+}
+
+static uint32_t *fault_page;
+static uint32_t *volatile fault_target;
+
+static void sigsegv(int sig, siginfo_t *info, void *uc)
+{
+    long pagesize = sysconf(_SC_PAGESIZE);
+    int err;
+
+    assert(sig == SIGSEGV);
+    assert(info->si_addr == fault_page);
+    /* Change the stored value behind the back of the faulting code. */
+    *fault_target = 0xdead;
+    err = mprotect(fault_page, pagesize, PROT_READ | PROT_WRITE);
+    assert(err == 0);
+}
+
+static void test_fault(void)
+{
+    long pagesize = sysconf(_SC_PAGESIZE);
+    struct sigaction sa = {
+        .sa_sigaction = sigsegv,
+        .sa_flags = SA_SIGINFO
+    };
+    uint32_t v;
+    int err;
+
+    fault_page = mmap(NULL, pagesize, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(fault_page != MAP_FAILED);
+    err = sigaction(SIGSEGV, &sa, NULL);
+    assert(err == 0);
+
+    /*
+     * The load from fault_page faults and is restarted once the handler
+     * returns; the load after it must see what the handler stored.
+     */
+    fault_target = &mem.w[0];
+    mem.w[0] = 0xbeef;
+    barrier();
+    v = *(volatile uint32_t *)fault_page;
+    barrier();
+    assert(v == 0);
+    assert(mem.w[0] == 0xdead);
+
+    err = munmap(fault_page, pagesize);
+    assert(err == 0);
+    signal(SIGSEGV, SIG_DFL);
+}
+
+#define PING_PONG   10000
+
+static uint32_t box;
+
+static void *pong(void *arg)
+{
+    uint32_t i;
+
+    for (i = 1; i <= PING_PONG; i++) {
+        while (__atomic_load_n(&box, __ATOMIC_ACQUIRE) != i) {
+            sched_yield();
+        }
+        __atomic_store_n(&box, -i, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void test_barrier(void)
+{
+    pthread_t thread;
+    uint32_t i, v;
+    int err;
+
+    /*
+     * Each store is followed by a barrier and a load of the same address,
+     * which must eventually observe the other thread's store.
+     */
+    err = pthread_create(&thread, NULL, pong, NULL);
+    assert(err == 0);
+    for (i = 1; i <= PING_PONG; i++) {
+        __atomic_store_n(&box, i, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        while ((v = __atomic_load_n(&box, __ATOMIC_ACQUIRE)) == i) {
+            sched_yield();
+        }
+        assert(v == -i);
+    }
+    err = pthread_join(thread, NULL);
+    assert(err == 0);
+}
+
+int main(void)
+{
+    test_alias();
+    test_overlap();
+    test_helper();
+    test_fault();
+    test_barrier();
+    return EXIT_SUCCESS;
+}
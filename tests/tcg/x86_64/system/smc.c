@@ -0,0 +1,58 @@
+/*
+ * Self-modifying code test
+ *
+ * Rewrite the immediate of a small function and call it again, many
+ * times over.  Each write hits a page with translated code, which makes
+ * the TBs on it invalid while leaving their removal for later, and each
+ * call then translates the same code again on the same page.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <minilib.h>
+
+#define ITERATIONS  1000
+
+/* A page of its own, so that nothing else is translated on it */
+static uint8_t code[4096] __attribute__((aligned(4096)));
+
+typedef uint32_t (*smc_fn)(void);
+
+static void set_imm(uint32_t val)
+{
+    /* mov $val, %eax */
+    code[1] = val;
+    code[2] = val >> 8;
+    code[3] = val >> 16;
+    code[4] = val >> 24;
+}
+
+int main(void)
+{
+    smc_fn fn = (smc_fn)code;
+    uint32_t i, ret;
+
+    code[0] = 0xb8;
+    set_imm(0);
+    /* ret */
+    code[5] = 0xc3;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        set_imm(i);
+        ret = fn();
+        if (ret != i) {
+            ml_printf("FAIL: iteration %d returned %d\n", i, ret);
+            return 1;
+        }
+        /* Run the same code twice so that it is looked up, not retranslated */
+        ret = fn();
+        if (ret != i) {
+            ml_printf("FAIL: iteration %d returned %d again\n", i, ret);
+            return 1;
+        }
+    }
+
+    ml_printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Host vector implementations of generic vector operations
+ *
+ * Check that every implementation available on the host matches
+ * the scalar one.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/gvec-accel.h"
+
+/* Large enough for the widest host vector plus a scalar remainder. */
+#define BUF_SIZE    264
+
+typedef enum {
+    OP_SSADD, OP_USADD, OP_SSSUB, OP_USSUB,
+    OP_SHLI, OP_SHRI, OP_SARI,
+    OP_EQ, OP_NE, OP_LT, OP_LE, OP_LTU, OP_LEU,
+    OP_BITSEL, OP_DUP,
+    OP_COUNT
+} TestOp;
+
+static uint8_t in_a[BUF_SIZE], in_b[BUF_SIZE], in_c[BUF_SIZE];
+
+static void run_op(const GVecAccel *g, uint8_t *d, const uint8_t *a,
+                   TestOp op, unsigned vece, intptr_t oprsz)
+{
+    unsigned shift = in_b[0] % (8 << vece);
+
+    switch (op) {
+    case OP_SSADD:
+        g->ssadd[vece & 1](d, a, in_b, oprsz);
+        break;
+    case OP_USADD:
+        g->usadd[vece & 1](d, a, in_b, oprsz);
+        break;
+    case OP_SSSUB:
+        g->sssub[vece & 1](d, a, in_b, oprsz);
+        break;
+    case OP_USSUB:
+        g->ussub[vece & 1](d, a, in_b, oprsz);
+        break;
+    case OP_SHLI:
+        g->shli[vece](d, a, shift, oprsz);
+        break;
+    case OP_SHRI:
+        g->shri[vece](d, a, shift, oprsz);
+        break;
+    case OP_SARI:
+        g->sari[vece](d, a, shift, oprsz);
+        break;
+    case OP_EQ:
+        g->eq[vece](d, a, in_b, oprsz);
+        break;
+    case OP_NE:
+        g->ne[vece](d, a, in_b, oprsz);
+        break;
+    case OP_LT:
+        g->lt[vece](d, a, in_b, oprsz);
+        break;
+    case OP_LE:
+        g->le[vece](d, a, in_b, oprsz);
+        break;
+    case OP_LTU:
+        g->ltu[vece](d, a, in_b, oprsz);
+        break;
+    case OP_LEU:
+        g->leu[vece](d, a, in_b, oprsz);
+        break;
+    case OP_BITSEL:
+        g->bitsel(d, a, in_b, in_c, oprsz);
+        break;
+    case OP_DUP:
+        g->dup(d, ldq_he_p(a), oprsz);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static void test_op(const GVecAccel *g, TestOp op, unsigned vece,
+                    intptr_t oprsz, const uint8_t *expect)
+{
+    uint8_t d[BUF_SIZE];
+
+    memset(d, 0x5a, BUF_SIZE);
+    run_op(g, d, in_a, op, vece, oprsz);
+    g_assert_cmpmem(d, BUF_SIZE, expect, BUF_SIZE);
+
+    /* In place, with the destination also the first operand. */
+    memcpy(d, in_a, BUF_SIZE);
+    run_op(g, d, d, op, vece, oprsz);
+    g_assert_cmpmem(d, oprsz, expect, oprsz);
+}
+
+static void test_all(void)
+{
+    const GVecAccel *scalar;
+    const GVecAccel *accel[8];
+    unsigned n = 0;
+
+    do {
+        g_assert_cmpuint(n, <, ARRAY_SIZE(accel));
+        accel[n++] = gvec_accel;
+    } while (test_gvec_accel_next());
+    scalar = accel[n - 1];
+
+    for (int iter = 0; iter < 200; iter++) {
+        for (int i = 0; i < BUF_SIZE; i++) {
+            in_a[i] = g_test_rand_int();
+            in_b[i] = g_test_rand_int();
+            in_c[i] = g_test_rand_int();
+            /* Make sure equality and saturation are exercised. */
+            if (i % 5 == 0) {
+                in_b[i] = in_a[i];
+            } else if (i % 7 == 0) {
+                in_b[i] = 0x7f;
+            }
+        }
+        for (intptr_t oprsz = 8; oprsz <= BUF_SIZE; oprsz += 8) {
+            for (TestOp op = 0; op < OP_COUNT; op++) {
+                for (unsigned vece = 0; vece < 4; vece++) {
+                    uint8_t expect[BUF_SIZE];
+
+                    memset(expect, 0x5a, BUF_SIZE);
+                    run_op(scalar, expect, in_a, op, vece, oprsz);
+                    for (unsigned i = 0; i + 1 < n; i++) {
+                        test_op(accel[i], op, vece, oprsz, expect);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/gvec-accel/compare", test_all);
+    return g_test_run();
+}
@@ -7,6 +7,7 @@
 #include "qemu/osdep.h"
 #include "qemu/qht.h"
 #include "qemu/rcu.h"
+#include "qemu/thread.h"
 
 #define N 5000
 
@@ -251,10 +252,116 @@ static void test_resize(void)
     qht_test(QHT_MODE_AUTO_RESIZE);
 }
 
+static void test_incremental(void)
+{
+    qht_test(QHT_MODE_AUTO_RESIZE | QHT_MODE_INCREMENTAL_RESIZE);
+}
+
+/*
+ * Grow a table from concurrent writers, while readers check that entries
+ * that were there from the start never go missing.
+ */
+#define PAR_WRITERS 4
+#define PAR_READERS 2
+#define PAR_N       20000
+
+static int32_t par_arr[(PAR_WRITERS + 1) * PAR_N];
+static bool par_done;
+
+static void *par_writer(void *arg)
+{
+    int32_t *keys = arg;
+    int i;
+
+    rcu_register_thread();
+    for (i = 0; i < PAR_N; i++) {
+        g_assert_true(qht_insert(&ht, &keys[i], keys[i], NULL));
+    }
+    for (i = 0; i < PAR_N; i += 2) {
+        g_assert_true(qht_remove(&ht, &keys[i], keys[i]));
+    }
+    for (i = 0; i < PAR_N; i += 4) {
+        g_assert_true(qht_insert(&ht, &keys[i], keys[i], NULL));
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void *par_reader(void *arg)
+{
+    int i;
+
+    rcu_register_thread();
+    while (!qatomic_read(&par_done)) {
+        rcu_read_lock();
+        for (i = 0; i < PAR_N; i++) {
+            g_assert_true(qht_lookup(&ht, &par_arr[i], i) == &par_arr[i]);
+        }
+        rcu_read_unlock();
+    }
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void qht_par_test(unsigned int mode)
+{
+    QemuThread writers[PAR_WRITERS], readers[PAR_READERS];
+    int i;
+
+    qht_init(&ht, is_equal, 0, mode);
+    par_done = false;
+    for (i = 0; i < ARRAY_SIZE(par_arr); i++) {
+        par_arr[i] = i;
+    }
+    /* the entries that readers look for; they are never removed */
+    for (i = 0; i < PAR_N; i++) {
+        g_assert_true(qht_insert(&ht, &par_arr[i], i, NULL));
+    }
+
+    for (i = 0; i < PAR_READERS; i++) {
+        qemu_thread_create(&readers[i], "qht-reader", par_reader, NULL,
+                           QEMU_THREAD_JOINABLE);
+    }
+    for (i = 0; i < PAR_WRITERS; i++) {
+        qemu_thread_create(&writers[i], "qht-writer", par_writer,
+                           &par_arr[(i + 1) * PAR_N], QEMU_THREAD_JOINABLE);
+    }
+    for (i = 0; i < PAR_WRITERS; i++) {
+        qemu_thread_join(&writers[i]);
+    }
+    qatomic_set(&par_done, true);
+    for (i = 0; i < PAR_READERS; i++) {
+        qemu_thread_join(&readers[i]);
+    }
+
+    check_n(PAR_N + PAR_WRITERS * (PAR_N / 2 + PAR_N / 4));
+    rcu_read_lock();
+    for (i = PAR_N; i < ARRAY_SIZE(par_arr); i++) {
+        bool present = (i % PAR_N) % 2 == 1 || (i % PAR_N) % 4 == 0;
+
+        g_assert_true(!!qht_lookup(&ht, &par_arr[i], i) == present);
+    }
+    rcu_read_unlock();
+    qht_destroy(&ht);
+}
+
+static void test_resize_par(void)
+{
+    qht_par_test(QHT_MODE_AUTO_RESIZE);
+}
+
+static void test_incremental_par(void)
+{
+    qht_par_test(QHT_MODE_AUTO_RESIZE | QHT_MODE_INCREMENTAL_RESIZE);
+}
+
 int main(int argc, char *argv[])
 {
     g_test_init(&argc, &argv, NULL);
     g_test_add_func("/qht/mode/default", test_default);
     g_test_add_func("/qht/mode/resize", test_resize);
+    g_test_add_func("/qht/mode/incremental", test_incremental);
+    g_test_add_func("/qht/mode/resize/threads", test_resize_par);
+    g_test_add_func("/qht/mode/incremental/threads", test_incremental_par);
     return g_test_run();
 }
@@ -0,0 +1,180 @@
+/*
+ * Migration switchover simulation unit tests
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "../migration/switchover.h"
+
+/* dirty rate of the guest, in bytes per millisecond */
+static double dirty_rate;
+/* size of the guest RAM, which the guest can never dirty more than */
+static uint64_t dirty_max;
+
+static uint64_t test_dirty_bytes(double ms, double scale)
+{
+    return MIN(dirty_rate * scale * ms, (double)dirty_max);
+}
+
+static void test_sim_init(SwitchoverSim *sim, double rate)
+{
+    *sim = (SwitchoverSim) {
+        .bandwidth = 100,
+        .switchover_bw = 100,
+        .downtime_limit = 100,
+        .dirty_bytes = test_dirty_bytes,
+    };
+    dirty_rate = rate;
+    dirty_max = UINT64_MAX;
+}
+
+static void test_simulate_immediate(void)
+{
+    SwitchoverSim sim;
+    uint64_t iterations = -1;
+    double time = -1;
+
+    test_sim_init(&sim, 1000);
+    g_assert_true(switchover_simulate(&sim, 10000, 1, &iterations, &time));
+    g_assert_cmpint(iterations, ==, 0);
+    g_assert_cmpfloat(time, ==, 0);
+}
+
+static void test_simulate_converge(void)
+{
+    SwitchoverSim sim;
+    uint64_t iterations;
+    double time;
+
+    /*
+     * Each iteration halves the dirty RAM: 100000, 50000, 25000, 12500,
+     * then 6250 fits within 100ms at 100 bytes/ms.
+     */
+    test_sim_init(&sim, 50);
+    g_assert_true(switchover_simulate(&sim, 100000, 1, &iterations, &time));
+    g_assert_cmpint(iterations, ==, 4);
+    g_assert_cmpfloat(time, ==, 1000 + 500 + 250 + 125);
+
+    /* At half the rate, 100000 then 25000 then 6250 */
+    g_assert_true(switchover_simulate(&sim, 100000, 0.5, &iterations, &time));
+    g_assert_cmpint(iterations, ==, 2);
+    g_assert_cmpfloat(time, ==, 1000 + 250);
+}
+
+static void test_simulate_diverge(void)
+{
+    SwitchoverSim sim;
+
+    /* The guest dirties memory as fast as it is sent */
+    test_sim_init(&sim, 100);
+    g_assert_false(switchover_simulate(&sim, 100000, 1, NULL, NULL));
+
+    /* Converging, but too slowly */
+    test_sim_init(&sim, 95);
+    g_assert_false(switchover_simulate(&sim, 100000, 1, NULL, NULL));
+}
+
+static void test_simulate_capped(void)
+{
+    SwitchoverSim sim;
+    uint64_t iterations;
+
+    /* The guest cannot dirty more than its RAM, however fast it goes */
+    test_sim_init(&sim, 1000);
+    dirty_max = 8000;
+    g_assert_true(switchover_simulate(&sim, 100000, 1, &iterations, NULL));
+    g_assert_cmpint(iterations, ==, 1);
+}
+
+static void test_simulate_device_state(void)
+{
+    SwitchoverSim sim;
+    uint64_t iterations;
+
+    /* Device state alone does not fit within the downtime */
+    test_sim_init(&sim, 0);
+    sim.device_state = 20000;
+    g_assert_false(switchover_simulate(&sim, 0, 1, NULL, NULL));
+
+    /* It leaves room for less RAM */
+    sim.device_state = 8000;
+    g_assert_true(switchover_simulate(&sim, 2000, 1, &iterations, NULL));
+    g_assert_cmpint(iterations, ==, 0);
+    g_assert_true(switchover_simulate(&sim, 2001, 1, &iterations, NULL));
+    g_assert_cmpint(iterations, ==, 1);
+}
+
+/* The least throttle that converges, found the slow way */
+static int test_min_throttle_linear(const SwitchoverSim *sim, uint64_t ram,
+                                    int pct_now, int pct_max)
+{
+    int pct;
+
+    for (pct = 0; pct <= pct_max; pct++) {
+        if (switchover_simulate(sim, ram, (100.0 - pct) / (100 - pct_now),
+                                NULL, NULL)) {
+            return pct;
+        }
+    }
+    return -1;
+}
+
+static void test_min_throttle(void)
+{
+    static const int pct_now[] = { 0, 20, 50, 90 };
+    static const int pct_max[] = { 0, 1, 50, 99 };
+    SwitchoverSim sim;
+    int rate, i, j;
+
+    for (rate = 0; rate <= 1000; rate += 5) {
+        test_sim_init(&sim, rate);
+        for (i = 0; i < ARRAY_SIZE(pct_now); i++) {
+            for (j = 0; j < ARRAY_SIZE(pct_max); j++) {
+                g_assert_cmpint(
+                    switchover_min_throttle(&sim, 100000, pct_now[i],
+                                            pct_max[j]), ==,
+                    test_min_throttle_linear(&sim, 100000, pct_now[i],
+                                             pct_max[j]));
+            }
+        }
+    }
+}
+
+static void test_min_throttle_bounds(void)
+{
+    SwitchoverSim sim;
+
+    /* Converging already */
+    test_sim_init(&sim, 50);
+    g_assert_cmpint(switchover_min_throttle(&sim, 100000, 0, 99), ==, 0);
+
+    /* Twice as fast as the bandwidth: 50% only matches it */
+    test_sim_init(&sim, 200);
+    g_assert_cmpint(switchover_min_throttle(&sim, 100000, 0, 99), >, 50);
+    g_assert_cmpint(switchover_min_throttle(&sim, 100000, 0, 50), ==, -1);
+
+    /* Measured at 50% throttle, so the unthrottled rate is 400 */
+    g_assert_cmpint(switchover_min_throttle(&sim, 100000, 50, 99), >, 75);
+
+    /* No throttle helps if the device state does not fit */
+    test_sim_init(&sim, 0);
+    sim.device_state = 20000;
+    g_assert_cmpint(switchover_min_throttle(&sim, 0, 0, 99), ==, -1);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/switchover/simulate/immediate", test_simulate_immediate);
+    g_test_add_func("/switchover/simulate/converge", test_simulate_converge);
+    g_test_add_func("/switchover/simulate/diverge", test_simulate_diverge);
+    g_test_add_func("/switchover/simulate/capped", test_simulate_capped);
+    g_test_add_func("/switchover/simulate/device-state",
+                    test_simulate_device_state);
+    g_test_add_func("/switchover/min-throttle/bisect", test_min_throttle);
+    g_test_add_func("/switchover/min-throttle/bounds",
+                    test_min_throttle_bounds);
+    return g_test_run();
+}
@@ -0,0 +1,251 @@
+/*
+ * Host vector implementations of generic vector operations
+ *
+ * The TCG generic vector runtime falls back to these when the backend
+ * cannot expand an operation inline.  Rather than relying on the
+ * compiler to vectorize the scalar loops, provide explicit versions
+ * for the host vector extensions and select the best one at startup.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/gvec-accel.h"
+#include "host/cpuinfo.h"
+
+#define DO_3(NAME, T, EXPR)                                             \
+static void NAME##_int(void *d, const void *a, const void *b,           \
+                       intptr_t oprsz)                                  \
+{                                                                       \
+    for (intptr_t i = 0; i < oprsz; i += sizeof(T)) {                   \
+        T x = *(const T *)(a + i);                                      \
+        T y = *(const T *)(b + i);                                      \
+        *(T *)(d + i) = EXPR;                                           \
+    }                                                                   \
+}
+
+#define DO_SHIFT(NAME, T, OP)                                           \
+static void NAME##_int(void *d, const void *a, unsigned shift,          \
+                       intptr_t oprsz)                                  \
+{                                                                       \
+    for (intptr_t i = 0; i < oprsz; i += sizeof(T)) {                   \
+        *(T *)(d + i) = *(const T *)(a + i) OP shift;                   \
+    }                                                                   \
+}
+
+DO_3(gvec_ssadd8, int8_t, MIN(MAX(x + y, INT8_MIN), INT8_MAX))
+DO_3(gvec_ssadd16, int16_t, MIN(MAX(x + y, INT16_MIN), INT16_MAX))
+DO_3(gvec_usadd8, uint8_t, MIN(x + y, UINT8_MAX))
+DO_3(gvec_usadd16, uint16_t, MIN(x + y, UINT16_MAX))
+DO_3(gvec_sssub8, int8_t, MIN(MAX(x - y, INT8_MIN), INT8_MAX))
+DO_3(gvec_sssub16, int16_t, MIN(MAX(x - y, INT16_MIN), INT16_MAX))
+DO_3(gvec_ussub8, uint8_t, x > y ? x - y : 0)
+DO_3(gvec_ussub16, uint16_t, x > y ? x - y : 0)
+
+#define DO_CMP(SZ)                                      \
+    DO_3(gvec_eq##SZ, uint##SZ##_t, -(x == y))          \
+    DO_3(gvec_ne##SZ, uint##SZ##_t, -(x != y))          \
+    DO_3(gvec_lt##SZ, int##SZ##_t, -(x < y))            \
+    DO_3(gvec_le##SZ, int##SZ##_t, -(x <= y))           \
+    DO_3(gvec_ltu##SZ, uint##SZ##_t, -(x < y))          \
+    DO_3(gvec_leu##SZ, uint##SZ##_t, -(x <= y))
+
+#define DO_SHIFTS(SZ)                                   \
+    DO_SHIFT(gvec_shl##SZ##i, uint##SZ##_t, <<)         \
+    DO_SHIFT(gvec_shr##SZ##i, uint##SZ##_t, >>)         \
+    DO_SHIFT(gvec_sar##SZ##i, int##SZ##_t, >>)
+
+DO_CMP(8)
+DO_CMP(16)
+DO_CMP(32)
+DO_CMP(64)
+
+DO_SHIFTS(8)
+DO_SHIFTS(16)
+DO_SHIFTS(32)
+DO_SHIFTS(64)
+
+#undef DO_CMP
+#undef DO_SHIFTS
+#undef DO_3
+#undef DO_SHIFT
+
+static void gvec_bitsel_int(void *d, const void *a, const void *b,
+                            const void *c, intptr_t oprsz)
+{
+    for (intptr_t i = 0; i < oprsz; i += sizeof(uint64_t)) {
+        uint64_t aa = *(const uint64_t *)(a + i);
+        uint64_t bb = *(const uint64_t *)(b + i);
+        uint64_t cc = *(const uint64_t *)(c + i);
+        *(uint64_t *)(d + i) = (bb & aa) | (cc & ~aa);
+    }
+}
+
+static void gvec_dup_int(void *d, uint64_t c, intptr_t oprsz)
+{
+    for (intptr_t i = 0; i < oprsz; i += sizeof(uint64_t)) {
+        *(uint64_t *)(d + i) = c;
+    }
+}
+
+#define INT_VECE(NAME) \
+    { NAME##8_int, NAME##16_int, NAME##32_int, NAME##64_int }
+#define INT_VECE_I(NAME) \
+    { NAME##8i_int, NAME##16i_int, NAME##32i_int, NAME##64i_int }
+
+static const GVecAccel gvec_accel_int = {
+    .name = "int",
+    .ssadd = { gvec_ssadd8_int, gvec_ssadd16_int },
+    .usadd = { gvec_usadd8_int, gvec_usadd16_int },
+    .sssub = { gvec_sssub8_int, gvec_sssub16_int },
+    .ussub = { gvec_ussub8_int, gvec_ussub16_int },
+    .shli = INT_VECE_I(gvec_shl),
+    .shri = INT_VECE_I(gvec_shr),
+    .sari = INT_VECE_I(gvec_sar),
+    .eq = INT_VECE(gvec_eq),
+    .ne = INT_VECE(gvec_ne),
+    .lt = INT_VECE(gvec_lt),
+    .le = INT_VECE(gvec_le),
+    .ltu = INT_VECE(gvec_ltu),
+    .leu = INT_VECE(gvec_leu),
+    .bitsel = gvec_bitsel_int,
+    .dup = gvec_dup_int,
+};
+
+#undef INT_VECE
+#undef INT_VECE_I
+
+#if defined(CONFIG_AVX2_OPT) || defined(__SSE2__)
+#include <immintrin.h>
+
+#define ACCEL_SUFFIX    _sse2
+#define ACCEL_ATTR      __attribute__((target("sse2")))
+#define ACCEL_NAME      "sse2"
+#define VECTOR_BYTES    16
+#define ACCEL_SSADD8(x, y)   ((vs8)_mm_adds_epi8((__m128i)(x), (__m128i)(y)))
+#define ACCEL_SSADD16(x, y)  ((vs16)_mm_adds_epi16((__m128i)(x), (__m128i)(y)))
+#define ACCEL_USADD8(x, y)   ((vu8)_mm_adds_epu8((__m128i)(x), (__m128i)(y)))
+#define ACCEL_USADD16(x, y)  ((vu16)_mm_adds_epu16((__m128i)(x), (__m128i)(y)))
+#define ACCEL_SSSUB8(x, y)   ((vs8)_mm_subs_epi8((__m128i)(x), (__m128i)(y)))
+#define ACCEL_SSSUB16(x, y)  ((vs16)_mm_subs_epi16((__m128i)(x), (__m128i)(y)))
+#define ACCEL_USSUB8(x, y)   ((vu8)_mm_subs_epu8((__m128i)(x), (__m128i)(y)))
+#define ACCEL_USSUB16(x, y)  ((vu16)_mm_subs_epu16((__m128i)(x), (__m128i)(y)))
+#include "gvec-accel.c.inc"
+
+#ifdef CONFIG_AVX2_OPT
+#define ACCEL_SUFFIX    _avx2
+#define ACCEL_ATTR      __attribute__((target("avx2")))
+#define ACCEL_NAME      "avx2"
+#define VECTOR_BYTES    32
+#define ACCEL_SSADD8(x, y)  ((vs8)_mm256_adds_epi8((__m256i)(x), (__m256i)(y)))
+#define ACCEL_SSADD16(x, y) \
+    ((vs16)_mm256_adds_epi16((__m256i)(x), (__m256i)(y)))
+#define ACCEL_USADD8(x, y)  ((vu8)_mm256_adds_epu8((__m256i)(x), (__m256i)(y)))
+#define ACCEL_USADD16(x, y) \
+    ((vu16)_mm256_adds_epu16((__m256i)(x), (__m256i)(y)))
+#define ACCEL_SSSUB8(x, y)  ((vs8)_mm256_subs_epi8((__m256i)(x), (__m256i)(y)))
+#define ACCEL_SSSUB16(x, y) \
+    ((vs16)_mm256_subs_epi16((__m256i)(x), (__m256i)(y)))
+#define ACCEL_USSUB8(x, y)  ((vu8)_mm256_subs_epu8((__m256i)(x), (__m256i)(y)))
+#define ACCEL_USSUB16(x, y) \
+    ((vu16)_mm256_subs_epu16((__m256i)(x), (__m256i)(y)))
+#include "gvec-accel.c.inc"
+#endif /* CONFIG_AVX2_OPT */
+
+#ifdef CONFIG_AVX512BW_OPT
+#define ACCEL_SUFFIX    _avx512bw
+#define ACCEL_ATTR      __attribute__((target("avx512bw")))
+#define ACCEL_NAME      "avx512bw"
+#define VECTOR_BYTES    64
+#define ACCEL_SSADD8(x, y)  ((vs8)_mm512_adds_epi8((__m512i)(x), (__m512i)(y)))
+#define ACCEL_SSADD16(x, y) \
+    ((vs16)_mm512_adds_epi16((__m512i)(x), (__m512i)(y)))
+#define ACCEL_USADD8(x, y)  ((vu8)_mm512_adds_epu8((__m512i)(x), (__m512i)(y)))
+#define ACCEL_USADD16(x, y) \
+    ((vu16)_mm512_adds_epu16((__m512i)(x), (__m512i)(y)))
+#define ACCEL_SSSUB8(x, y)  ((vs8)_mm512_subs_epi8((__m512i)(x), (__m512i)(y)))
+#define ACCEL_SSSUB16(x, y) \
+    ((vs16)_mm512_subs_epi16((__m512i)(x), (__m512i)(y)))
+#define ACCEL_USSUB8(x, y)  ((vu8)_mm512_subs_epu8((__m512i)(x), (__m512i)(y)))
+#define ACCEL_USSUB16(x, y) \
+    ((vu16)_mm512_subs_epu16((__m512i)(x), (__m512i)(y)))
+#include "gvec-accel.c.inc"
+#endif /* CONFIG_AVX512BW_OPT */
+
+static const GVecAccel * const accel_table[] = {
+    &gvec_accel_int,
+    &gvec_accel_sse2,
+#ifdef CONFIG_AVX2_OPT
+    &gvec_accel_avx2,
+#endif
+#ifdef CONFIG_AVX512BW_OPT
+    &gvec_accel_avx512bw,
+#endif
+};
+
+static unsigned best_accel(void)
+{
+    unsigned info = cpuinfo_init();
+    unsigned i = ARRAY_SIZE(accel_table) - 1;
+
+#ifdef CONFIG_AVX512BW_OPT
+    if (info & CPUINFO_AVX512BW) {
+        return i;
+    }
+    i--;
+#endif
+#ifdef CONFIG_AVX2_OPT
+    if (info & CPUINFO_AVX2) {
+        return i;
+    }
+#endif
+    return info & CPUINFO_SSE2 ? 1 : 0;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+
+#define ACCEL_SUFFIX    _neon
+#define ACCEL_ATTR
+#define ACCEL_NAME      "neon"
+#define VECTOR_BYTES    16
+#define NEON_SAT(T, FN, NT, x, y)   ((T)FN((NT)(x), (NT)(y)))
+#define ACCEL_SSADD8(x, y)   NEON_SAT(vs8, vqaddq_s8, int8x16_t, x, y)
+#define ACCEL_SSADD16(x, y)  NEON_SAT(vs16, vqaddq_s16, int16x8_t, x, y)
+#define ACCEL_USADD8(x, y)   NEON_SAT(vu8, vqaddq_u8, uint8x16_t, x, y)
+#define ACCEL_USADD16(x, y)  NEON_SAT(vu16, vqaddq_u16, uint16x8_t, x, y)
+#define ACCEL_SSSUB8(x, y)   NEON_SAT(vs8, vqsubq_s8, int8x16_t, x, y)
+#define ACCEL_SSSUB16(x, y)  NEON_SAT(vs16, vqsubq_s16, int16x8_t, x, y)
+#define ACCEL_USSUB8(x, y)   NEON_SAT(vu8, vqsubq_u8, uint8x16_t, x, y)
+#define ACCEL_USSUB16(x, y)  NEON_SAT(vu16, vqsubq_u16, uint16x8_t, x, y)
+#include "gvec-accel.c.inc"
+
+#define best_accel() 1
+static const GVecAccel * const accel_table[] = {
+    &gvec_accel_int,
+    &gvec_accel_neon,
+};
+#else
+#define best_accel() 0
+static const GVecAccel * const accel_table[1] = {
+    &gvec_accel_int,
+};
+#endif
+
+const GVecAccel *gvec_accel = &gvec_accel_int;
+static unsigned accel_index;
+
+bool test_gvec_accel_next(void)
+{
+    if (accel_index != 0) {
+        gvec_accel = accel_table[--accel_index];
+        return true;
+    }
+    return false;
+}
+
+static void __attribute__((constructor)) init_accel(void)
+{
+    accel_index = best_accel();
+    gvec_accel = accel_table[accel_index];
+}
@@ -52,6 +52,23 @@
  * acquiring their bucket lock. If they don't match, a resize has occurred
  * while the bucket spinlock was being acquired.
  *
+ * With QHT_MODE_INCREMENTAL_RESIZE, automatic upward resizes do not stop the
+ * writers. Instead, the new map is published right away, with a pointer to
+ * the old one, by the writer that finds the table too full: it takes ht->lock
+ * with a trylock, just long enough to publish the map, and carries on without
+ * resizing if somebody else holds the lock. No writer waits for ht->lock or
+ * for a migration to complete. The old map's head buckets are then migrated
+ * one at a time:
+ * writers first migrate the head bucket their hash maps to in the old map,
+ * plus a few others, and then operate on the new map. A head bucket is
+ * migrated by adding its entries to the new map before removing them from
+ * the old one; lookups search the old map's bucket (unless it has been
+ * migrated) before the new map's, so that they find entries in either.
+ * A writer holding a stale map may keep using it, as long as its head bucket
+ * has not been migrated yet. Once all head buckets are migrated, the old map
+ * is detached and freed after an RCU grace period. Explicit resizes, resets
+ * and iterations complete any ongoing migration first.
+ *
  * Related Work:
  * - Idea of cacheline-sized buckets with full hashes taken from:
  *   David, Guerraoui & Trigonakis, "Asynchronized Concurrency:
@@ -176,6 +193,11 @@ struct qht_tsan_lock {
  * @n_added_buckets: number of added (i.e. "non-head") buckets
  * @n_added_buckets_threshold: threshold to trigger an upward resize once the
  *                             number of added buckets surpasses it.
+ * @old: map whose entries are being migrated into this one, or NULL.
+ * @migrated: for a map being migrated, which head buckets have been.
+ *            NULL until the migration starts.
+ * @n_migrated: number of head buckets migrated so far
+ * @migrate_next: next head bucket for writers to migrate
  * @tsan_bucket_locks: Array of striped locks to be used only under TSAN.
  *
  * Buckets are tracked in what we call a "map", i.e. this structure.
@@ -186,6 +208,10 @@ struct qht_map {
     size_t n_buckets;
     size_t n_added_buckets;
     size_t n_added_buckets_threshold;
+    struct qht_map *old;
+    bool *migrated;
+    size_t n_migrated;
+    size_t migrate_next;
 #ifdef CONFIG_TSAN
     struct qht_tsan_lock tsan_bucket_locks[QHT_TSAN_BUCKET_LOCKS];
 #endif
@@ -194,9 +220,15 @@ struct qht_map {
 /* trigger a resize when n_added_buckets > n_buckets / div */
 #define QHT_NR_ADDED_BUCKETS_THRESHOLD_DIV 8
 
+/* head buckets migrated by each writer, on top of its own */
+#define QHT_MIGRATE_BATCH 2
+
 static void qht_do_resize_reset(struct qht *ht, struct qht_map *new,
                                 bool reset);
 static void qht_grow_maybe(struct qht *ht);
+static void qht_map_migrate_step(struct qht *ht, struct qht_map *map,
+                                 uint32_t hash);
+static void qht_map_migrate_all__ht_locked(struct qht *ht);
 
 #ifdef QHT_DEBUG
 
@@ -341,6 +373,25 @@ static inline bool qht_map_is_stale__locked(const struct qht *ht,
     return map != ht->map;
 }
 
+/*
+ * Call with the lock of head bucket @b held.
+ * With incremental resizing, a stale map that is being migrated can still
+ * be used for the head buckets that have not been migrated yet.
+ */
+static inline bool qht_map_is_usable__locked(const struct qht *ht,
+                                             const struct qht_map *map,
+                                             const struct qht_bucket *b)
+{
+    const bool *migrated;
+
+    /* pairs with qatomic_rcu_set in qht_map_migrate_begin */
+    if (likely(map == qatomic_load_acquire(&ht->map))) {
+        return true;
+    }
+    migrated = qatomic_read(&map->migrated);
+    return migrated && !migrated[b - map->buckets];
+}
+
 /*
  * Grab all bucket locks, and set @pmap after making sure the map isn't stale.
  *
@@ -385,6 +436,21 @@ struct qht_bucket *qht_bucket_lock__no_stale(struct qht *ht, uint32_t hash,
     struct qht_bucket *b;
     struct qht_map *map;
 
+    if (ht->mode & QHT_MODE_INCREMENTAL_RESIZE) {
+        /* no need for ht->lock: a stale map is just retried */
+        for (;;) {
+            map = qatomic_rcu_read(&ht->map);
+            qht_map_migrate_step(ht, map, hash);
+            b = qht_map_to_bucket(map, hash);
+            qht_bucket_lock(map, b);
+            if (likely(qht_map_is_usable__locked(ht, map, b))) {
+                *pmap = map;
+                return b;
+            }
+            qht_bucket_unlock(map, b);
+        }
+    }
+
     map = qatomic_rcu_read(&ht->map);
     b = qht_map_to_bucket(map, hash);
 
@@ -434,6 +500,7 @@ static void qht_map_destroy(struct qht_map *map)
         qht_chain_destroy(map, &map->buckets[i]);
     }
     qemu_vfree(map->buckets);
+    g_free(map->migrated);
     g_free(map);
 }
 
@@ -448,6 +515,10 @@ static struct qht_map *qht_map_create(size_t n_buckets)
     map->n_added_buckets = 0;
     map->n_added_buckets_threshold = n_buckets /
         QHT_NR_ADDED_BUCKETS_THRESHOLD_DIV;
+    map->old = NULL;
+    map->migrated = NULL;
+    map->n_migrated = 0;
+    map->migrate_next = 0;
 
     /* let tiny hash tables to at least add one non-head bucket */
     if (unlikely(map->n_added_buckets_threshold == 0)) {
@@ -479,6 +550,9 @@ void qht_init(struct qht *ht, qht_cmp_func_t cmp, size_t n_elems,
 /* call only when there are no readers/writers left */
 void qht_destroy(struct qht *ht)
 {
+    if (ht->map->old) {
+        qht_map_destroy(ht->map->old);
+    }
     qht_map_destroy(ht->map);
     memset(ht, 0, sizeof(*ht));
 }
@@ -518,6 +592,17 @@ void qht_reset(struct qht *ht)
 {
     struct qht_map *map;
 
+    if (ht->mode & QHT_MODE_INCREMENTAL_RESIZE) {
+        /* ht->lock keeps a new migration from starting */
+        qht_lock(ht);
+        qht_map_migrate_all__ht_locked(ht);
+        map = ht->map;
+        qht_map_lock_buckets(map);
+        qht_map_reset__all_locked(map);
+        qht_map_unlock_buckets(map);
+        qht_unlock(ht);
+        return;
+    }
     qht_map_lock_buckets__no_stale(ht, &map);
     qht_map_reset__all_locked(map);
     qht_map_unlock_buckets(map);
@@ -593,17 +678,13 @@ void *qht_lookup__slowpath(const struct qht_bucket *b, qht_lookup_func_t func,
     return ret;
 }
 
-void *qht_lookup_custom(const struct qht *ht, const void *userp, uint32_t hash,
-                        qht_lookup_func_t func)
+static inline
+void *qht_bucket_lookup(const struct qht_bucket *b, qht_lookup_func_t func,
+                        const void *userp, uint32_t hash)
 {
-    const struct qht_bucket *b;
-    const struct qht_map *map;
     unsigned int version;
     void *ret;
 
-    map = qatomic_rcu_read(&ht->map);
-    b = qht_map_to_bucket(map, hash);
-
     version = seqlock_read_begin(&b->sequence);
     ret = qht_do_lookup(b, func, userp, hash);
     if (likely(!seqlock_read_retry(&b->sequence, version))) {
@@ -616,6 +697,47 @@ void *qht_lookup_custom(const struct qht *ht, const void *userp, uint32_t hash,
     return qht_lookup__slowpath(b, func, userp, hash);
 }
 
+/* look up in @old, which is being migrated, unless the bucket already was */
+static __attribute__((noinline))
+void *qht_lookup__migrating(const struct qht_map *old, qht_lookup_func_t func,
+                            const void *userp, uint32_t hash)
+{
+    size_t idx = hash & (old->n_buckets - 1);
+
+    /* pairs with qatomic_store_release in qht_map_migrate_bucket */
+    if (qatomic_load_acquire(&old->migrated[idx])) {
+        return NULL;
+    }
+    return qht_bucket_lookup(&old->buckets[idx], func, userp, hash);
+}
+
+void *qht_lookup_custom(const struct qht *ht, const void *userp, uint32_t hash,
+                        qht_lookup_func_t func)
+{
+    const struct qht_map *map;
+    const struct qht_map *old;
+    void *ret;
+
+    do {
+        map = qatomic_rcu_read(&ht->map);
+        old = qatomic_rcu_read(&map->old);
+        /* entries are added to the new map before leaving the old one */
+        if (unlikely(old)) {
+            ret = qht_lookup__migrating(old, func, userp, hash);
+            if (ret) {
+                return ret;
+            }
+        }
+        ret = qht_bucket_lookup(qht_map_to_bucket(map, hash), func, userp,
+                                hash);
+        /*
+         * If @map has been replaced, its entries might have been migrated
+         * while we were looking; if so, look again in the new map.
+         */
+    } while (unlikely(ret == NULL) && unlikely(map != qatomic_read(&ht->map)));
+    return ret;
+}
+
 void *qht_lookup(const struct qht *ht, const void *userp, uint32_t hash)
 {
     return qht_lookup_custom(ht, userp, hash, ht->cmp);
@@ -671,6 +793,120 @@ static void *qht_insert__locked(const struct qht *ht, struct qht_map *map,
     return NULL;
 }
 
+/*
+ * Move the entries of head bucket @idx of @old, which is being replaced
+ * by @map, to @map.  Entries are inserted in @map before being removed
+ * from @old, so that concurrent lookups always find them in either map.
+ *
+ * Call from an RCU read-side critical section.
+ */
+static void qht_map_migrate_bucket(struct qht *ht, struct qht_map *map,
+                                   struct qht_map *old, size_t idx)
+{
+    struct qht_bucket *head = &old->buckets[idx];
+    struct qht_bucket *b;
+    int i;
+
+    if (qatomic_load_acquire(&old->migrated[idx])) {
+        return;
+    }
+    qht_bucket_lock(old, head);
+    if (old->migrated[idx]) {
+        qht_bucket_unlock(old, head);
+        return;
+    }
+    b = head;
+    do {
+        for (i = 0; i < QHT_BUCKET_ENTRIES; i++) {
+            struct qht_bucket *nb;
+            uint32_t hash;
+            void *p;
+
+            p = b->pointers[i];
+            if (p == NULL) {
+                goto done;
+            }
+            hash = b->hashes[i];
+            nb = qht_map_to_bucket(map, hash);
+            qht_bucket_lock(map, nb);
+            qht_insert__locked(ht, map, nb, p, hash, NULL);
+            qht_bucket_unlock(map, nb);
+        }
+        b = b->next;
+    } while (b);
+ done:
+    qht_bucket_reset__locked(head);
+    /* pairs with qatomic_load_acquire in qht_lookup__migrating */
+    qatomic_store_release(&old->migrated[idx], true);
+    qht_bucket_unlock(old, head);
+
+    if (qatomic_fetch_inc(&old->n_migrated) == old->n_buckets - 1) {
+        /* we migrated the last bucket; this completes the resize */
+        qatomic_set(&map->old, NULL);
+        call_rcu(old, qht_map_destroy, rcu);
+    }
+}
+
+/*
+ * Migrate the head bucket of the old map that @hash maps to, so that
+ * the caller can then operate on @map alone, plus a few more buckets so
+ * that the migration eventually completes.
+ */
+static void qht_map_migrate_step(struct qht *ht, struct qht_map *map,
+                                 uint32_t hash)
+{
+    struct qht_map *old = qatomic_rcu_read(&map->old);
+    int i;
+
+    if (likely(old == NULL)) {
+        return;
+    }
+    qht_map_migrate_bucket(ht, map, old, hash & (old->n_buckets - 1));
+
+    for (i = 0; i < QHT_MIGRATE_BATCH; i++) {
+        size_t idx = qatomic_fetch_inc(&old->migrate_next);
+
+        if (idx >= old->n_buckets) {
+            break;
+        }
+        qht_map_migrate_bucket(ht, map, old, idx);
+    }
+}
+
+/*
+ * Start replacing ht->map with @new; the entries are moved over by
+ * writers as they go.  Call with ht->lock held.
+ */
+static void qht_map_migrate_begin(struct qht *ht, struct qht_map *new)
+{
+    struct qht_map *old = ht->map;
+
+    old->migrated = g_new0(bool, old->n_buckets);
+    new->old = old;
+    /* pairs with qatomic_load_acquire in qht_map_is_usable__locked */
+    qatomic_rcu_set(&ht->map, new);
+}
+
+/*
+ * Complete an ongoing migration, if any.
+ * Call with ht->lock held, so that no other migration can start.
+ */
+static void qht_map_migrate_all__ht_locked(struct qht *ht)
+{
+    struct qht_map *map = ht->map;
+    struct qht_map *old;
+    size_t i;
+
+    RCU_READ_LOCK_GUARD();
+    old = qatomic_rcu_read(&map->old);
+    if (old == NULL) {
+        return;
+    }
+    for (i = 0; i < old->n_buckets; i++) {
+        qht_map_migrate_bucket(ht, map, old, i);
+    }
+}
+
 static __attribute__((noinline)) void qht_grow_maybe(struct qht *ht)
 {
     struct qht_map *map;
@@ -685,9 +921,12 @@ static __attribute__((noinline)) void qht_grow_maybe(struct qht *ht)
     map = ht->map;
     /* another thread might have just performed the resize we were after */
     if (qht_map_needs_resize(map)) {
-        struct qht_map *new = qht_map_create(map->n_buckets * 2);
-
-        qht_do_resize(ht, new);
+        if (!(ht->mode & QHT_MODE_INCREMENTAL_RESIZE)) {
+            qht_do_resize(ht, qht_map_create(map->n_buckets * 2));
+        } else if (qatomic_read(&map->old) == NULL) {
+            /* otherwise, let the ongoing migration complete first */
+            qht_map_migrate_begin(ht, qht_map_create(map->n_buckets * 2));
+        }
     }
     qht_unlock(ht);
 }
@@ -702,6 +941,9 @@ bool qht_insert(struct qht *ht, void *p, uint32_t hash, void **existing)
     /* NULL pointers are not supported */
     qht_debug_assert(p);
 
+    /* with incremental resizing, maps are freed while writers run */
+    RCU_READ_LOCK_GUARD();
+
     b = qht_bucket_lock__no_stale(ht, hash, &map);
     prev = qht_insert__locked(ht, map, b, p, hash, &needs_resize);
     qht_bucket_debug__locked(b);
@@ -813,6 +1055,7 @@ bool qht_remove(struct qht *ht, const void *p, uint32_t hash)
     /* NULL pointers are not supported */
     qht_debug_assert(p);
 
+    RCU_READ_LOCK_GUARD();
     b = qht_bucket_lock__no_stale(ht, hash, &map);
     ret = qht_remove__locked(b, p, hash);
     qht_bucket_debug__locked(b);
@@ -872,6 +1115,17 @@ do_qht_iter(struct qht *ht, const struct qht_iter *iter, void *userp)
 {
     struct qht_map *map;
 
+    if (ht->mode & QHT_MODE_INCREMENTAL_RESIZE) {
+        /* ht->lock keeps a new migration from starting */
+        qht_lock(ht);
+        qht_map_migrate_all__ht_locked(ht);
+        map = ht->map;
+        qht_map_lock_buckets(map);
+        qht_map_iter__all_locked(map, iter, userp);
+        qht_map_unlock_buckets(map);
+        qht_unlock(ht);
+        return;
+    }
     map = qatomic_rcu_read(&ht->map);
     qht_map_lock_buckets(map);
     qht_map_iter__all_locked(map, iter, userp);
@@ -927,6 +1181,9 @@ static void qht_do_resize_reset(struct qht *ht, struct qht_map *new, bool reset)
     };
     struct qht_map_copy_data data;
 
+    if (ht->mode & QHT_MODE_INCREMENTAL_RESIZE) {
+        qht_map_migrate_all__ht_locked(ht);
+    }
     old = ht->map;
     qht_map_lock_buckets(old);
 
@@ -968,25 +1225,11 @@ bool qht_resize(struct qht *ht, size_t n_elems)
     return ret;
 }
 
-/* pass @stats to qht_statistics_destroy() when done */
-void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
+static void qht_map_statistics(const struct qht_map *map,
+                               struct qht_stats *stats, bool entries_only)
 {
-    const struct qht_map *map;
     int i;
 
-    map = qatomic_rcu_read(&ht->map);
-
-    stats->used_head_buckets = 0;
-    stats->entries = 0;
-    qdist_init(&stats->chain);
-    qdist_init(&stats->occupancy);
-    /* bail out if the qht has not yet been initialized */
-    if (unlikely(map == NULL)) {
-        stats->head_buckets = 0;
-        return;
-    }
-    stats->head_buckets = map->n_buckets;
-
     for (i = 0; i < map->n_buckets; i++) {
         const struct qht_bucket *head = &map->buckets[i];
         const struct qht_bucket *b;
@@ -1012,7 +1255,9 @@ void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
             } while (b);
         } while (seqlock_read_retry(&head->sequence, version));
 
-        if (entries) {
+        if (entries_only) {
+            stats->entries += entries;
+        } else if (entries) {
             qdist_inc(&stats->chain, buckets);
             qdist_inc(&stats->occupancy,
                       (double)entries / QHT_BUCKET_ENTRIES / buckets);
@@ -1024,6 +1269,34 @@ void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
     }
 }
 
+/* pass @stats to qht_statistics_destroy() when done */
+void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
+{
+    const struct qht_map *map;
+    const struct qht_map *old;
+
+    RCU_READ_LOCK_GUARD();
+    map = qatomic_rcu_read(&ht->map);
+
+    stats->used_head_buckets = 0;
+    stats->entries = 0;
+    qdist_init(&stats->chain);
+    qdist_init(&stats->occupancy);
+    /* bail out if the qht has not yet been initialized */
+    if (unlikely(map == NULL)) {
+        stats->head_buckets = 0;
+        return;
+    }
+    stats->head_buckets = map->n_buckets;
+
+    qht_map_statistics(map, stats, false);
+    /* account for the entries that are yet to be migrated to @map */
+    old = qatomic_rcu_read(&map->old);
+    if (old) {
+        qht_map_statistics(old, stats, true);
+    }
+}
+
 void qht_statistics_destroy(struct qht_stats *stats)
 {
     qdist_destroy(&stats->occupancy);